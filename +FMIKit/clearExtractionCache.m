@@ -0,0 +1,13 @@
+function clearExtractionCache()
+% FMIKit.clearExtractionCache  Delete all FMUs in the extraction cache
+%
+% Example:
+%
+%   FMIKit.clearExtractionCache()
+%
+%   deletes the cached FMUs (the unzip directories of the FMU blocks are
+%   not affected)
+
+javaMethod('clear', 'fmikit.ui.ExtractionCache');
+
+end
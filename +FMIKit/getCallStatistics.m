@@ -0,0 +1,40 @@
+function statistics = getCallStatistics(block, blockStatistics)
+% FMIKit.getCallStatistics  Get the FMI call statistics of an FMU block
+%
+% Returns the statistics of the last simulation of an FMU block with "Profile
+% FMI calls" enabled as a struct array with one element per called FMI function
+% and the fields
+%
+%   function   name of the FMI function
+%   calls      number of calls
+%   totalTime  total time spent in the function [s]
+%   maxTime    longest call [s]
+%   histogram  histogram(i) is the number of calls that took [2^(i-1), 2^i) ns
+%
+% Example:
+%
+%   stats = FMIKit.getCallStatistics(gcb);
+%
+%   returns the statistics of the current block.
+
+persistent store
+
+if isempty(store)
+    store = containers.Map();
+end
+
+if nargin > 1
+    % called by the S-function in mdlTerminate()
+    store(block) = blockStatistics;
+    return
+end
+
+path = getfullname(block);
+
+if isKey(store, path)
+    statistics = store(path);
+else
+    statistics = struct('function', {}, 'calls', {}, 'totalTime', {}, 'maxTime', {}, 'histogram', {});
+end
+
+end
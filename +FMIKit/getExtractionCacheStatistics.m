@@ -0,0 +1,26 @@
+function statistics = getExtractionCacheStatistics()
+% FMIKit.getExtractionCacheStatistics  Get the statistics of the FMU extraction cache
+%
+% Example:
+%
+%   stats = FMIKit.getExtractionCacheStatistics()
+%
+%   returns a struct with the fields
+%
+%     directory       the cache directory
+%     upToDate        number of loads where the unzip directory was up to date
+%     hits            number of loads where the FMU was copied from the cache
+%     misses          number of loads where the FMU was extracted
+%     bytesExtracted  bytes extracted from FMUs
+%     bytesCopied     bytes copied to unzip directories
+%     time            total time spent in seconds
+
+statistics.directory      = char(javaMethod('getDirectory', 'fmikit.ui.ExtractionCache'));
+statistics.upToDate       = double(javaMethod('getUpToDate', 'fmikit.ui.ExtractionCache'));
+statistics.hits           = double(javaMethod('getHits', 'fmikit.ui.ExtractionCache'));
+statistics.misses         = double(javaMethod('getMisses', 'fmikit.ui.ExtractionCache'));
+statistics.bytesExtracted = double(javaMethod('getBytesExtracted', 'fmikit.ui.ExtractionCache'));
+statistics.bytesCopied    = double(javaMethod('getBytesCopied', 'fmikit.ui.ExtractionCache'));
+statistics.time           = double(javaMethod('getMillis', 'fmikit.ui.ExtractionCache')) / 1000;
+
+end
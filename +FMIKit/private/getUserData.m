@@ -62,4 +62,93 @@ if ~isfield(userData, 'logToFile')
     save_system
 end
 
+if ~isfield(userData, 'locateStateEvents')
+    disp(['Adding userData.locateStateEvents to ' getfullname(block)])
+    userData.locateStateEvents = false;
+    set_param(block, 'UserData', userData, 'UserDataPersistent', 'on')
+    % sfun_fmurun expects the additional parameter
+    if ~userData.useSourceCode
+        dialog = FMIKit.showBlockDialog(block, false);
+        applyDialog(dialog);
+        userData = get_param(block, 'UserData');
+    end
+    save_system
+end
+
+if ~isfield(userData.outputPorts, 'majorStepOnly')
+    disp(['Adding userData.outputPorts.majorStepOnly to ' getfullname(block)])
+    if isempty(userData.outputPorts)
+        userData.outputPorts = struct('label', [], 'variables', {}, 'majorStepOnly', {});
+    else
+        [userData.outputPorts.majorStepOnly] = deal(false);
+    end
+    set_param(block, 'UserData', userData, 'UserDataPersistent', 'on')
+    % sfun_fmurun expects the additional parameter
+    if ~userData.useSourceCode
+        dialog = FMIKit.showBlockDialog(block, false);
+        applyDialog(dialog);
+        userData = get_param(block, 'UserData');
+    end
+    save_system
+end
+
+if ~isfield(userData, 'provideJacobian')
+    disp(['Adding userData.provideJacobian to ' getfullname(block)])
+    userData.provideJacobian = false;
+    set_param(block, 'UserData', userData, 'UserDataPersistent', 'on')
+    % sfun_fmurun expects the additional parameters
+    if ~userData.useSourceCode
+        dialog = FMIKit.showBlockDialog(block, false);
+        applyDialog(dialog);
+        userData = get_param(block, 'UserData');
+    end
+    save_system
+end
+
+if ~isfield(userData, 'profileFMICalls')
+    disp(['Adding userData.profileFMICalls to ' getfullname(block)])
+    userData.profileFMICalls = false;
+    set_param(block, 'UserData', userData, 'UserDataPersistent', 'on')
+    % sfun_fmurun expects the additional parameter
+    if ~userData.useSourceCode
+        dialog = FMIKit.showBlockDialog(block, false);
+        applyDialog(dialog);
+        userData = get_param(block, 'UserData');
+    end
+    save_system
+end
+
+% sfun_fmurun expects the additional parameter that enables the simulation state (34 parameters)
+if ~userData.useSourceCode && numberOfParameters(userData.parameters) < 34
+    disp(['Updating the S-function parameters of ' getfullname(block)])
+    dialog = FMIKit.showBlockDialog(block, false);
+    applyDialog(dialog);
+    userData = get_param(block, 'UserData');
+    save_system
+end
+
+end
+
+
+function n = numberOfParameters(parameters)
+% number of comma separated parameters (outside of quotes and brackets)
+
+n = 1;
+depth = 0;
+quoted = false;
+
+for c = parameters
+    if c == ''''
+        quoted = ~quoted;
+    elseif ~quoted
+        if any(c == '([{')
+            depth = depth + 1;
+        elseif any(c == ')]}')
+            depth = depth - 1;
+        elseif c == ',' && depth == 0
+            n = n + 1;
+        end
+    end
+end
+
 end
@@ -13,6 +13,9 @@ userData.logFMICalls       = ud.logFMICalls;
 userData.logLevel          = ud.logLevel;
 userData.logFile           = ud.logFile;
 userData.logToFile         = ud.logToFile;
+userData.locateStateEvents = ud.locateStateEvents;
+userData.provideJacobian   = ud.provideJacobian;
+userData.profileFMICalls   = ud.profileFMICalls;
 userData.relativeTolerance = ud.relativeTolerance;
 userData.sampleTime        = ud.sampleTime;
 
@@ -31,6 +34,9 @@ for i = 1:numel(ud.outputPorts)
     p = ud.outputPorts(i);
     port = javaObject('fmikit.ui.UserData$Port');
     port.label = p.label;
+    if isfield(p, 'majorStepOnly') && ~isempty(p.majorStepOnly)
+        port.majorStepOnly = p.majorStepOnly;
+    end
     for j = 1:numel(p.variables)
         variable = java.lang.String(p.variables{j});
         port.variables.add(variable);
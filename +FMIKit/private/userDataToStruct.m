@@ -12,10 +12,13 @@ ud = struct(...
     'logLevel',          [], ...
     'logFile',           [], ...
     'logToFile',         [], ...
+    'locateStateEvents', [], ...
+    'provideJacobian',   [], ...
+    'profileFMICalls',   [], ...
     'relativeTolerance', [], ...
     'sampleTime',        [], ...
     'inputPorts',  struct('label', [], 'variables', {}), ...
-    'outputPorts', struct('label', [], 'variables', {}), ...
+    'outputPorts', struct('label', [], 'variables', {}, 'majorStepOnly', {}), ...
     'startValues', containers.Map, ...
     'useSourceCode',     [], ...
     'functionName',      [], ...
@@ -34,6 +37,9 @@ ud.logFMICalls       = userData.logFMICalls;
 ud.logLevel          = userData.logLevel;
 ud.logFile           = char(userData.logFile);
 ud.logToFile         = userData.logToFile;
+ud.locateStateEvents = userData.locateStateEvents;
+ud.provideJacobian   = userData.provideJacobian;
+ud.profileFMICalls   = userData.profileFMICalls;
 ud.relativeTolerance = char(userData.relativeTolerance);
 ud.sampleTime        = char(userData.sampleTime);
 
@@ -48,6 +54,7 @@ end
 for i = 1:userData.outputPorts.size()
     port = userData.outputPorts.get(i-1);
     ud.outputPorts(i).label = char(port.label);
+    ud.outputPorts(i).majorStepOnly = port.majorStepOnly;
     for j = 1:port.variables.size()
         ud.outputPorts(i).variables{end+1} = char(port.variables.get(j-1));
     end
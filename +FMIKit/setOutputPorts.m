@@ -9,6 +9,11 @@ function setOutputPorts(block, ports)
 %   ports(2).variables = { 'y1', 'y2' };
 %
 %   FMIKit.setOutputPorts(gcb, ports)
+%
+% Ports with the optional field majorStepOnly set to true are only
+% read from the FMU in major time steps:
+%
+%   ports(2).majorStepOnly = true;
 
 assert(strcmp(get_param(block, 'ReferenceBlock'), 'FMIKit_blocks/FMU'), 'Block is not an FMU')
 
@@ -30,9 +30,16 @@ if userData.useSourceCode
     end
 else
     % generic S-function
+    sources_files{end+1} = ['"' fullfile(fmikitdir, 'src', 'AsyncLogWriter.cpp') '"'];
+    sources_files{end+1} = ['"' fullfile(fmikitdir, 'src', 'CallStatistics.cpp') '"'];
+    sources_files{end+1} = ['"' fullfile(fmikitdir, 'src', 'CallTimeline.cpp') '"'];
+    sources_files{end+1} = ['"' fullfile(fmikitdir, 'src', 'CallTrace.cpp') '"'];
     sources_files{end+1} = ['"' fullfile(fmikitdir, 'src', 'FMU.cpp') '"'];
     sources_files{end+1} = ['"' fullfile(fmikitdir, 'src', 'FMU1.cpp') '"'];
     sources_files{end+1} = ['"' fullfile(fmikitdir, 'src', 'FMU2.cpp') '"'];
+    sources_files{end+1} = ['"' fullfile(fmikitdir, 'src', 'SharedLibrary.cpp') '"'];
+    sources_files{end+1} = ['"' fullfile(fmikitdir, 'src', 'SparseJacobian.cpp') '"'];
+    sources_files{end+1} = ['"' fullfile(fmikitdir, 'src', 'TransferPlan.cpp') '"'];
 end
 
 % S-function sources
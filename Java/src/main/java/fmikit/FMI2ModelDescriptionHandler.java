@@ -76,6 +76,12 @@ public class FMI2ModelDescriptionHandler extends ModelDescriptionHandler {
 				
 				sv.unit = attributes.getValue("unit");
 				
+				String derivative = attributes.getValue("derivative");
+				
+				if (derivative != null) {
+					sv.derivative = Integer.parseInt(derivative);
+				}
+				
 				String declaredType = attributes.getValue("declaredType");
 				
 				if (modelDescription.typeDefinitions.containsKey(declaredType)) {
@@ -112,12 +118,17 @@ public class FMI2ModelDescriptionHandler extends ModelDescriptionHandler {
 			
 			implementation = modelDescription.modelExchange = new ModelExchange();
 			modelDescription.modelExchange.modelIdentifier = attributes.getValue("modelIdentifier");
+			modelDescription.modelExchange.providesDirectionalDerivative = "true".equals(attributes.getValue("providesDirectionalDerivative"));
+			implementation.canGetAndSetFMUstate = "true".equals(attributes.getValue("canGetAndSetFMUstate"));
+			implementation.canSerializeFMUstate = "true".equals(attributes.getValue("canSerializeFMUstate"));
 			
 		} else if ("CoSimulation".equals(qName)) {
 			
 			implementation = modelDescription.coSimulation = new CoSimulation();
 			modelDescription.coSimulation.modelIdentifier = attributes.getValue("modelIdentifier");
 			modelDescription.coSimulation.canInterpolateInputs = "true".equals(attributes.getValue("canInterpolateInputs"));
+			implementation.canGetAndSetFMUstate = "true".equals(attributes.getValue("canGetAndSetFMUstate"));
+			implementation.canSerializeFMUstate = "true".equals(attributes.getValue("canSerializeFMUstate"));
 			
 		} else if ("File".equals(qName)) {
 			
@@ -149,11 +160,13 @@ public class FMI2ModelDescriptionHandler extends ModelDescriptionHandler {
 			String dependenciesValue = attributes.getValue("dependencies");
 			String dependencyKinds = attributes.getValue("dependenciesKind");
 
-			if (dependenciesValue != null && dependencyKinds != null) {
+			if (dependenciesValue != null) {
 
 				dependencies = new ArrayList<Dependency>();
 				String[] indexes = dependenciesValue.split(" ");
-				String[] kinds = dependencyKinds.split(" ");
+				
+				// if dependenciesKind is missing all dependencies are "dependent"
+				String[] kinds = dependencyKinds != null ? dependencyKinds.split(" ") : null;
 
 				for (int i = 0; i < indexes.length; i++) {
 
@@ -162,7 +175,7 @@ public class FMI2ModelDescriptionHandler extends ModelDescriptionHandler {
 					}
 
 					int idx = Integer.parseInt(indexes[i]);
-					String kind = kinds[i];
+					String kind = kinds != null && i < kinds.length ? kinds[i] : "dependent";
 
 					Dependency dependency = new Dependency();
 					dependency.variable = modelDescription.scalarVariables.get(idx - 1);
@@ -13,5 +13,7 @@ public abstract class Implementation {
 	public String modelIdentifier;
 	public List<String> platforms = new ArrayList<String>();
 	public List<String> sourceFiles = new ArrayList<String>();
+	public boolean canGetAndSetFMUstate;
+	public boolean canSerializeFMUstate;
 
 }
@@ -5,7 +5,7 @@
 
 package fmikit;
 
-import java.util.HashMap;
+import java.util.LinkedHashMap;
 import java.util.List;
 import java.util.Map;
 
@@ -15,11 +15,14 @@ public class ModelStructure {
 	 * Holds the dependencies of the outputs variables. If dependencies is <code>null</code>
 	 * the output variables depends on all inputs.
 	 */
-	public Map<ScalarVariable, List<Dependency>> outputs = new HashMap<ScalarVariable, List<Dependency>>();
+	public Map<ScalarVariable, List<Dependency>> outputs = new LinkedHashMap<ScalarVariable, List<Dependency>>();
 
-	public Map<ScalarVariable, List<Dependency>> derivatives = new HashMap<ScalarVariable, List<Dependency>>();
+	/**
+	 * Holds the dependencies of the derivatives in the order of the continuous states.
+	 */
+	public Map<ScalarVariable, List<Dependency>> derivatives = new LinkedHashMap<ScalarVariable, List<Dependency>>();
 
-	public Map<ScalarVariable, List<Dependency>> initialUnknowns = new HashMap<ScalarVariable, List<Dependency>>();
+	public Map<ScalarVariable, List<Dependency>> initialUnknowns = new LinkedHashMap<ScalarVariable, List<Dependency>>();
 
 	@Override
 	public String toString() {
@@ -15,6 +15,7 @@ public class ScalarVariable {
 	public String causality;
 	public String unit;
 	public SimpleType declaredType;
+	public int derivative; // one-based index of the state if this is a derivative (FMI 2.0)
 
 	@Override
 	public String toString() {
@@ -27,6 +28,7 @@ public class ScalarVariable {
 				"\n     causality: " + causality +
 				"\n          unit: " + unit + 
 				"\n  declaredType: " + declaredType + 
+				"\n    derivative: " + derivative + 
 				"\n}";
 	}
 
@@ -0,0 +1,463 @@
+/*
+ * Copyright (c) Dassault Systemes. All rights reserved.
+ * This file is part of FMIKit. See LICENSE.txt in the project root for license information.
+ */
+
+package fmikit.ui;
+
+import java.io.BufferedReader;
+import java.io.File;
+import java.io.FileInputStream;
+import java.io.FileOutputStream;
+import java.io.FileReader;
+import java.io.FileWriter;
+import java.io.IOException;
+import java.io.InputStream;
+import java.io.OutputStream;
+import java.security.MessageDigest;
+import java.security.NoSuchAlgorithmException;
+import java.util.ArrayList;
+import java.util.Arrays;
+import java.util.Comparator;
+import java.util.Enumeration;
+import java.util.List;
+import java.util.concurrent.Callable;
+import java.util.concurrent.ExecutionException;
+import java.util.concurrent.ExecutorService;
+import java.util.concurrent.Executors;
+import java.util.concurrent.Future;
+import java.util.zip.ZipEntry;
+import java.util.zip.ZipFile;
+
+/**
+ * Content addressed cache for extracted FMUs. Every archive is extracted once into a directory named
+ * after its SHA-256 hash and the unzip directories of the blocks are filled from there. The hash of the
+ * archive is recorded in the unzip directory, so an unchanged archive is never extracted again.
+ * The least recently used archives are deleted when the cache exceeds its maximum size.
+ */
+public class ExtractionCache {
+
+	/** Name of the file in the unzip directory that records the archive it was extracted from */
+	public static final String HASH_FILE = ".fmikit_sha256";
+
+	/** Name of the file that every extracted FMU contains (used to check the unzip directory) */
+	private static final String MODEL_DESCRIPTION = "modelDescription.xml";
+
+	private static final int BUFFER_SIZE = 64 * 1024;
+
+	private static File directory = new File(System.getProperty("java.io.tmpdir"), "FMIKit" + File.separator + "cache");
+
+	// maximum size of the cached archives in bytes
+	private static long maxSize = 1024L * 1024L * 1024L;
+
+	// statistics
+	private static long upToDate;
+	private static long hits;
+	private static long misses;
+	private static long bytesExtracted;
+	private static long bytesCopied;
+	private static long millis;
+
+	public static synchronized String getDirectory() {
+		return directory.getAbsolutePath();
+	}
+
+	public static synchronized void setDirectory(String path) {
+		directory = new File(path);
+	}
+
+	public static synchronized long getMaxSize() {
+		return maxSize;
+	}
+
+	public static synchronized void setMaxSize(long size) {
+		maxSize = size;
+	}
+
+	public static synchronized long getUpToDate() {
+		return upToDate;
+	}
+
+	public static synchronized long getHits() {
+		return hits;
+	}
+
+	public static synchronized long getMisses() {
+		return misses;
+	}
+
+	public static synchronized long getBytesExtracted() {
+		return bytesExtracted;
+	}
+
+	public static synchronized long getBytesCopied() {
+		return bytesCopied;
+	}
+
+	public static synchronized long getMillis() {
+		return millis;
+	}
+
+	public static synchronized void resetStatistics() {
+		upToDate = 0;
+		hits = 0;
+		misses = 0;
+		bytesExtracted = 0;
+		bytesCopied = 0;
+		millis = 0;
+	}
+
+	/** Deletes all cached archives (the unzip directories of the blocks are not affected) */
+	public static synchronized void clear() throws IOException {
+		if (directory.exists()) {
+			Util.delete(directory);
+		}
+	}
+
+	public static void extract(String zipFile, String outputFolder) throws IOException {
+		extract(zipFile, outputFolder, false);
+	}
+
+	/**
+	 * Extracts zipFile to outputFolder unless outputFolder has already been extracted from an archive with
+	 * the same content. The archive is taken from the cache if an identical archive has been extracted before.
+	 * If force is true the archive is extracted again and replaces the cached copy (e.g. to repair a modified
+	 * unzip directory).
+	 */
+	public static synchronized void extract(String zipFile, String outputFolder, boolean force) throws IOException {
+
+		long start = System.currentTimeMillis();
+
+		File archive = new File(zipFile);
+		File folder = new File(outputFolder);
+		File hashFile = new File(folder, HASH_FILE);
+
+		// "<hash> <length> <last modified>" of the archive the folder was extracted from
+		String[] recorded = force || !new File(folder, MODEL_DESCRIPTION).isFile() ? null : readHashFile(hashFile);
+
+		if (recorded != null && recorded[1].equals(Long.toString(archive.length())) && recorded[2].equals(Long.toString(archive.lastModified()))) {
+			upToDate++;
+			millis += System.currentTimeMillis() - start;
+			return;
+		}
+
+		String hash = sha256(archive);
+
+		if (recorded != null && recorded[0].equals(hash)) {
+			// same content, only the time stamp has changed
+			writeHashFile(hashFile, hash, archive);
+			upToDate++;
+			millis += System.currentTimeMillis() - start;
+			return;
+		}
+
+		File cached = new File(directory, hash);
+
+		if (force && cached.exists()) {
+			Util.delete(cached);
+		}
+
+		if (cached.isDirectory()) {
+			hits++;
+			cached.setLastModified(System.currentTimeMillis());
+		} else {
+			misses++;
+			extractToCache(archive, cached);
+			evict(cached);
+		}
+
+		if (folder.exists()) {
+			Util.delete(folder);
+		}
+
+		bytesCopied += copyTree(cached, folder);
+
+		writeHashFile(hashFile, hash, archive);
+
+		millis += System.currentTimeMillis() - start;
+	}
+
+	private static void extractToCache(File archive, File cached) throws IOException {
+
+		// extract into a temporary directory and rename it, so a partially extracted
+		// archive is never used and concurrent MATLAB sessions can share the cache
+		File temp = new File(directory, cached.getName() + ".tmp" + System.nanoTime());
+
+		bytesExtracted += unzip(archive, temp);
+
+		if (!temp.renameTo(cached)) {
+			Util.delete(temp);
+			if (!cached.isDirectory()) {
+				throw new IOException("Failed to move " + temp + " to " + cached);
+			}
+		}
+	}
+
+	/** Deletes the least recently used archives (except keep) until the cache is smaller than maxSize */
+	private static void evict(File keep) throws IOException {
+
+		final File[] entries = directory.listFiles();
+
+		if (entries == null) {
+			return;
+		}
+
+		long size = 0;
+		long[] sizes = new long[entries.length];
+
+		for (int i = 0; i < entries.length; i++) {
+			sizes[i] = size(entries[i]);
+			size += sizes[i];
+		}
+
+		if (size <= maxSize) {
+			return;
+		}
+
+		Integer[] order = new Integer[entries.length];
+
+		for (int i = 0; i < order.length; i++) {
+			order[i] = i;
+		}
+
+		// least recently used first
+		Arrays.sort(order, new Comparator<Integer>() {
+			public int compare(Integer a, Integer b) {
+				long d = entries[a].lastModified() - entries[b].lastModified();
+				return d < 0 ? -1 : (d > 0 ? 1 : 0);
+			}
+		});
+
+		for (int i : order) {
+
+			if (size <= maxSize) {
+				break;
+			}
+
+			// skip the archive in use and temporary directories of other sessions
+			if (entries[i].equals(keep) || entries[i].getName().contains(".tmp")) {
+				continue;
+			}
+
+			Util.delete(entries[i]);
+			size -= sizes[i];
+		}
+	}
+
+	private static long size(File file) {
+
+		if (!file.isDirectory()) {
+			return file.length();
+		}
+
+		long size = 0;
+
+		File[] children = file.listFiles();
+
+		if (children != null) {
+			for (File child : children) {
+				size += size(child);
+			}
+		}
+
+		return size;
+	}
+
+	/** Extracts all entries of zipFile in parallel and returns the number of bytes written */
+	private static long unzip(File zipFile, File outputFolder) throws IOException {
+
+		final ZipFile zip = new ZipFile(zipFile);
+
+		try {
+			final String root = outputFolder.getCanonicalPath() + File.separator;
+
+			List<Task> tasks = new ArrayList<Task>();
+
+			for (Enumeration<? extends ZipEntry> entries = zip.entries(); entries.hasMoreElements();) {
+
+				final ZipEntry entry = entries.nextElement();
+				final File file = new File(outputFolder, entry.getName());
+
+				if (!file.getCanonicalPath().startsWith(root)) {
+					throw new IOException("Entry is outside of the target directory: " + entry.getName());
+				}
+
+				if (entry.isDirectory()) {
+					file.mkdirs();
+					continue;
+				}
+
+				file.getParentFile().mkdirs();
+
+				tasks.add(new Task() {
+					public Long call() throws IOException {
+						InputStream in = zip.getInputStream(entry);
+						try {
+							return copy(in, file);
+						} finally {
+							in.close();
+						}
+					}
+				});
+			}
+
+			outputFolder.mkdirs();
+
+			return run(tasks);
+		} finally {
+			zip.close();
+		}
+	}
+
+	/** Copies the files in source to target in parallel and returns the number of bytes written */
+	private static long copyTree(File source, File target) throws IOException {
+		List<Task> tasks = new ArrayList<Task>();
+		collectCopyTasks(source, target, tasks);
+		return run(tasks);
+	}
+
+	private static void collectCopyTasks(final File source, final File target, List<Task> tasks) throws IOException {
+
+		if (source.isDirectory()) {
+			if (!target.isDirectory() && !target.mkdirs()) {
+				throw new IOException("Failed to create directory " + target);
+			}
+			for (String name : source.list()) {
+				collectCopyTasks(new File(source, name), new File(target, name), tasks);
+			}
+			return;
+		}
+
+		tasks.add(new Task() {
+			public Long call() throws IOException {
+				InputStream in = new FileInputStream(source);
+				try {
+					return copy(in, target);
+				} finally {
+					in.close();
+				}
+			}
+		});
+	}
+
+	private interface Task extends Callable<Long> {
+		Long call() throws IOException;
+	}
+
+	private static long run(List<Task> tasks) throws IOException {
+
+		if (tasks.isEmpty()) {
+			return 0;
+		}
+
+		int threads = Math.min(tasks.size(), Runtime.getRuntime().availableProcessors());
+
+		ExecutorService executor = Executors.newFixedThreadPool(threads);
+
+		try {
+			long bytes = 0;
+
+			for (Future<Long> future : executor.invokeAll(tasks)) {
+				bytes += future.get();
+			}
+
+			return bytes;
+		} catch (InterruptedException e) {
+			Thread.currentThread().interrupt();
+			throw new IOException("Extraction was interrupted");
+		} catch (ExecutionException e) {
+			Throwable cause = e.getCause();
+			if (cause instanceof IOException) {
+				throw (IOException) cause;
+			}
+			throw new IOException(String.valueOf(cause));
+		} finally {
+			executor.shutdownNow();
+		}
+	}
+
+	private static long copy(InputStream in, File file) throws IOException {
+
+		OutputStream out = new FileOutputStream(file);
+
+		try {
+			byte[] buffer = new byte[BUFFER_SIZE];
+			long bytes = 0;
+			int len;
+
+			while ((len = in.read(buffer)) > 0) {
+				out.write(buffer, 0, len);
+				bytes += len;
+			}
+
+			return bytes;
+		} finally {
+			out.close();
+		}
+	}
+
+	private static String sha256(File file) throws IOException {
+
+		MessageDigest digest;
+
+		try {
+			digest = MessageDigest.getInstance("SHA-256");
+		} catch (NoSuchAlgorithmException e) {
+			throw new IOException("SHA-256 is not available");
+		}
+
+		InputStream in = new FileInputStream(file);
+
+		try {
+			byte[] buffer = new byte[BUFFER_SIZE];
+			int len;
+
+			while ((len = in.read(buffer)) > 0) {
+				digest.update(buffer, 0, len);
+			}
+		} finally {
+			in.close();
+		}
+
+		StringBuilder sb = new StringBuilder();
+
+		for (byte b : digest.digest()) {
+			sb.append(String.format("%02x", b));
+		}
+
+		return sb.toString();
+	}
+
+	private static String[] readHashFile(File hashFile) {
+
+		if (!hashFile.isFile()) {
+			return null;
+		}
+
+		try {
+			BufferedReader reader = new BufferedReader(new FileReader(hashFile));
+			try {
+				String line = reader.readLine();
+				if (line == null) {
+					return null;
+				}
+				String[] fields = line.trim().split(" ");
+				return fields.length == 3 ? fields : null;
+			} finally {
+				reader.close();
+			}
+		} catch (IOException e) {
+			return null;
+		}
+	}
+
+	private static void writeHashFile(File hashFile, String hash, File archive) throws IOException {
+		FileWriter writer = new FileWriter(hashFile);
+		try {
+			writer.write(hash + " " + archive.length() + " " + archive.lastModified() + "\n");
+		} finally {
+			writer.close();
+		}
+	}
+
+}
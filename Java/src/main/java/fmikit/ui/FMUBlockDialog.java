@@ -66,6 +66,9 @@ public class FMUBlockDialog extends JDialog {
     private JTextField txtLogFile;
     private JCheckBox chckbxLogToFile;
     private JCheckBox chckbxLogFMICalls;
+    private JCheckBox chckbxLocateStateEvents;
+    private JCheckBox chckbxProvideJacobian;
+    private JCheckBox chckbxProfileFMICalls;
     public JButton btnHelp;
     public JLabel lblDocumentation;
     private JLabel lblModelImage;
@@ -79,6 +82,7 @@ public class FMUBlockDialog extends JDialog {
     public DefaultMutableTreeNode outportRoot; // TODO: access via model
     public DefaultTreeModel outportTreeModel; // TODO: access via tree
     public HashMap<String, String> startValues = new HashMap<String, String>();
+    public HashSet<String> majorStepOnlyOutputPorts = new HashSet<String>(); // labels of the output ports that are only read in major steps
     private UserData userData;
     public String mdlDirectory;
     public double blockHandle;
@@ -151,7 +155,7 @@ public class FMUBlockDialog extends JDialog {
         reloadButton.addActionListener(new ActionListener() {
             //@Override
             public void actionPerformed(ActionEvent actionEvent) {
-                loadFMU(false);
+                loadFMU(false, true);
             }
         });
 
@@ -518,6 +522,9 @@ public class FMUBlockDialog extends JDialog {
         userData.unzipDirectory = txtUnzipDirectory.getText();
         userData.debugLogging = chckbxDebugLogging.isSelected();
         userData.logFMICalls = chckbxLogFMICalls.isSelected();
+        userData.locateStateEvents = chckbxLocateStateEvents.isSelected();
+        userData.provideJacobian = chckbxProvideJacobian.isSelected();
+        userData.profileFMICalls = chckbxProfileFMICalls.isSelected();
         userData.logLevel = cmbbxLogLevel.getSelectedIndex();
         userData.logFile = txtLogFile.getText();
         userData.logToFile = chckbxLogToFile.isSelected();
@@ -550,6 +557,8 @@ public class FMUBlockDialog extends JDialog {
 
             UserData.Port outputPort = new UserData.Port(portLabel);
 
+            outputPort.majorStepOnly = majorStepOnlyOutputPorts.contains(portLabel);
+
             for (int j = 0; j < outputPortNode.getChildCount(); j++) {
                 DefaultMutableTreeNode scalarVariableNode = (DefaultMutableTreeNode) outputPortNode.getChildAt(j);
                 ScalarVariable sv = (ScalarVariable) scalarVariableNode.getUserObject();
@@ -593,6 +602,10 @@ public class FMUBlockDialog extends JDialog {
 
         startValues.putAll(userData.startValues);
 
+        for (UserData.Port outputPort : userData.outputPorts) {
+            if (outputPort.majorStepOnly) majorStepOnlyOutputPorts.add(outputPort.label);
+        }
+
         // Advanced tab
         txtUnzipDirectory.setText(userData.unzipDirectory);
         txtSampleTime.setText(userData.sampleTime);
@@ -603,6 +616,9 @@ public class FMUBlockDialog extends JDialog {
         cmbbxLogLevel.setSelectedIndex(userData.logLevel);
         chckbxDebugLogging.setSelected(userData.debugLogging);
         chckbxLogFMICalls.setSelected(userData.logFMICalls);
+        chckbxLocateStateEvents.setSelected(userData.locateStateEvents);
+        chckbxProvideJacobian.setSelected(userData.provideJacobian);
+        chckbxProfileFMICalls.setSelected(userData.profileFMICalls);
         chckbxUseSourceCode.setSelected(userData.useSourceCode);
 
         // TODO: restore outports?
@@ -895,11 +911,147 @@ public class FMUBlockDialog extends JDialog {
 
             // output port variable VRs
             params.add("[" + Util.join(outputPortVariableVRs, " ") + "]");
+
+            // locate state events
+            params.add(isModelExchange && chckbxLocateStateEvents.isSelected() ? "1" : "0");
+
+            // output ports that are only read in major steps
+            ArrayList<String> outputPortMajorStepOnly = new ArrayList<String>();
+
+            for (int i = 0; i < outportRoot.getChildCount(); i++) {
+                DefaultMutableTreeNode outputPortNode = (DefaultMutableTreeNode) outportRoot.getChildAt(i);
+                outputPortMajorStepOnly.add(majorStepOnlyOutputPorts.contains(outputPortNode.getUserObject()) ? "1" : "0");
+            }
+
+            params.add("[" + Util.join(outputPortMajorStepOnly, " ") + "]");
+
+            // state and derivative VRs and sparsity pattern of the Jacobian
+            params.addAll(getJacobianParameters(inputPorts, outputPorts));
+
+            // profile FMI calls
+            params.add(chckbxProfileFMICalls.isSelected() ? "1" : "0");
+
+            // save and restore the simulation state
+            params.add(canSerializeFMUstate() ? "1" : "0");
         }
 
         return Util.join(params, " ");
     }
 
+    /**
+     * Get the value references of the continuous states and their derivatives, the sparsity pattern
+     * [rows; columns] (zero-based) of the Jacobian [A B; C D] of the derivatives and output port elements
+     * w.r.t. the continuous states and input port elements and whether the FMU provides directional
+     * derivatives. Only the Real elements of the ports have non-zero entries. Empty matrices are
+     * returned if the block does not provide a Jacobian.
+     */
+    public List<String> getJacobianParameters(List<List<ScalarVariable>> inputPorts, List<List<ScalarVariable>> outputPorts) {
+
+        ArrayList<String> stateVRs = new ArrayList<String>();
+        ArrayList<String> derivativeVRs = new ArrayList<String>();
+        ArrayList<Integer> rows = new ArrayList<Integer>();
+        ArrayList<Integer> columns = new ArrayList<Integer>();
+
+        Map<ScalarVariable, List<Dependency>> derivatives = modelDescription.modelStructure.derivatives;
+
+        boolean provideJacobian = chckbxProvideJacobian.isSelected()
+                && cmbbxRunAsKind.getSelectedIndex() == 0
+                && "2.0".equals(modelDescription.fmiVersion)
+                && !derivatives.isEmpty();
+
+        // column indices of the states and Real input port elements
+        HashMap<ScalarVariable, Integer> columnIndices = new HashMap<ScalarVariable, Integer>();
+
+        if (provideJacobian) {
+
+            for (ScalarVariable derivative : derivatives.keySet()) {
+
+                if (derivative.derivative < 1 || derivative.derivative > modelDescription.scalarVariables.size()) {
+                    // the states are unknown
+                    provideJacobian = false;
+                    break;
+                }
+
+                ScalarVariable state = modelDescription.scalarVariables.get(derivative.derivative - 1);
+
+                columnIndices.put(state, stateVRs.size());
+                stateVRs.add(state.valueReference);
+                derivativeVRs.add(derivative.valueReference);
+            }
+        }
+
+        if (provideJacobian) {
+
+            int nx = stateVRs.size();
+            int column = nx;
+
+            for (List<ScalarVariable> inputPort : inputPorts) {
+                for (ScalarVariable variable : inputPort) {
+                    if ("Real".equals(variable.type)) {
+                        columnIndices.put(variable, column);
+                    }
+                    column++;
+                }
+            }
+
+            TreeSet<Integer> allColumns = new TreeSet<Integer>(columnIndices.values());
+
+            int row = 0;
+
+            for (List<Dependency> dependencies : derivatives.values()) {
+                addJacobianRow(row++, dependencies, columnIndices, allColumns, rows, columns);
+            }
+
+            Map<ScalarVariable, List<Dependency>> outputDependencies = modelDescription.modelStructure.outputs;
+
+            for (List<ScalarVariable> outputPort : outputPorts) {
+                for (ScalarVariable variable : outputPort) {
+                    if ("Real".equals(variable.type)) {
+                        // variables that are not outputs may depend on all states and inputs
+                        addJacobianRow(row, outputDependencies.get(variable), columnIndices, allColumns, rows, columns);
+                    }
+                    row++;
+                }
+            }
+        }
+
+        ArrayList<String> params = new ArrayList<String>();
+
+        if (provideJacobian && !rows.isEmpty()) {
+            params.add("[" + Util.join(stateVRs, " ") + "]");
+            params.add("[" + Util.join(derivativeVRs, " ") + "]");
+            params.add("[" + Util.join(rows, " ") + "; " + Util.join(columns, " ") + "]");
+            params.add(modelDescription.modelExchange.providesDirectionalDerivative ? "1" : "0");
+        } else {
+            params.addAll(Collections.nCopies(3, "[]"));
+            params.add("0");
+        }
+
+        return params;
+    }
+
+    private static void addJacobianRow(int row, List<Dependency> dependencies, Map<ScalarVariable, Integer> columnIndices, Set<Integer> allColumns, List<Integer> rows, List<Integer> columns) {
+
+        Set<Integer> rowColumns = allColumns;
+
+        if (dependencies != null) {
+
+            rowColumns = new TreeSet<Integer>();
+
+            for (Dependency dependency : dependencies) {
+                // ignore dependencies on parameters and inputs that are not connected to an input port
+                if (columnIndices.containsKey(dependency.variable)) {
+                    rowColumns.add(columnIndices.get(dependency.variable));
+                }
+            }
+        }
+
+        for (Integer column : rowColumns) {
+            rows.add(row);
+            columns.add(column);
+        }
+    }
+
     /**
      * Determine based on the variable's names if they belong to the same array. Example:
      * <p>
@@ -1023,6 +1175,13 @@ public class FMUBlockDialog extends JDialog {
     }
 
     public void loadFMU(boolean showDialog) {
+        loadFMU(showDialog, false);
+    }
+
+    /**
+     * Loads the FMU. If reextract is true the FMU is extracted again even if the unzip directory is up to date.
+     */
+    public void loadFMU(boolean showDialog, boolean reextract) {
 
         logDebug("Loading FMU...");
 
@@ -1069,7 +1228,7 @@ public class FMUBlockDialog extends JDialog {
         try {
             String absoluteFMUPath = getAbsolutePath(txtFMUPath.getText());
             logDebug("Unzipping " + absoluteFMUPath + " to " + unzipdir);
-            Util.unzip(absoluteFMUPath, unzipdir);
+            ExtractionCache.extract(absoluteFMUPath, unzipdir, reextract);
         } catch (IOException e) {
             JOptionPane.showMessageDialog(this, "The FMU could not be un-zipped. See MATLAB console for details.", "Failed to unzip FMU",
                     JOptionPane.ERROR_MESSAGE);
@@ -1436,6 +1595,9 @@ public class FMUBlockDialog extends JDialog {
         }
         w.println();
 
+        w.println("#define CAN_SERIALIZE_FMU_STATE " + (canSerializeFMUstate() ? "1" : "0"));
+        w.println();
+
         w.println("#define S_FUNCTION_NAME sfun_" + modelIdentifier);
         w.println("#define FMI2_FUNCTION_PREFIX " + modelIdentifier + "_");
         w.println();
@@ -1444,6 +1606,15 @@ public class FMUBlockDialog extends JDialog {
         w.close();
     }
 
+    /**
+     * True if the FMU declares the capabilities canGetAndSetFMUstate and canSerializeFMUstate
+     * for the selected interface type (required to save and restore the simulation state)
+     */
+    private boolean canSerializeFMUstate() {
+        Implementation implementation = getImplemenation();
+        return implementation.canGetAndSetFMUstate && implementation.canSerializeFMUstate;
+    }
+
     public List<String> getSourceFiles() {
         return getImplemenation().sourceFiles;
     }
@@ -1733,13 +1904,13 @@ public class FMUBlockDialog extends JDialog {
         btnResetOutputs.setText("");
         panel11.add(btnResetOutputs, new GridConstraints(0, 5, 1, 1, GridConstraints.ANCHOR_CENTER, GridConstraints.FILL_NONE, GridConstraints.SIZEPOLICY_CAN_SHRINK | GridConstraints.SIZEPOLICY_CAN_GROW, GridConstraints.SIZEPOLICY_CAN_SHRINK | GridConstraints.SIZEPOLICY_CAN_GROW, new Dimension(22, 22), new Dimension(22, 22), new Dimension(22, 22), 0, false));
         final JPanel panel12 = new JPanel();
-        panel12.setLayout(new GridLayoutManager(10, 2, new Insets(15, 15, 15, 15), 15, 12));
+        panel12.setLayout(new GridLayoutManager(13, 2, new Insets(15, 15, 15, 15), 15, 12));
         panel12.setOpaque(false);
         tabbedPane.addTab("Advanced", panel12);
         txtUnzipDirectory = new JTextField();
         panel12.add(txtUnzipDirectory, new GridConstraints(0, 1, 1, 1, GridConstraints.ANCHOR_WEST, GridConstraints.FILL_HORIZONTAL, GridConstraints.SIZEPOLICY_WANT_GROW, GridConstraints.SIZEPOLICY_FIXED, null, new Dimension(150, -1), null, 0, false));
         final Spacer spacer6 = new Spacer();
-        panel12.add(spacer6, new GridConstraints(9, 1, 1, 1, GridConstraints.ANCHOR_CENTER, GridConstraints.FILL_VERTICAL, 1, GridConstraints.SIZEPOLICY_WANT_GROW, null, null, null, 0, false));
+        panel12.add(spacer6, new GridConstraints(12, 1, 1, 1, GridConstraints.ANCHOR_CENTER, GridConstraints.FILL_VERTICAL, 1, GridConstraints.SIZEPOLICY_WANT_GROW, null, null, null, 0, false));
         final JLabel label13 = new JLabel();
         label13.setText("Unzip directory:");
         panel12.add(label13, new GridConstraints(0, 0, 1, 1, GridConstraints.ANCHOR_WEST, GridConstraints.FILL_NONE, GridConstraints.SIZEPOLICY_FIXED, GridConstraints.SIZEPOLICY_FIXED, null, null, null, 0, false));
@@ -1797,6 +1968,19 @@ public class FMUBlockDialog extends JDialog {
         chckbxLogFMICalls.setOpaque(false);
         chckbxLogFMICalls.setText("Log FMI calls");
         panel12.add(chckbxLogFMICalls, new GridConstraints(7, 1, 1, 1, GridConstraints.ANCHOR_WEST, GridConstraints.FILL_NONE, GridConstraints.SIZEPOLICY_CAN_SHRINK | GridConstraints.SIZEPOLICY_CAN_GROW, GridConstraints.SIZEPOLICY_FIXED, null, null, null, 0, false));
+        chckbxLocateStateEvents = new JCheckBox();
+        chckbxLocateStateEvents.setOpaque(false);
+        chckbxLocateStateEvents.setText("Locate state events");
+        panel12.add(chckbxLocateStateEvents, new GridConstraints(9, 1, 1, 1, GridConstraints.ANCHOR_WEST, GridConstraints.FILL_NONE, GridConstraints.SIZEPOLICY_CAN_SHRINK | GridConstraints.SIZEPOLICY_CAN_GROW, GridConstraints.SIZEPOLICY_FIXED, null, null, null, 0, false));
+        chckbxProvideJacobian = new JCheckBox();
+        chckbxProvideJacobian.setOpaque(false);
+        chckbxProvideJacobian.setSelected(true);
+        chckbxProvideJacobian.setText("Provide Jacobian");
+        panel12.add(chckbxProvideJacobian, new GridConstraints(10, 1, 1, 1, GridConstraints.ANCHOR_WEST, GridConstraints.FILL_NONE, GridConstraints.SIZEPOLICY_CAN_SHRINK | GridConstraints.SIZEPOLICY_CAN_GROW, GridConstraints.SIZEPOLICY_FIXED, null, null, null, 0, false));
+        chckbxProfileFMICalls = new JCheckBox();
+        chckbxProfileFMICalls.setOpaque(false);
+        chckbxProfileFMICalls.setText("Profile FMI calls");
+        panel12.add(chckbxProfileFMICalls, new GridConstraints(11, 1, 1, 1, GridConstraints.ANCHOR_WEST, GridConstraints.FILL_NONE, GridConstraints.SIZEPOLICY_CAN_SHRINK | GridConstraints.SIZEPOLICY_CAN_GROW, GridConstraints.SIZEPOLICY_FIXED, null, null, null, 0, false));
     }
 
     /**
@@ -32,6 +32,12 @@ public class UserData {
 
 	public boolean logToFile = false;
 
+	public boolean locateStateEvents = false;
+
+	public boolean provideJacobian = true;
+
+	public boolean profileFMICalls = false;
+
 	public String relativeTolerance;
 
 	public String sampleTime;
@@ -60,6 +66,8 @@ public class UserData {
 		public String label;
 
 		public ArrayList<String> variables = new ArrayList<String>();
+
+		public boolean majorStepOnly = false;
 		
 	}
 
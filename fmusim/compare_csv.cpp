@@ -0,0 +1,156 @@
+/*****************************************************************
+ *  Copyright (c) Dassault Systemes. All rights reserved.        *
+ *  This file is part of FMIKit. See LICENSE.txt in the project  *
+ *  root for license information.                                *
+ *****************************************************************/
+
+/* Compares a CSV result with a reference (used by the fmusim tests)
+
+   usage: compare_csv [--interpolate] <result> <reference> <tolerance>
+
+   Every column of the result is compared with the column of the reference that has the same
+   name or, for the outputs of fmusim --instances (<name>_<i>), the column <name>. The files must
+   have the same number of rows unless --interpolate is given, in which case the reference is
+   interpolated linearly at the times of the result (first column). A value fails if it differs
+   from the reference by more than tolerance * max(1, |reference|). */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static bool readCSV(const char *filename, vector<string> &names, vector<vector<double>> &rows) {
+
+	ifstream file(filename);
+	string line;
+
+	if (!file || !getline(file, line)) {
+		fprintf(stderr, "Failed to read %s\n", filename);
+		return false;
+	}
+
+	stringstream header(line);
+	string name;
+
+	while (getline(header, name, ',')) names.push_back(name);
+
+	while (getline(file, line)) {
+
+		if (line.empty()) continue;
+
+		vector<double> row;
+		stringstream ss(line);
+		string cell;
+
+		while (getline(ss, cell, ',')) row.push_back(strtod(cell.c_str(), nullptr));
+
+		if (row.size() != names.size()) {
+			fprintf(stderr, "The number of values in row %zu of %s differs from the header: %zu != %zu\n", rows.size() + 2, filename, row.size(), names.size());
+			return false;
+		}
+
+		rows.push_back(row);
+	}
+
+	return true;
+}
+
+// returns the index of the reference column for the result column name or -1
+static int findColumn(const vector<string> &names, const string &name) {
+
+	auto it = find(names.begin(), names.end(), name);
+
+	// outputs of fmusim --instances are written as <name>_<i>
+	const size_t pos = name.find_last_of('_');
+
+	if (it == names.end() && pos != string::npos && pos + 1 < name.size() && name.find_first_not_of("0123456789", pos + 1) == string::npos) {
+		it = find(names.begin(), names.end(), name.substr(0, pos));
+	}
+
+	return it == names.end() ? -1 : static_cast<int>(it - names.begin());
+}
+
+// interpolates the column linearly at time (the value after an event if the time is an event row)
+static double interpolate(const vector<vector<double>> &rows, size_t column, double time) {
+
+	auto next = upper_bound(rows.begin(), rows.end(), time, [](double t, const vector<double> &row) { return t < row[0]; });
+
+	if (next == rows.begin()) return rows.front()[column];
+	if (next == rows.end()) return rows.back()[column];
+
+	const vector<double> &prev = *(next - 1);
+
+	if (prev[0] == time) return prev[column];
+
+	const double t0 = prev[0];
+	const double t1 = (*next)[0];
+
+	return prev[column] + (time - t0) / (t1 - t0) * ((*next)[column] - prev[column]);
+}
+
+int main(int argc, char *argv[]) {
+
+	const bool interpolated = argc == 5 && string(argv[1]) == "--interpolate";
+
+	if (argc != 4 && !interpolated) {
+		fprintf(stderr, "usage: compare_csv [--interpolate] <result> <reference> <tolerance>\n");
+		return 2;
+	}
+
+	const char *resultFile    = argv[argc - 3];
+	const char *referenceFile = argv[argc - 2];
+	const double tolerance    = atof(argv[argc - 1]);
+
+	vector<string> names, refNames;
+	vector<vector<double>> rows, refRows;
+
+	if (!readCSV(resultFile, names, rows) || !readCSV(referenceFile, refNames, refRows)) return 1;
+
+	vector<int> columns;
+
+	for (const auto &name : names) {
+
+		const int column = findColumn(refNames, name);
+
+		if (column < 0) {
+			fprintf(stderr, "The reference has no column \"%s\"\n", name.c_str());
+			return 1;
+		}
+
+		columns.push_back(column);
+	}
+
+	if (interpolated ? refRows.empty() : rows.size() != refRows.size()) {
+		fprintf(stderr, "The number of rows differs: %zu != %zu\n", rows.size(), refRows.size());
+		return 1;
+	}
+
+	double maxError = 0;
+
+	for (size_t i = 0; i < rows.size(); i++) {
+
+		for (size_t j = 0; j < rows[i].size(); j++) {
+
+			const double ref = interpolated ? interpolate(refRows, columns[j], rows[i][0]) : refRows[i][columns[j]];
+
+			const double error = fabs(rows[i][j] - ref) / fmax(1.0, fabs(ref));
+
+			if (!(error <= tolerance)) {
+				fprintf(stderr, "Row %zu, column %zu: %.16g != %.16g (reference)\n", i + 2, j + 1, rows[i][j], ref);
+				return 1;
+			}
+
+			maxError = fmax(maxError, error);
+		}
+	}
+
+	printf("%zu rows, maximum error %g\n", rows.size(), maxError);
+
+	return 0;
+}
@@ -0,0 +1,357 @@
+/*****************************************************************
+ *  Copyright (c) Dassault Systemes. All rights reserved.        *
+ *  This file is part of FMIKit. See LICENSE.txt in the project  *
+ *  root for license information.                                *
+ *****************************************************************/
+
+/* Simulates an extracted FMI 2.0 model exchange FMU without MATLAB, or n instances of its
+   co-simulation interface in parallel (--instances)
+
+   usage: fmusim <unzipdir> <modelIdentifier> <guid> <nx> <nz> [options]
+
+   options: --solver rk4|dopri|bdf      solver (default: dopri)
+            --start-time <t>            start time (default: 0)
+            --stop-time <t>             stop time (default: 1)
+            --output-interval <dt>      output interval (default: 0.01)
+            --step-size <h>             (initial / maximum) step size (default: 1e-3)
+            --tolerance <rtol>          relative tolerance (default: 1e-6)
+            --set <vr>=<value>          start value of a Real variable
+            --output <name>[=<vr>]      Real variable to write to the result
+            --states <vr>,<vr>,...      value references of the continuous states and
+            --derivatives <vr>,<vr>,... their derivatives (for directional derivatives, default:
+                                        from the modelDescription.xml)
+            --result <file>             CSV result file (default: stdout)
+            --statistics <file>         write the number of calls and latencies of the FMI functions
+                                        to file ("-" for stderr)
+            --timeline <file>           write the FMI calls to a timeline in the trace event format
+                                        (open in https://ui.perfetto.dev)
+            --instances <n>             simulate n instances of the co-simulation interface with a
+                                        communication step of --output-interval (the outputs of
+                                        instance i are written as <name>_<i>)
+            --workers <n>               number of threads that step the instances (default: one
+                                        per hardware thread) */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "CallStatistics.h"
+#include "CallTimeline.h"
+#include "FMU2.h"
+#include "ModelDescription.h"
+#include "ModelDriver.h"
+#include "SlaveGroup.h"
+
+using namespace std;
+using namespace fmikit;
+
+static const char *levelToString(LogLevel level) {
+	switch (level) {
+	case 0:  return "OK";
+	case 1:  return "Warning";
+	case 2:  return "Discard";
+	case 3:  return "Error";
+	case 4:  return "Fatal";
+	case 5:  return "Pending";
+	default: return "?";
+	}
+}
+
+static void logMessage(FMU *instance, LogLevel level, const char *, const char* message) {
+	fprintf(stderr, "[%s] %s\n", levelToString(level), message);
+	if (instance && instance->m_callTimeline) instance->m_callTimeline->instant(message, instance->getTime());
+}
+
+static void usage() {
+	fprintf(stderr, "usage: fmusim <unzipdir> <modelIdentifier> <guid> <nx> <nz> [--solver rk4|dopri|bdf] [--start-time <t>]\n"
+	                "              [--stop-time <t>] [--output-interval <dt>] [--step-size <h>] [--tolerance <rtol>]\n"
+	                "              [--set <vr>=<value>] [--output <name>[=<vr>]] [--states <vr>,...] [--derivatives <vr>,...]\n"
+	                "              [--result <file>] [--statistics <file>] [--timeline <file>] [--instances <n>] [--workers <n>]\n");
+}
+
+static vector<ValueReference> parseValueReferences(const char *list) {
+
+	vector<ValueReference> vr;
+
+	for (const char *p = list; *p;) {
+		char *end;
+		vr.push_back(static_cast<ValueReference>(strtoul(p, &end, 10)));
+		if (end == p) throw runtime_error(string("Invalid value reference list: ") + list);
+		p = *end == ',' ? end + 1 : end;
+	}
+
+	return vr;
+}
+
+// splits "<key>=<value>"
+static void parseAssignment(const char *arg, string &key, string &value) {
+
+	auto sep = strchr(arg, '=');
+
+	if (!sep) throw runtime_error(string("Expected <key>=<value> but was ") + arg);
+
+	key = string(arg, sep);
+	value = sep + 1;
+}
+
+// simulates n instances of the co-simulation interface on a SlaveGroup
+static void cosimulate(const string &unzipDirectory, const string &modelIdentifier, const string &guid, size_t n, size_t numWorkers,
+	const DriverSettings &settings, const vector<ValueReference> &startVRs, const vector<double> &startValues,
+	const vector<string> &outputNames, const vector<ValueReference> &outputVRs, FILE *result) {
+
+	TransferPlan outputs;
+
+	if (!outputVRs.empty()) outputs.addPort(REAL, outputVRs.data(), outputVRs.size());
+
+	SlaveGroup group(numWorkers);
+
+	for (size_t i = 0; i < n; i++) {
+
+		unique_ptr<FMU2Slave> slave(new FMU2Slave(guid, modelIdentifier, unzipDirectory, modelIdentifier + "_" + to_string(i)));
+
+		slave->instantiate(false);
+		slave->setReal(startVRs.data(), startVRs.size(), startValues.data());
+		slave->setupExperiment(true, settings.relativeTolerance, settings.startTime, true, settings.stopTime);
+		slave->enterInitializationMode();
+		slave->exitInitializationMode();
+
+		group.add(slave.release(), TransferPlan(), outputs);
+	}
+
+	fprintf(result, "time");
+
+	for (size_t i = 0; i < n; i++) {
+		for (const auto &name : outputNames) fprintf(result, ",%s_%zu", name.c_str(), i);
+	}
+
+	fprintf(result, "\n");
+
+	vector<double> values(outputVRs.size());
+
+	double time = settings.startTime;
+
+	const auto start = chrono::steady_clock::now();
+
+	for (size_t step = 0;; step++) {
+
+		fprintf(result, "%.16g", time);
+
+		for (size_t i = 0; i < n; i++) {
+
+			const double *y = values.data();
+
+			if (step == 0) {
+				group.instance(i)->getReal(outputVRs.data(), outputVRs.size(), values.data());
+			} else if (!outputVRs.empty()) {
+				y = static_cast<const double *>(group.output(i, 0));
+			}
+
+			for (size_t j = 0; j < outputVRs.size(); j++) fprintf(result, ",%.16g", y[j]);
+		}
+
+		fprintf(result, "\n");
+
+		if (time >= settings.stopTime) break;
+
+		double next = settings.startTime + (step + 1) * settings.outputInterval;
+
+		// avoid a tiny last step
+		if (next > settings.stopTime - 1e-10 * settings.outputInterval) next = settings.stopTime;
+
+		group.doStep(next - time);
+
+		time = next;
+	}
+
+	const double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	fprintf(stderr, "t=%g, instances=%zu, workers=%zu, %.3f ms\n", time, group.size(), group.numWorkers(), elapsed * 1e3);
+}
+
+static int simulate(int argc, char *argv[]) {
+
+	const string unzipDirectory  = argv[1];
+	const string modelIdentifier = argv[2];
+	const string guid            = argv[3];
+	const size_t nx              = strtoul(argv[4], nullptr, 10);
+	const size_t nz              = strtoul(argv[5], nullptr, 10);
+
+	const ModelDescription modelDescription(unzipDirectory + "/modelDescription.xml");
+
+	DriverSettings settings;
+	vector<ValueReference> startVRs;
+	vector<double> startValues;
+	vector<string> outputNames;
+	vector<ValueReference> outputVRs;
+	const char *resultFile = nullptr;
+	const char *statisticsFile = nullptr;
+	const char *timelineFile = nullptr;
+	size_t instances = 0;
+	size_t numWorkers = 0;
+
+	for (int i = 6; i < argc; i++) {
+
+		const string option = argv[i];
+
+		if (i + 1 >= argc) throw runtime_error("Missing value for " + option);
+
+		const char *value = argv[++i];
+
+		if (option == "--solver") {
+			if (strcmp(value, "rk4") == 0) {
+				settings.solver = RK4;
+			} else if (strcmp(value, "dopri") == 0) {
+				settings.solver = DORMAND_PRINCE;
+			} else if (strcmp(value, "bdf") == 0) {
+				settings.solver = BDF;
+			} else {
+				throw runtime_error(string("Unknown solver: ") + value);
+			}
+		} else if (option == "--start-time") {
+			settings.startTime = atof(value);
+		} else if (option == "--stop-time") {
+			settings.stopTime = atof(value);
+		} else if (option == "--output-interval") {
+			settings.outputInterval = atof(value);
+		} else if (option == "--step-size") {
+			settings.stepSize = atof(value);
+		} else if (option == "--tolerance") {
+			settings.relativeTolerance = atof(value);
+		} else if (option == "--set") {
+			string key, v;
+			parseAssignment(value, key, v);
+			startVRs.push_back(static_cast<ValueReference>(stoul(key)));
+			startValues.push_back(stod(v));
+		} else if (option == "--output") {
+			if (strchr(value, '=')) {
+				string name, vr;
+				parseAssignment(value, name, vr);
+				outputNames.push_back(name);
+				outputVRs.push_back(static_cast<ValueReference>(stoul(vr)));
+			} else {
+				auto variable = modelDescription.variable(value);
+				if (!variable || variable->type != REAL) throw runtime_error(string("Unknown Real variable: ") + value);
+				outputNames.push_back(value);
+				outputVRs.push_back(variable->valueReference);
+			}
+		} else if (option == "--states") {
+			settings.states = parseValueReferences(value);
+		} else if (option == "--derivatives") {
+			settings.derivatives = parseValueReferences(value);
+		} else if (option == "--result") {
+			resultFile = value;
+		} else if (option == "--statistics") {
+			statisticsFile = value;
+		} else if (option == "--timeline") {
+			timelineFile = value;
+		} else if (option == "--instances") {
+			instances = strtoul(value, nullptr, 10);
+		} else if (option == "--workers") {
+			numWorkers = strtoul(value, nullptr, 10);
+		} else {
+			throw runtime_error("Unknown option: " + option);
+		}
+	}
+
+	// use the directional derivatives declared by the FMU
+	if (settings.states.empty() && settings.derivatives.empty() && modelDescription.modelExchange().providesDirectionalDerivative) {
+		modelDescription.getStates(settings.states, settings.derivatives);
+	}
+
+	FMU::m_messageLogger = logMessage;
+
+	if (instances > 0) {
+
+		if (statisticsFile || timelineFile) throw runtime_error("--statistics and --timeline are not supported with --instances");
+
+		FILE *result = stdout;
+
+		if (resultFile) {
+			result = fopen(resultFile, "w");
+			if (!result) throw runtime_error(string("Failed to open ") + resultFile);
+		}
+
+		try {
+			cosimulate(unzipDirectory, modelIdentifier, guid, instances, numWorkers, settings, startVRs, startValues, outputNames, outputVRs, result);
+		} catch (...) {
+			if (result != stdout) fclose(result);
+			throw;
+		}
+
+		if (result != stdout) fclose(result);
+
+		return 0;
+	}
+
+	CallStatistics statistics; // must outlive the model
+	unique_ptr<CallTimeline> timeline;
+
+	if (timelineFile) timeline.reset(new CallTimeline(timelineFile, modelIdentifier));
+
+	unique_ptr<FMU2Model> model(new FMU2Model(guid, modelIdentifier, unzipDirectory, modelIdentifier));
+
+	if (statisticsFile) model->m_callStatistics = &statistics;
+	model->m_callTimeline = timeline.get();
+
+	model->instantiate(false);
+	model->setReal(startVRs.data(), startVRs.size(), startValues.data());
+
+	ModelDriver driver(model.get(), nx, nz, settings);
+	driver.setOutputs(outputNames, outputVRs);
+
+	FILE *result = stdout;
+
+	if (resultFile) {
+		result = fopen(resultFile, "w");
+		if (!result) throw runtime_error(string("Failed to open ") + resultFile);
+	}
+
+	const auto start = chrono::steady_clock::now();
+
+	try {
+		driver.simulate(result);
+	} catch (...) {
+		if (result != stdout) fclose(result);
+		throw;
+	}
+
+	const double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	if (result != stdout) fclose(result);
+
+	fprintf(stderr, "t=%g, steps=%zu, rejected=%zu, events=%zu, %.3f ms\n",
+		driver.time(), driver.steps(), driver.rejectedSteps(), driver.events(), elapsed * 1e3);
+
+	if (statisticsFile) {
+
+		// include fmi2Terminate and fmi2FreeInstance
+		model.reset();
+
+		FILE *file = strcmp(statisticsFile, "-") == 0 ? stderr : fopen(statisticsFile, "w");
+		if (!file) throw runtime_error(string("Failed to open ") + statisticsFile);
+		fputs(statistics.format(FMI_VERSION_2).c_str(), file);
+		if (file != stderr) fclose(file);
+	}
+
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+
+	if (argc < 6) {
+		usage();
+		return 2;
+	}
+
+	try {
+		return simulate(argc, argv);
+	} catch (const exception &e) {
+		fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+}
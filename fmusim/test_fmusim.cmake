@@ -0,0 +1,16 @@
+# Simulates an FMU with fmusim and compares the result with a reference
+#
+# cmake -DFMUSIM=<fmusim> -DCOMPARE_CSV=<compare_csv> -DARGS=<arguments> -DRESULT=<file> -DREFERENCE=<file> -DTOLERANCE=<tol>
+#       [-DCOMPARE_OPTIONS=<options>] -P test_fmusim.cmake
+
+execute_process(COMMAND ${FMUSIM} ${ARGS} --result ${RESULT} RESULT_VARIABLE status)
+
+if (NOT status EQUAL 0)
+  message(FATAL_ERROR "fmusim failed: ${status}")
+endif ()
+
+execute_process(COMMAND ${COMPARE_CSV} ${COMPARE_OPTIONS} ${RESULT} ${REFERENCE} ${TOLERANCE} RESULT_VARIABLE status)
+
+if (NOT status EQUAL 0)
+  message(FATAL_ERROR "The result ${RESULT} differs from the reference ${REFERENCE}")
+endif ()
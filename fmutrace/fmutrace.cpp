@@ -0,0 +1,478 @@
+/*****************************************************************
+ *  Copyright (c) Dassault Systemes. All rights reserved.        *
+ *  This file is part of FMIKit. See LICENSE.txt in the project  *
+ *  root for license information.                                *
+ *****************************************************************/
+
+/* Decodes binary FMI call traces written by sfun_fmurun (log file *.fmitrace)
+   and replays them against the FMU's shared library
+
+   usage: fmutrace decode <trace>
+          fmutrace replay <trace> [<unzipdir>] */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "FMU1.h"
+#include "FMU2.h"
+#include "CallTrace.h"
+
+using namespace std;
+using namespace fmikit;
+
+// maximum number of reported mismatches
+#define MAX_MISMATCHES 20
+
+static const char *statusToString(int status) {
+	switch (status) {
+	case 0:  return "OK";
+	case 1:  return "Warning";
+	case 2:  return "Discard";
+	case 3:  return "Error";
+	case 4:  return "Fatal";
+	case 5:  return "Pending";
+	default: return "?";
+	}
+}
+
+static const char *kindToString(Kind kind) {
+	return kind == CO_SIMULATION ? "CoSimulation" : "ModelExchange";
+}
+
+static void printRecord(const TraceRecord &r, FMIVersion fmiVersion) {
+
+	printf("%12.6f ms  t=%-12.6g %s(", r.wallTime * 1e-6, r.time, traceFunctionName(r.function, fmiVersion));
+
+	if (r.function == TRACE_MESSAGE) {
+		printf("\"%s\")\n", r.strings.empty() ? "" : r.strings[0].c_str());
+		return;
+	}
+
+	if (!r.vr.empty()) {
+		printf("vr=[");
+		for (size_t i = 0; i < r.vr.size(); i++) printf(i ? ", %u" : "%u", r.vr[i]);
+		printf("]");
+	}
+
+	if (r.size() > 0) {
+
+		printf(r.vr.empty() ? "[" : ", value=[");
+
+		for (size_t i = 0; i < r.size(); i++) {
+			if (i) printf(", ");
+			switch (r.type) {
+			case REAL:    printf("%.16g", r.reals[i]); break;
+			case INTEGER: printf("%d", r.integers[i]); break;
+			case BOOLEAN: printf("%s", r.booleans[i] ? "true" : "false"); break;
+			case STRING:  printf("\"%s\"", r.strings[i].c_str()); break;
+			}
+		}
+
+		printf("]");
+	}
+
+	printf("): %s\n", statusToString(r.status));
+}
+
+static int decode(const char *filename) {
+
+	CallTraceReader reader(filename);
+
+	auto &h = reader.header();
+
+	printf("FMI %s %s\n", h.fmiVersion == FMI_VERSION_1 ? "1.0" : "2.0", kindToString(h.kind));
+	printf("guid:            %s\n", h.guid.c_str());
+	printf("modelIdentifier: %s\n", h.modelIdentifier.c_str());
+	printf("unzipDirectory:  %s\n", h.unzipDirectory.c_str());
+	printf("instanceName:    %s\n", h.instanceName.c_str());
+	printf("\n");
+
+	TraceRecord r;
+
+	while (reader.next(r)) {
+		printRecord(r, h.fmiVersion);
+	}
+
+	return 0;
+}
+
+static void logMessage(FMU *, LogLevel level, const char *, const char* message) {
+	fprintf(stderr, "[%s] %s\n", statusToString(level), message);
+}
+
+/* Replays the recorded calls and compares the values returned by the FMU */
+class Replay {
+
+public:
+	Replay(const TraceHeader &header, const string &unzipDirectory) : m_fmiVersion(header.fmiVersion) {
+
+		if (header.fmiVersion == FMI_VERSION_1) {
+			if (header.kind == CO_SIMULATION) {
+				m_fmu.reset(m_fmu1Slave = new FMU1Slave(header.guid, header.modelIdentifier, unzipDirectory, header.instanceName));
+			} else {
+				m_fmu.reset(m_fmu1Model = new FMU1Model(header.guid, header.modelIdentifier, unzipDirectory, header.instanceName));
+			}
+		} else {
+			if (header.kind == CO_SIMULATION) {
+				m_fmu.reset(m_fmu2Slave = new FMU2Slave(header.guid, header.modelIdentifier, unzipDirectory, header.instanceName));
+			} else {
+				m_fmu.reset(m_fmu2Model = new FMU2Model(header.guid, header.modelIdentifier, unzipDirectory, header.instanceName));
+			}
+		}
+
+		m_fmu->setLogLevel(LOG_INFO);
+
+		m_unzipDirectory = unzipDirectory;
+	}
+
+	// calls the recorded function, returns false if the call was skipped
+	bool call(const TraceRecord &r) {
+
+		const size_t n = r.size();
+
+		switch (r.function) {
+
+		case TRACE_INSTANTIATE:
+			if (m_fmu1Slave) {
+				m_fmu1Slave->instantiateSlave(m_unzipDirectory, r.value(0), r.value(1) != 0);
+			} else if (m_fmu1Model) {
+				m_fmu1Model->instantiateModel(r.value(0) != 0);
+			} else {
+				fmu2()->instantiate(r.value(0) != 0);
+			}
+			return true;
+
+		case TRACE_SETUP_EXPERIMENT:
+			fmu2()->setupExperiment(r.value(0) != 0, r.value(1), r.value(2), r.value(3) != 0, r.value(4));
+			return true;
+
+		case TRACE_ENTER_INITIALIZATION_MODE:
+			fmu2()->enterInitializationMode();
+			return true;
+
+		case TRACE_EXIT_INITIALIZATION_MODE:
+			fmu2()->exitInitializationMode();
+			return true;
+
+		case TRACE_INITIALIZE:
+			if (m_fmu1Slave) {
+				m_fmu1Slave->initializeSlave(r.value(0), r.value(1) != 0, r.value(2));
+			} else {
+				fmu1Model()->initialize(r.value(0) != 0, r.value(1));
+			}
+			return true;
+
+		case TRACE_GET_REAL:
+			m_reals.resize(n);
+			m_fmu->getReal(r.vr.data(), r.vr.size(), m_reals.data());
+			for (size_t i = 0; i < n; i++) compare(r, i, m_reals[i]);
+			return true;
+
+		case TRACE_GET_INTEGER:
+			m_integers.resize(n);
+			m_fmu->getInteger(r.vr.data(), r.vr.size(), m_integers.data());
+			for (size_t i = 0; i < n; i++) compare(r, i, m_integers[i]);
+			return true;
+
+		case TRACE_GET_BOOLEAN:
+			m_booleans.reset(new bool[n]);
+			m_fmu->getBoolean(r.vr.data(), r.vr.size(), m_booleans.get());
+			for (size_t i = 0; i < n; i++) compare(r, i, m_booleans[i] ? 1.0 : 0.0);
+			return true;
+
+		case TRACE_GET_STRING:
+			for (size_t i = 0; i < n; i++) {
+				auto value = m_fmu->getString(r.vr[i]);
+				if (value != r.strings[i]) mismatch(r, i, "\"" + r.strings[i] + "\"", "\"" + value + "\"");
+			}
+			return true;
+
+		case TRACE_SET_REAL:
+			m_fmu->setReal(r.vr.data(), r.vr.size(), r.reals.data());
+			return true;
+
+		case TRACE_SET_INTEGER:
+			m_fmu->setInteger(r.vr.data(), r.vr.size(), r.integers.data());
+			return true;
+
+		case TRACE_SET_BOOLEAN:
+			m_booleans.reset(new bool[n]);
+			for (size_t i = 0; i < n; i++) m_booleans[i] = r.booleans[i];
+			m_fmu->setBoolean(r.vr.data(), r.vr.size(), m_booleans.get());
+			return true;
+
+		case TRACE_SET_STRING:
+			for (size_t i = 0; i < n; i++) m_fmu->setString(r.vr[i], r.strings[i]);
+			return true;
+
+		case TRACE_SET_REAL_INPUT_DERIVATIVES:
+			slave()->setRealInputDerivative(r.vr[0], static_cast<int>(r.value(0)), r.value(1));
+			return true;
+
+		case TRACE_DO_STEP:
+			slave()->doStep(r.value(1));
+			return true;
+
+		case TRACE_GET_BOOLEAN_STATUS:
+			if (!m_fmu2Slave) return false;
+			compare(r, 0, m_fmu2Slave->terminated() ? 1.0 : 0.0);
+			return true;
+
+		case TRACE_SET_TIME:
+			model()->setTime(r.value(0));
+			return true;
+
+		case TRACE_SET_CONTINUOUS_STATES:
+			model()->setContinuousStates(r.reals.data(), n);
+			return true;
+
+		case TRACE_GET_CONTINUOUS_STATES:
+			m_reals.resize(n);
+			model()->getContinuousStates(m_reals.data(), n);
+			for (size_t i = 0; i < n; i++) compare(r, i, m_reals[i]);
+			return true;
+
+		case TRACE_GET_NOMINALS_OF_CONTINUOUS_STATES:
+			m_reals.resize(n);
+			model()->getNominalContinuousStates(m_reals.data(), n);
+			for (size_t i = 0; i < n; i++) compare(r, i, m_reals[i]);
+			return true;
+
+		case TRACE_GET_DERIVATIVES:
+			m_reals.resize(n);
+			model()->getDerivatives(m_reals.data(), n);
+			for (size_t i = 0; i < n; i++) compare(r, i, m_reals[i]);
+			return true;
+
+		case TRACE_GET_EVENT_INDICATORS:
+			m_reals.resize(n);
+			model()->getEventIndicators(m_reals.data(), n);
+			for (size_t i = 0; i < n; i++) compare(r, i, m_reals[i]);
+			return true;
+
+		case TRACE_COMPLETED_INTEGRATOR_STEP:
+			compare(r, 0, model()->completedIntegratorStep() ? 1.0 : 0.0);
+			return true;
+
+		case TRACE_ENTER_EVENT_MODE:
+			fmu2Model()->enterEventMode();
+			return true;
+
+		case TRACE_NEW_DISCRETE_STATES:
+			fmu2Model()->newDiscreteStates();
+			compare(r, 0, fmu2Model()->newDiscreteStatesNeeded() ? 1.0 : 0.0);
+			compare(r, 1, fmu2Model()->terminateSimulation() ? 1.0 : 0.0);
+			compare(r, 5, fmu2Model()->nextEventTime());
+			return true;
+
+		case TRACE_ENTER_CONTINUOUS_TIME_MODE:
+			fmu2Model()->enterContinuousTimeMode();
+			return true;
+
+		case TRACE_GET_FMU_STATE: {
+			// the slots are not released in the trace so a recorded slot is mapped to the first slot it was saved to
+			const auto slot = static_cast<size_t>(r.value(0));
+			const auto it = m_stateSlots.find(slot);
+			if (it == m_stateSlots.end()) {
+				m_stateSlots[slot] = fmu2()->saveState();
+			} else {
+				fmu2()->saveState(it->second);
+			}
+			return true;
+		}
+
+		case TRACE_SET_FMU_STATE: {
+			const auto it = m_stateSlots.find(static_cast<size_t>(r.value(0)));
+			if (it == m_stateSlots.end()) throw runtime_error("FMU state was not saved");
+			fmu2()->restoreState(it->second);
+			return true;
+		}
+
+		case TRACE_EVENT_UPDATE:
+			fmu1Model()->eventUpdate();
+			compare(r, 0, fmu1Model()->iterationConverged() ? 1.0 : 0.0);
+			compare(r, 3, fmu1Model()->terminateSimulation() ? 1.0 : 0.0);
+			compare(r, 5, fmu1Model()->nextEventTime());
+			return true;
+
+		default:
+			// messages, directional derivatives (the seed is not recorded) and terminate / free instance (called by the destructor)
+			return false;
+		}
+	}
+
+	// terminates and frees the instance
+	void free() {
+		m_fmu.reset();
+	}
+
+	size_t mismatches() const { return m_mismatches; }
+
+private:
+	FMIVersion m_fmiVersion;
+	string m_unzipDirectory;
+	unique_ptr<FMU> m_fmu;
+	FMU1Slave *m_fmu1Slave = nullptr;
+	FMU1Model *m_fmu1Model = nullptr;
+	FMU2Slave *m_fmu2Slave = nullptr;
+	FMU2Model *m_fmu2Model = nullptr;
+	vector<double> m_reals;
+	vector<int> m_integers;
+	unique_ptr<bool[]> m_booleans;
+	map<size_t, size_t> m_stateSlots; // recorded -> replayed FMU state slots
+	size_t m_mismatches = 0;
+
+	FMU2 *fmu2() {
+		if (m_fmiVersion != FMI_VERSION_2) throw runtime_error("Unexpected FMI 2.0 call in FMI 1.0 trace");
+		return static_cast<FMU2 *>(m_fmu.get());
+	}
+
+	FMU2Model *fmu2Model() {
+		if (!m_fmu2Model) throw runtime_error("Unexpected FMI 2.0 Model Exchange call");
+		return m_fmu2Model;
+	}
+
+	FMU1Model *fmu1Model() {
+		if (!m_fmu1Model) throw runtime_error("Unexpected FMI 1.0 Model Exchange call");
+		return m_fmu1Model;
+	}
+
+	Slave *slave() {
+		if (m_fmu1Slave) return m_fmu1Slave;
+		if (m_fmu2Slave) return m_fmu2Slave;
+		throw runtime_error("Unexpected Co-Simulation call");
+	}
+
+	Model *model() {
+		if (m_fmu1Model) return m_fmu1Model;
+		if (m_fmu2Model) return m_fmu2Model;
+		throw runtime_error("Unexpected Model Exchange call");
+	}
+
+	void compare(const TraceRecord &r, size_t index, double actual) {
+
+		if (index >= r.size()) return;
+
+		const double expected = r.value(index);
+
+		// values are replayed bit-exact, so NaN is the only special case
+		if (expected == actual || (isnan(expected) && isnan(actual))) return;
+
+		char e[64], a[64];
+		snprintf(e, 64, "%.16g", expected);
+		snprintf(a, 64, "%.16g", actual);
+		mismatch(r, index, e, a);
+	}
+
+	void mismatch(const TraceRecord &r, size_t index, const string &expected, const string &actual) {
+
+		if (m_mismatches++ >= MAX_MISMATCHES) return;
+
+		printf("Mismatch at t=%g in %s", r.time, traceFunctionName(r.function, m_fmiVersion));
+
+		if (index < r.vr.size()) {
+			printf(" (vr=%u)", r.vr[index]);
+		} else {
+			printf(" (index %u)", static_cast<unsigned int>(index));
+		}
+
+		printf(": expected %s, got %s\n", expected.c_str(), actual.c_str());
+	}
+
+};
+
+static int replay(const char *filename, const char *unzipDirectory) {
+
+	CallTraceReader reader(filename);
+
+	auto &h = reader.header();
+
+	FMU::m_messageLogger = logMessage;
+
+	Replay replay(h, unzipDirectory ? unzipDirectory : h.unzipDirectory);
+
+	struct Statistics {
+		size_t calls = 0;
+		double recorded = 0; // wall time between the previous and this record in the trace [s]
+		double replayed = 0; // wall time of the replayed call [s]
+	};
+
+	vector<Statistics> statistics(NUM_TRACE_FUNCTIONS);
+
+	TraceRecord r;
+	uint64_t previousWallTime = 0;
+	size_t records = 0;
+	double total = 0;
+
+	while (reader.next(r)) {
+
+		records++;
+
+		const double recorded = (r.wallTime - previousWallTime) * 1e-9;
+		previousWallTime = r.wallTime;
+
+		const auto start = chrono::steady_clock::now();
+
+		if (!replay.call(r)) continue;
+
+		const double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+		total += elapsed;
+
+		if (r.function < NUM_TRACE_FUNCTIONS) {
+			auto &s = statistics[r.function];
+			s.calls++;
+			s.recorded += recorded;
+			s.replayed += elapsed;
+		}
+	}
+
+	replay.free();
+
+	printf("\n%-36s %10s %14s %14s\n", "function", "calls", "recorded [ms]", "replayed [ms]");
+
+	for (int i = 0; i < NUM_TRACE_FUNCTIONS; i++) {
+		auto &s = statistics[i];
+		if (s.calls == 0) continue;
+		printf("%-36s %10u %14.3f %14.3f\n", traceFunctionName(static_cast<TraceFunction>(i), h.fmiVersion),
+			static_cast<unsigned int>(s.calls), s.recorded * 1e3, s.replayed * 1e3);
+	}
+
+	printf("\nReplayed %u records in %.3f ms (recorded: %.3f ms), %u mismatches\n",
+		static_cast<unsigned int>(records), total * 1e3, previousWallTime * 1e-6, static_cast<unsigned int>(replay.mismatches()));
+
+	return replay.mismatches() > 0 ? 1 : 0;
+}
+
+int main(int argc, char *argv[]) {
+
+	if (argc >= 3 && strcmp(argv[1], "decode") == 0) {
+		try {
+			return decode(argv[2]);
+		} catch (const exception &e) {
+			fprintf(stderr, "%s\n", e.what());
+			return 2;
+		}
+	}
+
+	if (argc >= 3 && strcmp(argv[1], "replay") == 0) {
+		try {
+			return replay(argv[2], argc > 3 ? argv[3] : nullptr);
+		} catch (const exception &e) {
+			fprintf(stderr, "%s\n", e.what());
+			return 2;
+		}
+	}
+
+	fprintf(stderr, "usage: fmutrace decode <trace>\n"
+	                "       fmutrace replay <trace> [<unzipdir>]\n");
+
+	return 2;
+}
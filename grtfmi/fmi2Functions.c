@@ -5,53 +5,284 @@
 #include <float.h>  /* for DBL_EPSILON, FLT_MAX */
 #include <math.h>   /* for fabs() */
 #include <string.h> /* for strcpy(), strncmp() */
+#include <time.h>   /* for time() */
+
+#ifdef THREADED_MULTITASKING
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+#endif
 
 #include "fmiwrapper.inc"
 
 #include "fmi2Functions.h"
 
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
 const char *RT_MEMORY_ALLOCATION_ERROR = "memory allocation error";
 
-/* Path to the resources directory of the extracted FMU */
-const char *FMU_RESOURCES_DIR = NULL;
+/* Path to the resources directory of the instance that is executing the model on this thread
+   (set before the model is called, used by nested FMUs) */
+THREAD_LOCAL const char *FMU_RESOURCES_DIR = NULL;
 
 
 int rtPrintfNoOp(const char *fmt, ...) {
 	return 0;  /* do nothing */
 }
 
+#if NUM_TASKS > 1 && defined(THREADED_MULTITASKING)
+#define TASK_POOL
+typedef struct TaskPool TaskPool;
+#endif
+
 typedef struct {
 	RT_MDL_TYPE *S;
 	const char *instanceName;
 	fmi2CallbackLogger logger;
 	fmi2ComponentEnvironment componentEnvironment;
+	char *resourcesDir;
+#ifdef TASK_POOL
+	TaskPool *taskPool;
+#endif
 	ModelVariable modelVariables[N_MODEL_VARIABLES];
+#ifdef REUSABLE_FUNCTION
+	InstanceId instanceId; /* identifies the model data in FMU states */
+#endif
 } ModelInstance;
 
-static void setResourcePath(const char *uri) {
+#ifdef TASK_POOL
+
+/* Threaded multitasking: every subrate task runs on its own worker thread, following the rules of
+   rate monotonic scheduling on a preemptive RTOS that the rate transitions are generated for:
+   - a task that is due runs after the base rate and after the faster tasks that are due at the same tick
+   - a task must have completed before it is due again (before the base rate of that tick runs)
+   - all tasks have completed when fmi2DoStep() returns
+   So a slow task can run in parallel to the base rate and the faster tasks of the following ticks of the
+   same communication step. The tasks that are due at the same tick run one after another (the rate
+   transitions between them rely on this order), so a communication step of a single base tick gains
+   nothing from the worker threads. */
+
+#ifdef _WIN32
+typedef CRITICAL_SECTION   Mutex;
+typedef CONDITION_VARIABLE Condition;
+typedef HANDLE             Thread;
+#define THREAD_FUNCTION(name, arg)   DWORD WINAPI name(LPVOID arg)
+#define MUTEX_INIT(m)                InitializeCriticalSection(m)
+#define MUTEX_DESTROY(m)             DeleteCriticalSection(m)
+#define MUTEX_LOCK(m)                EnterCriticalSection(m)
+#define MUTEX_UNLOCK(m)              LeaveCriticalSection(m)
+#define CONDITION_INIT(c)            InitializeConditionVariable(c)
+#define CONDITION_DESTROY(c)
+#define CONDITION_WAIT(c, m)         SleepConditionVariableCS(c, m, INFINITE)
+#define CONDITION_BROADCAST(c)       WakeAllConditionVariable(c)
+#define THREAD_CREATE(t, f, arg)     ((*(t) = CreateThread(NULL, 0, f, arg, 0, NULL)) != NULL)
+#define THREAD_JOIN(t)               (WaitForSingleObject(t, INFINITE), CloseHandle(t))
+#else
+typedef pthread_mutex_t    Mutex;
+typedef pthread_cond_t     Condition;
+typedef pthread_t          Thread;
+#define THREAD_FUNCTION(name, arg)   void *name(void *arg)
+#define MUTEX_INIT(m)                pthread_mutex_init(m, NULL)
+#define MUTEX_DESTROY(m)             pthread_mutex_destroy(m)
+#define MUTEX_LOCK(m)                pthread_mutex_lock(m)
+#define MUTEX_UNLOCK(m)              pthread_mutex_unlock(m)
+#define CONDITION_INIT(c)            pthread_cond_init(c, NULL)
+#define CONDITION_DESTROY(c)         pthread_cond_destroy(c)
+#define CONDITION_WAIT(c, m)         pthread_cond_wait(c, m)
+#define CONDITION_BROADCAST(c)       pthread_cond_broadcast(c)
+#define THREAD_CREATE(t, f, arg)     (pthread_create(t, NULL, f, arg) == 0)
+#define THREAD_JOIN(t)               pthread_join(t, NULL)
+#endif
+
+typedef struct {
+	TaskPool *pool;
+	int tid;
+	Thread thread;
+	unsigned long released;       /* number of times the task was due */
+	unsigned long completed;      /* number of completed runs */
+	int predecessor;              /* faster task that is due at the same tick (-1 if none) */
+	unsigned long predecessorRun; /* run of the predecessor that must complete before this run */
+} Task;
+
+struct TaskPool {
+	ModelInstance *instance;
+	Mutex mutex;
+	Condition condition;  /* signaled when a task is released or completed */
+	int terminate;
+	int nThreads;
+	Task tasks[NUM_SAMPLE_TIMES];
+};
+
+static THREAD_FUNCTION(runTask, arg) {
+
+	Task *task = (Task *)arg;
+	TaskPool *pool = task->pool;
+	ModelInstance *instance = pool->instance;
+
+	MUTEX_LOCK(&pool->mutex);
+
+	for (;;) {
+
+		while (!pool->terminate && (task->completed == task->released ||
+			(task->predecessor >= 0 && pool->tasks[task->predecessor].completed < task->predecessorRun))) {
+			CONDITION_WAIT(&pool->condition, &pool->mutex);
+		}
+
+		if (pool->terminate) break;
+
+		MUTEX_UNLOCK(&pool->mutex);
+
+		FMU_RESOURCES_DIR = instance->resourcesDir;
+
+#ifdef REUSABLE_FUNCTION
+		MODEL_STEP(instance->S, task->tid);
+#else
+		MODEL_STEP(task->tid);
+#endif
+
+		MUTEX_LOCK(&pool->mutex);
+		task->completed++;
+		CONDITION_BROADCAST(&pool->condition);
+	}
+
+	MUTEX_UNLOCK(&pool->mutex);
+
+	return 0;
+}
+
+static void freeTaskPool(TaskPool *pool) {
+
+	int i;
+
+	MUTEX_LOCK(&pool->mutex);
+	pool->terminate = 1;
+	CONDITION_BROADCAST(&pool->condition);
+	MUTEX_UNLOCK(&pool->mutex);
+
+	for (i = FIRST_TASK_ID + 1; i < FIRST_TASK_ID + 1 + pool->nThreads; i++) {
+		THREAD_JOIN(pool->tasks[i].thread);
+	}
+
+	CONDITION_DESTROY(&pool->condition);
+	MUTEX_DESTROY(&pool->mutex);
+
+	free(pool);
+}
+
+static TaskPool *createTaskPool(ModelInstance *instance) {
+
+	int i;
+	TaskPool *pool = calloc(1, sizeof(TaskPool));
+
+	if (!pool) return NULL;
+
+	pool->instance = instance;
+
+	MUTEX_INIT(&pool->mutex);
+	CONDITION_INIT(&pool->condition);
+
+	for (i = FIRST_TASK_ID + 1; i < NUM_SAMPLE_TIMES; i++) {
+
+		Task *task = &pool->tasks[i];
+
+		task->pool = pool;
+		task->tid = i;
+		task->predecessor = -1;
+
+		if (!THREAD_CREATE(&task->thread, runTask, task)) {
+			freeTaskPool(pool);
+			return NULL;
+		}
+
+		pool->nThreads++;
+	}
+
+	return pool;
+}
+
+/* waits until the subrate tasks that are due at this tick (or all tasks) have completed */
+static void waitForTasks(TaskPool *pool, RT_MDL_TYPE *S, int dueOnly) {
+
+	int i;
+
+	MUTEX_LOCK(&pool->mutex);
+
+	for (i = FIRST_TASK_ID + 1; i < NUM_SAMPLE_TIMES; i++) {
+
+		Task *task = &pool->tasks[i];
+
+		if (dueOnly && !rtmStepTask(S, i)) continue;
+
+		while (task->completed < task->released) {
+			CONDITION_WAIT(&pool->condition, &pool->mutex);
+		}
+	}
+
+	MUTEX_UNLOCK(&pool->mutex);
+}
+
+/* starts the subrate tasks that are due at this tick (after the base rate) and advances the task counters,
+   every task waits for the faster task that is due at the same tick (its predecessor) */
+static void releaseTasks(TaskPool *pool, RT_MDL_TYPE *S) {
+
+	int i, predecessor = -1;
+
+	MUTEX_LOCK(&pool->mutex);
+
+	for (i = FIRST_TASK_ID + 1; i < NUM_SAMPLE_TIMES; i++) {
+
+		Task *task = &pool->tasks[i];
+
+		if (rtmStepTask(S, i)) {
+			task->predecessor = predecessor;
+			task->predecessorRun = predecessor < 0 ? 0 : pool->tasks[predecessor].released;
+			task->released++;
+			predecessor = i;
+		}
+
+		if (++rtmTaskCounter(S, i) == rtmCounterLimit(S, i)) {
+			rtmTaskCounter(S, i) = 0;
+		}
+	}
+
+	CONDITION_BROADCAST(&pool->condition);
+	MUTEX_UNLOCK(&pool->mutex);
+}
+
+#endif /* TASK_POOL */
+
+/* Returns the path of the resources directory (allocated) or NULL if uri is not a file URI */
+static char *resourcePath(const char *uri) {
 
 	const char *scheme1 = "file:///";
 	const char *scheme2 = "file:/";
 	char *path;
 
-	if (!uri || FMU_RESOURCES_DIR) return;
+	if (!uri) return NULL;
 
 	if (strncmp(uri, scheme1, strlen(scheme1)) == 0) {
         path = strdup(&uri[strlen(scheme1) - 1]);
 	} else if (strncmp(uri, scheme2, strlen(scheme2)) == 0) {
         path = strdup(&uri[strlen(scheme2) - 1]);
     } else {
-        return;
+        return NULL;
     }
 
 #ifdef _WIN32
 	// strip any leading slashes
 	while (path[0] == '/') {
-		strcpy(path, &path[1]);
+		memmove(path, &path[1], strlen(path));
 	}
 #endif
 
-	FMU_RESOURCES_DIR = path;
+	return path;
 }
 
 /***************************************************
@@ -89,9 +320,6 @@ fmi2Component fmi2Instantiate(fmi2String instanceName,
 		return NULL;
 	}
 
-	/* set the path to the resources directory */
-	setResourcePath(fmuResourceLocation);
-
 	instance = malloc(sizeof(ModelInstance));
 
 	len = strlen(instanceName);
@@ -99,24 +327,41 @@ fmi2Component fmi2Instantiate(fmi2String instanceName,
 	strncpy((char *)instance->instanceName, instanceName, len + 1);
 	instance->logger = functions->logger;
 	instance->componentEnvironment = functions->componentEnvironment;
+	instance->resourcesDir = resourcePath(fmuResourceLocation);
+
+	FMU_RESOURCES_DIR = instance->resourcesDir;
 
 #ifdef REUSABLE_FUNCTION
 	instance->S = MODEL();
+	newInstanceId(&instance->instanceId, instance->S);
 #else
 	instance->S = RT_MDL_INSTANCE;
 #endif
 
 	initializeModelVariables(instance->S, instance->modelVariables);
 
+#ifdef TASK_POOL
+	instance->taskPool = createTaskPool(instance);
+
+	if (!instance->taskPool) {
+		free((void *)instance->instanceName);
+		free(instance->resourcesDir);
+		free(instance);
+		return NULL;
+	}
+#endif
+
 	return instance;
 }
 
 void fmi2FreeInstance(fmi2Component c) {
 	ModelInstance *instance = (ModelInstance *)c;
+#ifdef TASK_POOL
+	freeTaskPool(instance->taskPool);
+#endif
 	free((void *)instance->instanceName);
+	free(instance->resourcesDir);
 	free(instance);
-    free((void *)FMU_RESOURCES_DIR);
-	FMU_RESOURCES_DIR = NULL;
 }
 
 /* Enter and exit initialization mode, terminate and reset */
@@ -138,6 +383,8 @@ fmi2Status fmi2EnterInitializationMode(fmi2Component c) {
 
 	ModelInstance *instance = (ModelInstance *)c;
 
+	FMU_RESOURCES_DIR = instance->resourcesDir;
+
 #ifdef REUSABLE_FUNCTION
 	MODEL_INITIALIZE(instance->S);
 #else
@@ -155,6 +402,8 @@ fmi2Status fmi2Terminate(fmi2Component c) {
 
 	ModelInstance *instance = (ModelInstance *)c;
 
+	FMU_RESOURCES_DIR = instance->resourcesDir;
+
 #ifdef REUSABLE_FUNCTION
 	MODEL_TERMINATE(instance->S);
 #else
@@ -169,6 +418,8 @@ fmi2Status fmi2Terminate(fmi2Component c) {
 fmi2Status fmi2Reset(fmi2Component c) {
 
     ModelInstance *instance = (ModelInstance *)c;
+
+	FMU_RESOURCES_DIR = instance->resourcesDir;
     
 #ifdef REUSABLE_FUNCTION
     if (instance->S) {
@@ -177,6 +428,7 @@ fmi2Status fmi2Reset(fmi2Component c) {
 
 	instance->S = MODEL();
 	MODEL_INITIALIZE(instance->S);
+	newInstanceId(&instance->instanceId, instance->S);
 #else
     if (instance->S) {
         MODEL_TERMINATE();
@@ -189,13 +441,27 @@ fmi2Status fmi2Reset(fmi2Component c) {
 }
 
 /* Getting and setting variable values */
+
+/* Number of value references from vr[i] on that are consecutive and refer to consecutive elements of one array.
+   modelVariables[index].size is the number of elements of the array from this element on. */
+static size_t runLength(const ModelVariable *v, const fmi2ValueReference vr[], size_t nvr, size_t i) {
+
+	size_t n = 1;
+
+	while (n < v->size && i + n < nvr && vr[i + n] == vr[i] + n) {
+		n++;
+	}
+
+	return n;
+}
+
 fmi2Status fmi2GetReal(fmi2Component c, const fmi2ValueReference vr[], size_t nvr, fmi2Real value[]) {
 
 	ModelInstance *instance = (ModelInstance *)c;
-	size_t i, index;
-	ModelVariable v;
+	size_t i, j, n, index;
+	const ModelVariable *v;
 
-	for (i = 0; i < nvr; i++) {
+	for (i = 0; i < nvr; i += n) {
 		
 		index = vr[i] - 1;
 
@@ -203,14 +469,15 @@ fmi2Status fmi2GetReal(fmi2Component c, const fmi2ValueReference vr[], size_t nv
 			return fmi2Error;
 		}
 
-		v = instance->modelVariables[index];
+		v = &instance->modelVariables[index];
+		n = runLength(v, vr, nvr, i);
 
-		switch (v.dtypeID) {
+		switch (v->dtypeID) {
 		case SS_DOUBLE:
-			value[i] = *(REAL64_T *)v.address;
+			memcpy(&value[i], v->address, n * sizeof(REAL64_T));
 			break;
 		case SS_SINGLE:
-			value[i] = *(REAL32_T *)v.address;
+			for (j = 0; j < n; j++) value[i + j] = ((REAL32_T *)v->address)[j];
 			break;
 		default:
 			return fmi2Error;
@@ -223,10 +490,10 @@ fmi2Status fmi2GetReal(fmi2Component c, const fmi2ValueReference vr[], size_t nv
 fmi2Status fmi2GetInteger(fmi2Component c, const fmi2ValueReference vr[], size_t nvr, fmi2Integer value[]) {
 
 	ModelInstance *instance = (ModelInstance *)c;
-	size_t i, index;
-	ModelVariable v;
+	size_t i, j, n, index;
+	const ModelVariable *v;
 
-	for (i = 0; i < nvr; i++) {
+	for (i = 0; i < nvr; i += n) {
 
 		index = vr[i] - 1;
 
@@ -234,26 +501,27 @@ fmi2Status fmi2GetInteger(fmi2Component c, const fmi2ValueReference vr[], size_t
 			return fmi2Error;
 		}
 
-		v = instance->modelVariables[index];
+		v = &instance->modelVariables[index];
+		n = runLength(v, vr, nvr, i);
 
-		switch (v.dtypeID) {
+		switch (v->dtypeID) {
 		case SS_INT8:
-			value[i] = *(INT8_T *)v.address;
+			for (j = 0; j < n; j++) value[i + j] = ((INT8_T *)v->address)[j];
 			break;
 		case SS_UINT8:
-			value[i] = *(UINT8_T *)v.address;
+			for (j = 0; j < n; j++) value[i + j] = ((UINT8_T *)v->address)[j];
 			break;
 		case SS_INT16:
-			value[i] = *(INT16_T *)v.address;
+			for (j = 0; j < n; j++) value[i + j] = ((INT16_T *)v->address)[j];
 			break;
 		case SS_UINT16:
-			value[i] = *(UINT16_T *)v.address;
+			for (j = 0; j < n; j++) value[i + j] = ((UINT16_T *)v->address)[j];
 			break;
 		case SS_INT32:
-			value[i] = *(INT32_T *)v.address;
+			memcpy(&value[i], v->address, n * sizeof(INT32_T));
 			break;
 		case SS_UINT32:
-			value[i] = *(UINT32_T *)v.address;
+			for (j = 0; j < n; j++) value[i + j] = ((UINT32_T *)v->address)[j];
 			break;
 		default:
 			return fmi2Error;
@@ -266,10 +534,10 @@ fmi2Status fmi2GetInteger(fmi2Component c, const fmi2ValueReference vr[], size_t
 fmi2Status fmi2GetBoolean(fmi2Component c, const fmi2ValueReference vr[], size_t nvr, fmi2Boolean value[]) {
 
 	ModelInstance *instance = (ModelInstance *)c;
-	size_t i, index;
-	ModelVariable v;
+	size_t i, j, n, index;
+	const ModelVariable *v;
 
-	for (i = 0; i < nvr; i++) {
+	for (i = 0; i < nvr; i += n) {
 
 		index = vr[i] - 1;
 
@@ -277,11 +545,12 @@ fmi2Status fmi2GetBoolean(fmi2Component c, const fmi2ValueReference vr[], size_t
 			return fmi2Error;
 		}
 
-		v = instance->modelVariables[index];
+		v = &instance->modelVariables[index];
+		n = runLength(v, vr, nvr, i);
 
-		switch (v.dtypeID) {
+		switch (v->dtypeID) {
 		case SS_BOOLEAN:
-			value[i] = *(BOOLEAN_T *)v.address;
+			for (j = 0; j < n; j++) value[i + j] = ((BOOLEAN_T *)v->address)[j];
 			break;
 		default:
 			return fmi2Error;
@@ -296,10 +565,10 @@ fmi2Status fmi2GetString(fmi2Component c, const fmi2ValueReference vr[], size_t
 fmi2Status fmi2SetReal(fmi2Component c, const fmi2ValueReference vr[], size_t nvr, const fmi2Real value[]) { 
 
 	ModelInstance *instance = (ModelInstance *)c;
-	size_t i, index;
-	ModelVariable v;
+	size_t i, j, n, index;
+	const ModelVariable *v;
 
-	for (i = 0; i < nvr; i++) {
+	for (i = 0; i < nvr; i += n) {
 
 		index = vr[i] - 1;
 
@@ -307,18 +576,21 @@ fmi2Status fmi2SetReal(fmi2Component c, const fmi2ValueReference vr[], size_t nv
 			return fmi2Error;
 		}
 
-		v = instance->modelVariables[index];
+		v = &instance->modelVariables[index];
+		n = runLength(v, vr, nvr, i);
 
-		switch (v.dtypeID) {
+		switch (v->dtypeID) {
 		case SS_DOUBLE:
-			*((REAL64_T *)v.address) = value[i];
+			memcpy(v->address, &value[i], n * sizeof(REAL64_T));
 			break;
 		case SS_SINGLE:
-			if (value[i] < -FLT_MAX || value[i] > FLT_MAX) {
-				// TODO: log this
-				return fmi2Error;
+			for (j = 0; j < n; j++) {
+				if (value[i + j] < -FLT_MAX || value[i + j] > FLT_MAX) {
+					// TODO: log this
+					return fmi2Error;
+				}
+				((REAL32_T *)v->address)[j] = (REAL32_T)value[i + j];
 			}
-			*((REAL32_T *)v.address) = (REAL32_T)value[i];
 			break;
 		default:
 			return fmi2Error;
@@ -331,10 +603,10 @@ fmi2Status fmi2SetReal(fmi2Component c, const fmi2ValueReference vr[], size_t nv
 fmi2Status fmi2SetInteger(fmi2Component c, const fmi2ValueReference vr[], size_t nvr, const fmi2Integer value[]) {
 
 	ModelInstance *instance = (ModelInstance *)c;
-	size_t i, index;
-	ModelVariable v;
+	size_t i, j, n, index;
+	const ModelVariable *v;
 
-	for (i = 0; i < nvr; i++) {
+	for (i = 0; i < nvr; i += n) {
 
 		index = vr[i] - 1;
 
@@ -342,26 +614,27 @@ fmi2Status fmi2SetInteger(fmi2Component c, const fmi2ValueReference vr[], size_t
 			return fmi2Error;
 		}
 
-		v = instance->modelVariables[index];
+		v = &instance->modelVariables[index];
+		n = runLength(v, vr, nvr, i);
 
-		switch (v.dtypeID) {
+		switch (v->dtypeID) {
 		case SS_INT8:
-			*((INT8_T *)v.address) = value[i];
+			for (j = 0; j < n; j++) ((INT8_T *)v->address)[j] = value[i + j];
 			break;
 		case SS_UINT8:
-			*((UINT8_T *)v.address) = value[i];
+			for (j = 0; j < n; j++) ((UINT8_T *)v->address)[j] = value[i + j];
 			break;
 		case SS_INT16:
-			*((INT16_T *)v.address) = value[i];
+			for (j = 0; j < n; j++) ((INT16_T *)v->address)[j] = value[i + j];
 			break;
 		case SS_UINT16:
-			*((UINT16_T *)v.address) = value[i];
+			for (j = 0; j < n; j++) ((UINT16_T *)v->address)[j] = value[i + j];
 			break;
 		case SS_INT32:
-			*((INT32_T *)v.address) = value[i];
+			memcpy(v->address, &value[i], n * sizeof(INT32_T));
 			break;
 		case SS_UINT32:
-			*((UINT32_T *)v.address) = value[i];
+			for (j = 0; j < n; j++) ((UINT32_T *)v->address)[j] = value[i + j];
 			break;
 		default:
 			return fmi2Error;
@@ -374,10 +647,10 @@ fmi2Status fmi2SetInteger(fmi2Component c, const fmi2ValueReference vr[], size_t
 fmi2Status fmi2SetBoolean(fmi2Component c, const fmi2ValueReference vr[], size_t nvr, const fmi2Boolean value[]) {
 
 	ModelInstance *instance = (ModelInstance *)c;
-	size_t i, index;
-	ModelVariable v;
+	size_t i, j, n, index;
+	const ModelVariable *v;
 
-	for (i = 0; i < nvr; i++) {
+	for (i = 0; i < nvr; i += n) {
 
 		index = vr[i] - 1;
 
@@ -385,11 +658,12 @@ fmi2Status fmi2SetBoolean(fmi2Component c, const fmi2ValueReference vr[], size_t
 			return fmi2Error;
 		}
 
-		v = instance->modelVariables[index];
+		v = &instance->modelVariables[index];
+		n = runLength(v, vr, nvr, i);
 
-		switch (v.dtypeID) {
+		switch (v->dtypeID) {
 		case SS_BOOLEAN:
-			*((BOOLEAN_T *)v.address) = value[i];
+			for (j = 0; j < n; j++) ((BOOLEAN_T *)v->address)[j] = value[i + j];
 			break;
 		default:
 			return fmi2Error;
@@ -402,6 +676,54 @@ fmi2Status fmi2SetBoolean(fmi2Component c, const fmi2ValueReference vr[], size_t
 fmi2Status fmi2SetString(fmi2Component c, const fmi2ValueReference vr[], size_t nvr, const fmi2String  value[]) { return fmi2Error; }
 
 /* Getting and setting the internal FMU state */
+#ifdef GET_AND_SET_FMU_STATE
+
+/* The FMU state is a copy of the model data (see saveState() in fmiwrapper.inc) */
+fmi2Status fmi2GetFMUstate(fmi2Component c, fmi2FMUstate* FMUstate) {
+
+	ModelInstance *instance = (ModelInstance *)c;
+
+	if (!instance->S) {
+		return fmi2Error;
+	}
+
+	/* re-use the memory of an existing state */
+	if (!*FMUstate) {
+		*FMUstate = malloc(getStateSize(instance->S));
+		if (!*FMUstate) {
+			return fmi2Error;
+		}
+	}
+
+	saveState(instance->S, &instance->instanceId, (char *)*FMUstate);
+
+	return fmi2OK;
+}
+
+fmi2Status fmi2SetFMUstate(fmi2Component c, fmi2FMUstate FMUstate) {
+
+	ModelInstance *instance = (ModelInstance *)c;
+
+	if (!instance->S || !FMUstate) {
+		return fmi2Error;
+	}
+
+	return restoreState(instance->S, &instance->instanceId, (const char *)FMUstate) ? fmi2OK : fmi2Error;
+}
+
+fmi2Status fmi2FreeFMUstate(fmi2Component c, fmi2FMUstate* FMUstate) {
+	free(*FMUstate);
+	*FMUstate = NULL;
+	return fmi2OK;
+}
+
+/* The FMU state can contain pointers into the model data, so it cannot be serialized */
+fmi2Status fmi2SerializedFMUstateSize(fmi2Component c, fmi2FMUstate  FMUstate, size_t* size) { return fmi2Error; }
+fmi2Status fmi2SerializeFMUstate(fmi2Component c, fmi2FMUstate  FMUstate, fmi2Byte serializedState[], size_t size) { return fmi2Error; }
+fmi2Status fmi2DeSerializeFMUstate(fmi2Component c, const fmi2Byte serializedState[], size_t size, fmi2FMUstate* FMUstate) { return fmi2Error; }
+
+#else
+
 fmi2Status fmi2GetFMUstate(fmi2Component c, fmi2FMUstate* FMUstate) { return fmi2Error; }
 fmi2Status fmi2SetFMUstate(fmi2Component c, fmi2FMUstate  FMUstate) { return fmi2Error; }
 fmi2Status fmi2FreeFMUstate(fmi2Component c, fmi2FMUstate* FMUstate) { return fmi2Error; }
@@ -409,6 +731,8 @@ fmi2Status fmi2SerializedFMUstateSize(fmi2Component c, fmi2FMUstate  FMUstate, s
 fmi2Status fmi2SerializeFMUstate(fmi2Component c, fmi2FMUstate  FMUstate, fmi2Byte serializedState[], size_t size) { return fmi2Error; }
 fmi2Status fmi2DeSerializeFMUstate(fmi2Component c, const fmi2Byte serializedState[], size_t size, fmi2FMUstate* FMUstate) { return fmi2Error; }
 
+#endif
+
 /* Getting partial derivatives */
 fmi2Status fmi2GetDirectionalDerivative(fmi2Component c,
 	const fmi2ValueReference vUnknown_ref[], size_t nUnknown,
@@ -464,6 +788,8 @@ fmi2Status fmi2DoStep(fmi2Component c,
 	RT_MDL_TYPE *S = instance->S;
 	const char *errorStatus = NULL;
 
+	FMU_RESOURCES_DIR = instance->resourcesDir;
+
 #ifdef rtmGetT
 	time_T tNext = currentCommunicationPoint + communicationStepSize;
 	double epsilon = (1.0 + fabs(rtmGetT(S))) * 2 * DBL_EPSILON;
@@ -474,7 +800,20 @@ fmi2Status fmi2DoStep(fmi2Component c,
 
 #if NUM_TASKS > 1 // multitasking
 
+#if defined(TASK_POOL)
+		// the previous runs of the subrate tasks that are due must have completed
+		waitForTasks(instance->taskPool, S, 1);
+
+		// step the model for the base sample time
 #ifdef REUSABLE_FUNCTION
+		MODEL_STEP(S, 0);
+#else
+		MODEL_STEP(0);
+#endif
+
+		// run the subrates that are due on the worker threads (one after another, see releaseTasks())
+		releaseTasks(instance->taskPool, S);
+#elif defined(REUSABLE_FUNCTION)
 		// step the model for the base sample time
 		MODEL_STEP(S, 0);
 
@@ -514,12 +853,25 @@ fmi2Status fmi2DoStep(fmi2Component c,
 
 		errorStatus = rtmGetErrorStatus(S);
 		if (errorStatus) {
+#ifdef TASK_POOL
+			waitForTasks(instance->taskPool, S, 0);
+#endif
 			instance->logger(instance->componentEnvironment, instance->instanceName, fmi2Error, "error", errorStatus);
 			return fmi2Error;
 		}
 
 	}
 
+#ifdef TASK_POOL
+	waitForTasks(instance->taskPool, S, 0);
+
+	errorStatus = rtmGetErrorStatus(S);
+	if (errorStatus) {
+		instance->logger(instance->componentEnvironment, instance->instanceName, fmi2Error, "error", errorStatus);
+		return fmi2Error;
+	}
+#endif
+
 	return fmi2OK;
 }
 
@@ -1,11 +1,23 @@
 #include <float.h>  /* for DBL_EPSILON */
+#include <string.h> /* for memcpy(), memcmp() */
+#include <time.h>   /* for time() */
 
 #include "fmiwrapper.inc"
 
 #include "fmi3Functions.h"
 
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
 const char *RT_MEMORY_ALLOCATION_ERROR = "memory allocation error";
 
+/* Path to the resources directory of the instance that is executing the model on this thread
+   (set before the model is called, used by nested FMUs) */
+THREAD_LOCAL const char *FMU_RESOURCES_DIR = NULL;
+
 int rtPrintfNoOp(const char *fmt, ...) {
 	return 0;  /* do nothing */
 }
@@ -15,11 +27,129 @@ typedef struct {
 	const char *instanceName;
 	fmi3CallbackLogMessage logger;
 	fmi3InstanceEnvironment componentEnvironment;
+	char *resourcesDir;
 	ModelVariable modelVariables[N_MODEL_VARIABLES];
+#ifdef REUSABLE_FUNCTION
+	InstanceId instanceId; /* identifies the model data in FMU states */
+#endif
 } ModelInstance;
 
 #define NOT_IMPLEMENTED return fmi3Error;
 
+/* Returns the path of the resources directory (allocated) for a file URI or path */
+static char *resourcePath(const char *location) {
+
+	const char *scheme1 = "file:///";
+	const char *scheme2 = "file:/";
+	char *path;
+
+	if (!location) return NULL;
+
+	if (strncmp(location, scheme1, strlen(scheme1)) == 0) {
+		path = strdup(&location[strlen(scheme1) - 1]);
+	} else if (strncmp(location, scheme2, strlen(scheme2)) == 0) {
+		path = strdup(&location[strlen(scheme2) - 1]);
+	} else {
+		return strdup(location);
+	}
+
+#ifdef _WIN32
+	// strip any leading slashes
+	while (path[0] == '/') {
+		memmove(path, &path[1], strlen(path));
+	}
+#endif
+
+	return path;
+}
+
+static ModelInstance *createInstance(
+	fmi3String              instanceName,
+	fmi3String              instantiationToken,
+	fmi3String              resourceLocation,
+	fmi3InstanceEnvironment instanceEnvironment,
+	fmi3CallbackLogMessage  logMessage) {
+
+	/* check GUID */
+	if (strcmp(instantiationToken, MODEL_GUID) != 0) {
+		return NULL;
+	}
+
+	ModelInstance *instance = calloc(1, sizeof(ModelInstance));
+
+	size_t len = strlen(instanceName);
+	instance->instanceName = malloc((len + 1) * sizeof(char));
+	strncpy((char *)instance->instanceName, instanceName, len + 1);
+	instance->logger = logMessage;
+	instance->componentEnvironment = instanceEnvironment;
+	instance->resourcesDir = resourcePath(resourceLocation);
+
+	FMU_RESOURCES_DIR = instance->resourcesDir;
+
+#ifdef REUSABLE_FUNCTION
+	instance->S = MODEL();
+	MODEL_INITIALIZE(instance->S);
+	newInstanceId(&instance->instanceId, instance->S);
+#else
+	MODEL_INITIALIZE();
+
+	instance->S = RT_MDL_INSTANCE;
+#endif
+
+	initializeModelVariables(instance->S, instance->modelVariables);
+
+	return instance;
+}
+
+/* Every task of the model is a model partition with a periodic input clock. The clock with the index
+   i (value reference FIRST_CLOCK_VR + i) activates the base rate (i = 0) or the subrate tid = FIRST_TASK_ID + i. */
+
+/* Runs the task of the clock with the given index */
+static fmi3Status runTask(ModelInstance *instance, int clockIndex) {
+
+	RT_MDL_TYPE *S = instance->S;
+	const char *errorStatus;
+
+	FMU_RESOURCES_DIR = instance->resourcesDir;
+
+#if NUM_TASKS > 1 // multitasking
+	const int tid = clockIndex == 0 ? 0 : FIRST_TASK_ID + clockIndex;
+
+#ifdef REUSABLE_FUNCTION
+	MODEL_STEP(S, tid);
+#else
+	MODEL_STEP(tid);
+#endif
+#else
+#ifdef REUSABLE_FUNCTION
+	MODEL_STEP(S);
+#else
+	MODEL_STEP();
+#endif
+#endif
+
+	errorStatus = rtmGetErrorStatus(S);
+
+	if (errorStatus) {
+		instance->logger(instance->componentEnvironment, instance->instanceName, fmi3Error, "error", errorStatus);
+		return fmi3Error;
+	}
+
+	return fmi3OK;
+}
+
+#if NUM_TASKS > 1
+/* Advances the counters that determine the subrates that are due at the next base rate step
+   (rtmStepTask(), used by the rate transitions of the base rate) */
+static void advanceTaskCounters(RT_MDL_TYPE *S) {
+	for (int i = FIRST_TASK_ID + 1; i < NUM_SAMPLE_TIMES; i++) {
+		if (++rtmTaskCounter(S, i) == rtmCounterLimit(S, i)) {
+			rtmTaskCounter(S, i) = 0;
+		}
+	}
+}
+#endif
+
 /***************************************************
 Types for Common Functions
 ****************************************************/
@@ -59,31 +189,7 @@ fmi3Instance fmi3InstantiateCoSimulation(
 	fmi3CallbackLogMessage         logMessage,
 	fmi3CallbackIntermediateUpdate intermediateUpdate) {
 
-	/* check GUID */
-	if (strcmp(instantiationToken, MODEL_GUID) != 0) {
-		return NULL;
-	}
-
-	ModelInstance *instance = malloc(sizeof(ModelInstance));
-
-	size_t len = strlen(instanceName);
-	instance->instanceName = malloc((len + 1) * sizeof(char));
-	strncpy((char *)instance->instanceName, instanceName, len + 1);
-	instance->logger = logMessage;
-	instance->componentEnvironment = instanceEnvironment;
-
-#ifdef REUSABLE_FUNCTION
-	instance->S = MODEL();
-	MODEL_INITIALIZE(instance->S);
-#else
-	MODEL_INITIALIZE();
-
-	instance->S = RT_MDL_INSTANCE;
-#endif
-
-	initializeModelVariables(instance->S, instance->modelVariables);
-
-	return instance;
+	return createInstance(instanceName, instantiationToken, resourceLocation, instanceEnvironment, logMessage);
 }
 
 fmi3Instance fmi3InstantiateScheduledExecution(
@@ -100,12 +206,14 @@ fmi3Instance fmi3InstantiateScheduledExecution(
 	fmi3CallbackLockPreemption     lockPreemption,
 	fmi3CallbackUnlockPreemption   unlockPreemption) {
 
-	return NULL; // not supported
+	/* the tasks don't need to lock preemption, the Rate Transition blocks guarantee the data integrity */
+	return createInstance(instanceName, instantiationToken, resourceLocation, instanceEnvironment, logMessage);
 }
 
 void fmi3FreeInstance(fmi3Instance c) {
 	ModelInstance *instance = (ModelInstance *)c;
 	free((void *)instance->instanceName);
+	free(instance->resourcesDir);
 	free(instance);
 }
 
@@ -135,6 +243,8 @@ fmi3Status fmi3Terminate(fmi3Instance c) {
 
 	ModelInstance *instance = (ModelInstance *)c;
 
+	FMU_RESOURCES_DIR = instance->resourcesDir;
+
 #ifdef REUSABLE_FUNCTION
 	MODEL_TERMINATE(instance->S);
 #else
@@ -149,6 +259,8 @@ fmi3Status fmi3Terminate(fmi3Instance c) {
 fmi3Status fmi3Reset(fmi3Instance c) {
 
     ModelInstance *instance = (ModelInstance *)c;
+
+	FMU_RESOURCES_DIR = instance->resourcesDir;
     
 #ifdef REUSABLE_FUNCTION
     if (instance->S) {
@@ -157,6 +269,7 @@ fmi3Status fmi3Reset(fmi3Instance c) {
     
     instance->S = MODEL();
     MODEL_INITIALIZE(instance->S);
+    newInstanceId(&instance->instanceId, instance->S);
 #else
     if (instance->S) {
         MODEL_TERMINATE();
@@ -403,6 +516,54 @@ fmi3Status fmi3SetBinary(fmi3Instance c,
 	const size_t size[], const fmi3Binary value[], size_t nValues) { NOT_IMPLEMENTED }
 
 /* Getting and setting the internal FMU state */
+#ifdef GET_AND_SET_FMU_STATE
+
+/* The FMU state is a copy of the model data (see saveState() in fmiwrapper.inc) */
+fmi3Status fmi3GetFMUstate(fmi3Instance c, fmi3FMUState* FMUState) {
+
+	ModelInstance *instance = (ModelInstance *)c;
+
+	if (!instance->S) {
+		return fmi3Error;
+	}
+
+	/* re-use the memory of an existing state */
+	if (!*FMUState) {
+		*FMUState = malloc(getStateSize(instance->S));
+		if (!*FMUState) {
+			return fmi3Error;
+		}
+	}
+
+	saveState(instance->S, &instance->instanceId, (char *)*FMUState);
+
+	return fmi3OK;
+}
+
+fmi3Status fmi3SetFMUstate(fmi3Instance c, fmi3FMUState FMUState) {
+
+	ModelInstance *instance = (ModelInstance *)c;
+
+	if (!instance->S || !FMUState) {
+		return fmi3Error;
+	}
+
+	return restoreState(instance->S, &instance->instanceId, (const char *)FMUState) ? fmi3OK : fmi3Error;
+}
+
+fmi3Status fmi3FreeFMUstate(fmi3Instance c, fmi3FMUState* FMUState) {
+	free(*FMUState);
+	*FMUState = NULL;
+	return fmi3OK;
+}
+
+/* The FMU state can contain pointers into the model data, so it cannot be serialized */
+fmi3Status fmi3SerializedFMUstateSize(fmi3Instance c, fmi3FMUState  FMUstate, size_t* size) { NOT_IMPLEMENTED }
+fmi3Status fmi3SerializeFMUstate(fmi3Instance c, fmi3FMUState  FMUstate, fmi3Byte serializedState[], size_t size) { NOT_IMPLEMENTED }
+fmi3Status fmi3DeSerializeFMUstate(fmi3Instance c, const fmi3Byte serializedState[], size_t size, fmi3FMUState* FMUState) { NOT_IMPLEMENTED }
+
+#else
+
 fmi3Status fmi3GetFMUstate(fmi3Instance c, fmi3FMUState* FMUState) { NOT_IMPLEMENTED }
 fmi3Status fmi3SetFMUstate(fmi3Instance c, fmi3FMUState  FMUState) { NOT_IMPLEMENTED }
 fmi3Status fmi3FreeFMUstate(fmi3Instance c, fmi3FMUState* FMUState) { NOT_IMPLEMENTED }
@@ -410,6 +571,8 @@ fmi3Status fmi3SerializedFMUstateSize(fmi3Instance c, fmi3FMUState  FMUstate, si
 fmi3Status fmi3SerializeFMUstate(fmi3Instance c, fmi3FMUState  FMUstate, fmi3Byte serializedState[], size_t size) { NOT_IMPLEMENTED }
 fmi3Status fmi3DeSerializeFMUstate(fmi3Instance c, const fmi3Byte serializedState[], size_t size, fmi3FMUState* FMUState) { NOT_IMPLEMENTED }
 
+#endif
+
 /* Getting partial derivatives */
 fmi3Status fmi3GetDirectionalDerivative(fmi3Instance c,
                                         const fmi3ValueReference vrUnknown[],
@@ -485,22 +648,27 @@ fmi3Status fmi3DoStep(fmi3Instance c,
 
 	time_T tNext = currentCommunicationPoint + communicationStepSize;
 
+	FMU_RESOURCES_DIR = instance->resourcesDir;
+
 #ifdef rtmGetT
 	while (rtmGetT(instance->S) + STEP_SIZE < tNext + DBL_EPSILON)
 #endif
 	{
-        
-#ifdef REUSABLE_FUNCTION
-		MODEL_STEP(instance->S);
-#else
-        MODEL_STEP();
-#endif
-		const char *errorStatus = rtmGetErrorStatus(instance->S);
-		if (errorStatus) {
-			instance->logger(instance->componentEnvironment, instance->instanceName, fmi3Error, "error", errorStatus);
+		// step the model for the base sample time
+		if (runTask(instance, 0) != fmi3OK) {
 			return fmi3Error;
 		}
 
+#if NUM_TASKS > 1 // multitasking
+		// step the model for any other sample times (subrates)
+		for (int i = FIRST_TASK_ID + 1; i < NUM_SAMPLE_TIMES; i++) {
+			if (rtmStepTask(instance->S, i) && runTask(instance, i - FIRST_TASK_ID) != fmi3OK) {
+				return fmi3Error;
+			}
+		}
+
+		advanceTaskCounters(instance->S);
+#endif
 	}
 
 	return fmi3OK;
@@ -515,3 +683,55 @@ fmi3Status fmi3GetDoStepPendingStatus(fmi3Instance c,
 fmi3Status fmi3GetDoStepDiscardedStatus(fmi3Instance c,
 		fmi3Boolean* terminate,
 		fmi3Float64* lastSuccessfulTime) { NOT_IMPLEMENTED }
+
+/***************************************************
+Types for Functions for FMI3 for Scheduled Execution
+****************************************************/
+
+fmi3Status fmi3GetIntervalDecimal(fmi3Instance c,
+	const fmi3ValueReference vr[], size_t nvr,
+	fmi3Float64 interval[], size_t nValues) {
+
+	size_t i;
+
+	if (nvr != nValues) {
+		return fmi3Error;
+	}
+
+	for (i = 0; i < nvr; i++) {
+
+		if (vr[i] < FIRST_CLOCK_VR || vr[i] >= FIRST_CLOCK_VR + NUM_TASKS) {
+			return fmi3Error;
+		}
+
+		interval[i] = CLOCK_INTERVALS[vr[i] - FIRST_CLOCK_VR];
+	}
+
+	return fmi3OK;
+}
+
+/* The importer must activate the base rate at every tick of its clock and the partitions with the
+   priorities of their clocks (rate monotonic) like a preemptive RTOS */
+fmi3Status fmi3ActivateModelPartition(fmi3Instance c,
+	fmi3ValueReference clockReference,
+	size_t clockElementIndex,
+	fmi3Float64 activationTime) {
+
+	ModelInstance *instance = (ModelInstance *)c;
+
+	if (!instance->S || clockReference < FIRST_CLOCK_VR || clockReference >= FIRST_CLOCK_VR + NUM_TASKS || clockElementIndex != 0) {
+		return fmi3Error;
+	}
+
+	if (runTask(instance, clockReference - FIRST_CLOCK_VR) != fmi3OK) {
+		return fmi3Error;
+	}
+
+#if NUM_TASKS > 1
+	if (clockReference == FIRST_CLOCK_VR) {
+		advanceTaskCounters(instance->S);
+	}
+#endif
+
+	return fmi3OK;
+}
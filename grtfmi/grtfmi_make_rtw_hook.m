@@ -2,6 +2,19 @@ function grtfmi_make_rtw_hook(hookMethod, modelName, rtwRoot, templateMakefile,
 
 switch hookMethod
 
+    case 'before_tlc'
+
+        current_dir = pwd;
+
+        % the FMU must support multiple instances in one process (not available in R2012b)
+        params = get_param(modelName, 'ObjectParameters');
+
+        if strcmp(current_dir(end-11:end), '_grt_fmi_rtw') && isfield(params, 'CodeInterfacePackaging') && ...
+                ~strcmp(get_param(modelName, 'CodeInterfacePackaging'), 'Reusable function')
+            error(['Code interface packaging of ' modelName ' must be "Reusable function" to export an FMU ' ...
+                '(Code Generation > Interface > Code interface packaging).'])
+        end
+
     case 'after_make'
 
         current_dir = pwd;
@@ -49,6 +62,7 @@ switch hookMethod
         toolset             = get_param(modelName, 'CMakeToolset');
         build_configuration = get_param(modelName, 'CMakeBuildConfiguration');
         source_code_fmu     = get_param(modelName, 'SourceCodeFMU');
+        threaded_multitasking = get_param(modelName, 'CMakeThreadedMultitasking');
         fmi_version         = get_param(modelName, 'FMIVersion');
         
         % copy extracted nested FMUs
@@ -68,6 +82,11 @@ switch hookMethod
                 end
                 disp(['Copying ' unzipdir ' to resources'])                
                 copyfile(unzipdir, fullfile('FMUArchive', 'resources', model_identifier), 'f');
+                % remove the hash of the extracted archive
+                hash_file = fullfile('FMUArchive', 'resources', model_identifier, '.fmikit_sha256');
+                if exist(hash_file, 'file')
+                    delete(hash_file);
+                end
             end
         end
         
@@ -98,6 +117,7 @@ switch hookMethod
         fprintf(fid, 'CUSTOM_LIBRARY:STRING=%s\n', custom_library);
         fprintf(fid, 'SOURCE_CODE_FMU:BOOL=%s\n', upper(source_code_fmu));
         fprintf(fid, 'SIMSCAPE:BOOL=%s\n', upper(simscape_blocks));
+        fprintf(fid, 'THREADED_MULTITASKING:BOOL=%s\n', upper(threaded_multitasking));
         fprintf(fid, 'FMI_VERSION:STRING=%s\n', fmi_version);
         fprintf(fid, 'COMPILER_OPTIMIZATION_LEVEL:STRING=%s\n', get_param(gcs, 'CMakeCompilerOptimizationLevel'));
         fprintf(fid, 'COMPILER_OPTIMIZATION_FLAGS:STRING=%s\n', get_param(gcs, 'CMakeCompilerOptimizationFlags'));
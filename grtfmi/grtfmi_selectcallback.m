@@ -19,6 +19,7 @@ slConfigUISetVal(hDlg, hSrc, 'RetainRTWFile', 'on');
 params = get_param(gcs ,'ObjectParameters');
 if isfield(params, 'CodeInterfacePackaging')
     slConfigUISetVal(hDlg, hSrc, 'CodeInterfacePackaging', 'Reusable function');
+    slConfigUISetEnabled(hDlg, hSrc, 'CodeInterfacePackaging', false);
 end
 
 % disable Mat file logging
@@ -0,0 +1,68 @@
+#pragma once
+
+/*****************************************************************
+ *  Copyright (c) Dassault Systemes. All rights reserved.        *
+ *  This file is part of FMIKit. See LICENSE.txt in the project  *
+ *  root for license information.                                *
+ *****************************************************************/
+
+#include <stdio.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace fmikit {
+
+	/* Writes log messages to a file on a background thread. write() copies the message
+	   into a ring buffer and never waits for the file. Producers are serialized by a mutex
+	   that is only held for the copy (FMUs may log from their own threads), the writer thread
+	   consumes the buffer without locking. Messages that don't fit into the buffer are dropped
+	   and counted. */
+	class AsyncLogWriter {
+
+	public:
+		explicit AsyncLogWriter(FILE *file, size_t capacity = 4 * 1024 * 1024);
+
+		// drains the buffer and stops the writer thread (the file is not closed)
+		~AsyncLogWriter();
+
+		// appends the message and a line break, returns false if the message was dropped
+		bool write(const char *message);
+
+		// appends a binary record, returns false if the record was dropped
+		bool write(const void *data, size_t size);
+
+		// blocks until all buffered messages have been written to the file
+		void flush();
+
+		// number of messages dropped because the buffer was full
+		size_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+		size_t capacity() const { return m_buffer.size(); }
+
+	private:
+		FILE *m_file;
+		std::vector<char> m_buffer;
+
+		std::atomic<size_t> m_head; // total number of bytes written by the producer
+		std::atomic<size_t> m_tail; // total number of bytes consumed by the writer thread
+		std::atomic<size_t> m_dropped;
+		std::atomic<bool> m_stop;
+
+		std::mutex m_writeMutex; // serializes the producers
+
+		std::mutex m_mutex;
+		std::condition_variable m_wakeUp;  // wakes up the writer thread
+		std::condition_variable m_drained; // signaled when the writer thread has consumed the buffer
+		std::thread m_thread;
+
+		bool append(const char *data, size_t size, bool lineBreak);
+		void run();
+		void drain();
+
+	};
+
+}
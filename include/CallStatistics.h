@@ -0,0 +1,85 @@
+#pragma once
+
+/*****************************************************************
+ *  Copyright (c) Dassault Systemes. All rights reserved.        *
+ *  This file is part of FMIKit. See LICENSE.txt in the project  *
+ *  root for license information.                                *
+ *****************************************************************/
+
+#include <stdint.h>
+#include <chrono>
+#include <string>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "CallTrace.h"
+
+/* time the FMI call between PROFILE_BEGIN and PROFILE_END (if the statistics or the timeline are enabled), the macros
+   only declare plain variables so they can be used in functions with structured exception handling (ASSERT_NO_ERROR) */
+#define PROFILE_BEGIN const uint64_t profileStart = (m_callStatistics || m_callTimeline) ? CallStatistics::now() : 0;
+#define PROFILE_END(F) if (m_callStatistics || m_callTimeline) profileCall(F, profileStart);
+
+namespace fmikit {
+
+	/* Number of calls, total and maximum time and a histogram of the latencies of each FMI function of one
+	   instance. Bucket i of the histogram counts the calls that took [2^i, 2^(i+1)) nanoseconds (bucket 0
+	   includes 0 ns and the last bucket all longer calls). */
+	class CallStatistics {
+
+	public:
+		static const int NUM_BUCKETS = 40; // 2^40 ns ~ 18 min
+
+		struct Entry {
+			uint64_t count = 0;
+			uint64_t totalTime = 0; // ns
+			uint64_t maxTime = 0;   // ns
+			uint64_t histogram[NUM_BUCKETS] = {};
+		};
+
+		// monotonic time in nanoseconds
+		static uint64_t now() {
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+		}
+
+		// histogram bucket of a duration (floor(log2(nanoseconds)))
+		static int bucket(uint64_t nanoseconds) {
+			if (nanoseconds == 0) return 0;
+#if defined(_MSC_VER) && defined(_WIN64)
+			unsigned long index;
+			_BitScanReverse64(&index, nanoseconds);
+			const int b = static_cast<int>(index);
+#elif defined(__GNUC__)
+			const int b = 63 - __builtin_clzll(nanoseconds);
+#else
+			int b = 0;
+			while (nanoseconds >>= 1) b++;
+#endif
+			return b < NUM_BUCKETS ? b : NUM_BUCKETS - 1;
+		}
+
+		void record(TraceFunction function, uint64_t nanoseconds) {
+			auto &entry = m_entries[function];
+			entry.count++;
+			entry.totalTime += nanoseconds;
+			if (nanoseconds > entry.maxTime) entry.maxTime = nanoseconds;
+			entry.histogram[bucket(nanoseconds)]++;
+		}
+
+		const Entry &entry(TraceFunction function) const { return m_entries[function]; }
+
+		void reset();
+
+		// upper bound of the latency (in ns) of the given fraction (e.g. 0.99) of the calls
+		uint64_t percentile(TraceFunction function, double fraction) const;
+
+		// one line per called function: name, calls, total time, mean, median, 99th percentile and maximum
+		std::string format(FMIVersion fmiVersion) const;
+
+	private:
+		Entry m_entries[NUM_TRACE_FUNCTIONS];
+
+	};
+
+}
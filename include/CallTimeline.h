@@ -0,0 +1,50 @@
+#pragma once
+
+/*****************************************************************
+ *  Copyright (c) Dassault Systemes. All rights reserved.        *
+ *  This file is part of FMIKit. See LICENSE.txt in the project  *
+ *  root for license information.                                *
+ *****************************************************************/
+
+#include <stdint.h>
+#include <memory>
+#include <string>
+
+
+namespace fmikit {
+
+	class TimelineFile;
+
+	/* Track of one instance in a timeline of FMI calls and S-function callbacks in the Chrome trace event
+	   format (JSON array format) that can be opened in chrome://tracing or https://ui.perfetto.dev.
+	   All tracks that write to the same file share one AsyncLogWriter and appear as threads of one process.
+	   Calls are complete events ("ph": "X") with the start and duration in microseconds of wall time
+	   since the file was opened and the simulation time in "args". */
+	class CallTimeline {
+
+	public:
+		// opens filename or shares it with the other tracks that write to it, throws runtime_error on failure
+		CallTimeline(const std::string &filename, const std::string &trackName);
+
+		// the file is closed with the last track
+		~CallTimeline();
+
+		CallTimeline(const CallTimeline&) = delete;
+		CallTimeline& operator=(const CallTimeline&) = delete;
+
+		// call that started at start and ended at end (in nanoseconds of CallStatistics::now())
+		void complete(const char *name, uint64_t start, uint64_t end, double time);
+
+		// message at the current wall time
+		void instant(const char *message, double time);
+
+		// number of events that were dropped because the buffer was full
+		size_t dropped() const;
+
+	private:
+		std::shared_ptr<TimelineFile> m_file;
+		int m_track;
+
+	};
+
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+/*****************************************************************
+ *  Copyright (c) Dassault Systemes. All rights reserved.        *
+ *  This file is part of FMIKit. See LICENSE.txt in the project  *
+ *  root for license information.                                *
+ *****************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <chrono>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+#include "FMU.h"
+
+/* Binary trace of the FMI calls made through FMU1 and FMU2
+
+   file    := header record*
+   header  := "FMITRACE" uint32 version uint32 fmiVersion uint32 kind string guid string modelIdentifier string unzipDirectory string instanceName
+   string  := uint32 length char[length]
+   record  := uint16 function int16 status uint32 size uint64 wallTime float64 time payload
+   payload := uint32 nvr uint32 vr[nvr] uint32 type uint32 nvalues value[nvalues]
+
+   size is the size of the payload in bytes, wallTime is the time in nanoseconds since the start of the trace
+   and time is the FMU's time. The values are float64 (REAL), int32 (INTEGER), uint8 (BOOLEAN) or string (STRING).
+   All numbers are stored in the byte order of the host that wrote the trace. */
+
+// record an FMI call of the current instance (if tracing is enabled)
+#define TRACE_CALL(...) if (m_callTrace) m_callTrace->record(m_status, m_time, __VA_ARGS__);
+
+namespace fmikit {
+
+	class AsyncLogWriter;
+
+	enum TraceFunction {
+		TRACE_MESSAGE,                           // text message (STRING)
+		TRACE_INSTANTIATE,                       // [loggingOn] or [timeout, loggingOn] for FMI 1.0 co-simulation
+		TRACE_SETUP_EXPERIMENT,                  // [toleranceDefined, tolerance, startTime, stopTimeDefined, stopTime]
+		TRACE_ENTER_INITIALIZATION_MODE,
+		TRACE_EXIT_INITIALIZATION_MODE,
+		TRACE_INITIALIZE,                        // FMI 1.0: [toleranceControlled, relativeTolerance] or [startTime, stopTimeDefined, stopTime]
+		TRACE_TERMINATE,
+		TRACE_FREE_INSTANCE,
+		TRACE_GET_REAL,
+		TRACE_GET_INTEGER,
+		TRACE_GET_BOOLEAN,
+		TRACE_GET_STRING,
+		TRACE_SET_REAL,
+		TRACE_SET_INTEGER,
+		TRACE_SET_BOOLEAN,
+		TRACE_SET_STRING,
+		TRACE_SET_REAL_INPUT_DERIVATIVES,        // vr, [order, value]
+		TRACE_DO_STEP,                           // [currentCommunicationPoint, communicationStepSize]
+		TRACE_GET_BOOLEAN_STATUS,                // [value]
+		TRACE_SET_TIME,                          // [time]
+		TRACE_SET_CONTINUOUS_STATES,             // x
+		TRACE_GET_CONTINUOUS_STATES,             // x
+		TRACE_GET_NOMINALS_OF_CONTINUOUS_STATES, // x_nominal
+		TRACE_GET_DERIVATIVES,                   // dx
+		TRACE_GET_EVENT_INDICATORS,              // z
+		TRACE_COMPLETED_INTEGRATOR_STEP,         // [enterEventMode, terminateSimulation]
+		TRACE_ENTER_EVENT_MODE,
+		TRACE_NEW_DISCRETE_STATES,               // [newDiscreteStatesNeeded, terminateSimulation, nominalsChanged, valuesChanged, nextEventTimeDefined, nextEventTime]
+		TRACE_ENTER_CONTINUOUS_TIME_MODE,
+		TRACE_EVENT_UPDATE,                      // [iterationConverged, stateValueReferencesChanged, stateValuesChanged, terminateSimulation, upcomingTimeEvent, nextEventTime]
+		TRACE_GET_DIRECTIONAL_DERIVATIVE,        // vUnknown, dvUnknown (the seed is not recorded)
+		TRACE_GET_FMU_STATE,                     // [slot]
+		TRACE_SET_FMU_STATE,                     // [slot]
+		NUM_TRACE_FUNCTIONS
+	};
+
+	const char *traceFunctionName(TraceFunction function, FMIVersion fmiVersion);
+
+	/* Encodes FMI calls into binary records that are written by an AsyncLogWriter */
+	class CallTrace {
+
+	public:
+		explicit CallTrace(AsyncLogWriter *writer);
+
+		void writeHeader(const FMU *fmu);
+
+		void message(double time, const char *message);
+
+		void record(int status, double time, TraceFunction function);
+		void record(int status, double time, TraceFunction function, std::initializer_list<double> args);
+		void record(int status, double time, TraceFunction function, const ValueReference vr[], size_t nvr, std::initializer_list<double> args);
+		void record(int status, double time, TraceFunction function, const double values[], size_t nvalues);
+		void record(int status, double time, TraceFunction function, const ValueReference vr[], size_t nvr, const double values[]);
+		void record(int status, double time, TraceFunction function, const ValueReference vr[], size_t nvr, const int values[]);
+		void record(int status, double time, TraceFunction function, const ValueReference vr[], size_t nvr, const bool values[]);
+		void record(int status, double time, TraceFunction function, const ValueReference vr[], size_t nvr, const char * const values[]);
+
+	private:
+		AsyncLogWriter *m_writer;
+		std::chrono::steady_clock::time_point m_start;
+		std::vector<char> m_buffer;
+
+		void begin(int status, double time, TraceFunction function, const ValueReference vr[], size_t nvr, Type type, size_t nvalues);
+		void end();
+
+		template<typename T> void append(const T &value) {
+			const char *p = reinterpret_cast<const char *>(&value);
+			m_buffer.insert(m_buffer.end(), p, p + sizeof(T));
+		}
+
+		void appendString(const char *value);
+
+	};
+
+	struct TraceHeader {
+		uint32_t version;
+		FMIVersion fmiVersion;
+		Kind kind;
+		std::string guid;
+		std::string modelIdentifier;
+		std::string unzipDirectory;
+		std::string instanceName;
+	};
+
+	struct TraceRecord {
+		TraceFunction function;
+		int status;
+		uint64_t wallTime;
+		double time;
+		std::vector<ValueReference> vr;
+		Type type;
+		std::vector<double> reals;
+		std::vector<int> integers;
+		std::vector<bool> booleans;
+		std::vector<std::string> strings;
+
+		size_t size() const;
+
+		// the values as double (REAL, INTEGER and BOOLEAN)
+		double value(size_t index) const;
+	};
+
+	/* Reads a trace written by CallTrace */
+	class CallTraceReader {
+
+	public:
+		explicit CallTraceReader(const std::string &filename);
+		~CallTraceReader();
+
+		const TraceHeader& header() const { return m_header; }
+
+		// reads the next record, returns false at the end of the file
+		bool next(TraceRecord &record);
+
+	private:
+		FILE *m_file;
+		TraceHeader m_header;
+		std::vector<char> m_buffer;
+
+		bool readString(std::string &value);
+
+	};
+
+}
@@ -12,7 +12,10 @@
 typedef void *HMODULE;
 #endif
 
+#include <stdint.h>
 #include <fstream>
+#include <memory>
+#include <string>
 
 #ifdef _WIN32
 #define ASSERT_NO_ERROR(F, M) __try { assertNoError(F, M); } __except (EXCEPTION_EXECUTE_HANDLER) { error("%s. The FMU crashed (exception code: %s).", M, exceptionCodeToString(GetExceptionCode())); }
@@ -65,6 +68,14 @@ namespace fmikit {
 
 	class FMU;
 
+	class CallTrace;
+
+	class CallStatistics;
+
+	class CallTimeline;
+
+	class SharedLibrary;
+
 	typedef unsigned int ValueReference;
 
 	typedef void MessageLogger(FMU *instance, LogLevel level, const char* category, const char* message);
@@ -107,6 +118,9 @@ namespace fmikit {
 	public:
 		static MessageLogger *m_messageLogger;
 		FMICallLogger *m_fmiCallLogger = nullptr;
+		CallTrace *m_callTrace = nullptr;
+		CallStatistics *m_callStatistics = nullptr; // latencies of the FMI calls (if profiling is enabled)
+		CallTimeline *m_callTimeline = nullptr;     // track of the FMI calls in a timeline (if enabled)
 
 		static const char *platform();
 		LogLevel logLevel() { return m_logLevel; }
@@ -133,22 +147,39 @@ namespace fmikit {
 		virtual void setBoolean(ValueReference vr, bool value) = 0;
 		virtual void setString(ValueReference vr, std::string value) = 0;
 
+		// array versions of the getters and setters (one FMI call per array)
+		virtual void getReal(const ValueReference vr[], size_t nvr, double value[]) = 0;
+		virtual void getInteger(const ValueReference vr[], size_t nvr, int value[]) = 0;
+		virtual void getBoolean(const ValueReference vr[], size_t nvr, bool value[]) = 0;
+
+		virtual void setReal(const ValueReference vr[], size_t nvr, const double value[]) = 0;
+		virtual void setInteger(const ValueReference vr[], size_t nvr, const int value[]) = 0;
+		virtual void setBoolean(const ValueReference vr[], size_t nvr, const bool value[]) = 0;
+
 		Kind kind() const { return m_kind; }
 		FMIVersion fmiVersion() const { return m_fmiVersion; }
 
 		const std::string& guid() const { return m_guid; }
 		const std::string& modelIdentifier() const { return m_modelIdentifier; }
+		const std::string& unzipDirectory() const { return m_unzipDirectory; }
 		const std::string& instanceName() const { return m_instanceName; }
 		const std::string& fmuLocation() const { return m_fmuLocation; }
 
+		// record the FMI calls to a binary trace (must be called before instantiate())
+		void setCallTrace(CallTrace *callTrace);
+
 	protected:
         LogLevel m_logLevel;
-		HMODULE m_libraryHandle;
+		std::shared_ptr<SharedLibrary> m_library; // shared by all instances of the same binary
 		double m_time;
 		FMIVersion m_fmiVersion;
 		Kind m_kind;
 		bool m_stopTimeDefined;
 		double m_stopTime;
+		int m_status = 0; // status of the last FMI call
+
+		// records a call (TraceFunction) that started at start to the statistics and the timeline
+		void profileCall(int function, uint64_t start);
 
 		void logDebug(const char *message, ...);
 		void logInfo(const char *message, ...);
@@ -158,6 +189,10 @@ namespace fmikit {
 
 		void logGetReal(const char *functionName, const ValueReference vr[], size_t nvr, const double value[]);
 		void logSetReal(const char *functionName, const ValueReference vr[], size_t nvr, const double value[]);
+		void logGetInteger(const char *functionName, const ValueReference vr[], size_t nvr, const int value[]);
+		void logSetInteger(const char *functionName, const ValueReference vr[], size_t nvr, const int value[]);
+		void logGetBoolean(const char *functionName, const ValueReference vr[], size_t nvr, const bool value[]);
+		void logSetBoolean(const char *functionName, const ValueReference vr[], size_t nvr, const bool value[]);
 
 #ifdef _WIN32
 		const char * exceptionCodeToString(DWORD exceptionCode) {
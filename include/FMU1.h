@@ -6,15 +6,69 @@
  *  root for license information.                                *
  *****************************************************************/
  
+#include <vector>
+
 #include "fmi1.h"
 #include "FMU.h"
-
-#ifndef _WIN32
-#include <dlfcn.h>
-#endif
+#include "SharedLibrary.h"
 
 namespace fmikit {
 
+	/* The FMI 1.0 functions of a shared library (nullptr if not exported), resolved once
+	   and shared by all instances of the binary (see SharedLibrary::functions()) */
+	struct FMU1Functions {
+
+		FMU1Functions(const SharedLibrary &library, const std::string &prefix);
+
+		/* Common functions for FMI 1.0 */
+		fmi1GetTypesPlatformTYPE *fmi1GetTypesPlatform;
+		fmi1GetVersionTYPE		 *fmi1GetVersion;
+		fmi1GetRealTYPE          *fmi1GetReal;
+		fmi1GetIntegerTYPE		 *fmi1GetInteger;
+		fmi1GetBooleanTYPE		 *fmi1GetBoolean;
+		fmi1GetStringTYPE		 *fmi1GetString;
+		fmi1SetDebugLoggingTYPE	 *fmi1SetDebugLogging;
+		fmi1SetRealTYPE			 *fmi1SetReal;
+		fmi1SetIntegerTYPE	     *fmi1SetInteger;
+		fmi1SetBooleanTYPE		 *fmi1SetBoolean;
+		fmi1SetStringTYPE		 *fmi1SetString;
+
+		/***************************************************
+		Functions for FMI 1.0 for Co-Simulation
+		****************************************************/
+		fmi1InstantiateSlaveTYPE		 *fmi1InstantiateSlave;
+		fmi1InitializeSlaveTYPE			 *fmi1InitializeSlave;
+		fmi1TerminateSlaveTYPE			 *fmi1TerminateSlave;
+		fmi1ResetSlaveTYPE				 *fmi1ResetSlave;
+		fmi1FreeSlaveInstanceTYPE		 *fmi1FreeSlaveInstance;
+		fmi1GetRealOutputDerivativesTYPE *fmi1GetRealOutputDerivatives;
+		fmi1SetRealInputDerivativesTYPE  *fmi1SetRealInputDerivatives;
+		fmi1DoStepTYPE					 *fmi1DoStep;
+		fmi1CancelStepTYPE				 *fmi1CancelStep;
+		fmi1GetStatusTYPE				 *fmi1GetStatus;
+		fmi1GetRealStatusTYPE			 *fmi1GetRealStatus;
+		fmi1GetIntegerStatusTYPE		 *fmi1GetIntegerStatus;
+		fmi1GetBooleanStatusTYPE		 *fmi1GetBooleanStatus;
+		fmi1GetStringStatusTYPE			 *fmi1GetStringStatus;
+
+		/* Functions for FMI 1.0 for Model Exchange */
+		fmi1GetModelTypesPlatformTYPE	   *fmi1GetModelTypesPlatform;
+		fmi1InstantiateModelTYPE		   *fmi1InstantiateModel;
+		fmi1FreeModelInstanceTYPE		   *fmi1FreeModelInstance;
+		fmi1SetTimeTYPE					   *fmi1SetTime;
+		fmi1SetContinuousStatesTYPE		   *fmi1SetContinuousStates;
+		fmi1CompletedIntegratorStepTYPE    *fmi1CompletedIntegratorStep;
+		fmi1InitializeTYPE				   *fmi1Initialize;
+		fmi1GetDerivativesTYPE			   *fmi1GetDerivatives;
+		fmi1GetEventIndicatorsTYPE		   *fmi1GetEventIndicators;
+		fmi1EventUpdateTYPE				   *fmi1EventUpdate;
+		fmi1GetContinuousStatesTYPE		   *fmi1GetContinuousStates;
+		fmi1GetNominalContinuousStatesTYPE *fmi1GetNominalContinuousStates;
+		fmi1GetStateValueReferencesTYPE    *fmi1GetStateValueReferences;
+		fmi1TerminateTYPE				   *fmi1Terminate;
+
+	};
+
 	class FMU1 : public FMU {
 
 	public:
@@ -37,9 +91,22 @@ namespace fmikit {
 		void setBoolean(ValueReference vr, bool value) override;
 		void setString(ValueReference vr, std::string value) override;
 
+		void getReal(const ValueReference vr[], size_t nvr, double value[]) override;
+		void getInteger(const ValueReference vr[], size_t nvr, int value[]) override;
+		void getBoolean(const ValueReference vr[], size_t nvr, bool value[]) override;
+
+		void setReal(const ValueReference vr[], size_t nvr, const double value[]) override;
+		void setInteger(const ValueReference vr[], size_t nvr, const int value[]) override;
+		void setBoolean(const ValueReference vr[], size_t nvr, const bool value[]) override;
+
 	protected:
-        static FMU1 *s_currentInstance;
-        
+		// the instance that is calling into the FMU on the current thread
+		static thread_local FMU1 *s_currentInstance;
+
+		// instances by component (routes the log messages from threads of the FMU to the instance)
+		void registerComponent();
+		void unregisterComponent();
+
 		static void logFMU1Message(fmi1Component c, fmi1String instanceName, fmi1Status status, fmi1String category, fmi1String message, ...);
 
 		fmi1Component m_component ;
@@ -47,38 +114,13 @@ namespace fmikit {
 
 		void assertNoError(fmi1Status status, const char *message);
 
-		template<typename T> T* getFunc(const char *functionName, bool required = true) {
-
-			std::string procName = modelIdentifier() + "_" + functionName;
-
-# ifdef _WIN32
-			FARPROC fp = GetProcAddress(m_libraryHandle, procName.c_str());
-# else
-			void *fp = dlsym(m_libraryHandle, procName.c_str());
-# endif
-
-			if (required && !fp) {
-				error("Function %s not found in shared library", functionName);
-			}
-
-			return reinterpret_cast<T *>(fp);
-		}
-
-		/* Common functions for FMI 1.0 */
-		fmi1GetTypesPlatformTYPE *fmi1GetTypesPlatform;
-		fmi1GetVersionTYPE		 *fmi1GetVersion;
-		fmi1GetRealTYPE          *fmi1GetReal;
-		fmi1GetIntegerTYPE		 *fmi1GetInteger;
-		fmi1GetBooleanTYPE		 *fmi1GetBoolean;
-		fmi1GetStringTYPE		 *fmi1GetString;
-		fmi1SetDebugLoggingTYPE	 *fmi1SetDebugLogging;
-		fmi1SetRealTYPE			 *fmi1SetReal;
-		fmi1SetIntegerTYPE	     *fmi1SetInteger;
-		fmi1SetBooleanTYPE		 *fmi1SetBoolean;
-		fmi1SetStringTYPE		 *fmi1SetString;
+		const FMU1Functions *m_functions; // shared by all instances of the same binary
 
 	private:
 
+		// conversion buffer for the Boolean array functions
+		std::vector<fmi1Boolean> m_booleanBuffer;
+
 		/* Wrapper functions for SEH */
 		void getCString(ValueReference vr, char *value);
 		void setCString(ValueReference vr, const char *value);
@@ -86,7 +128,7 @@ namespace fmikit {
 	};
 
 
-	class FMU1Slave : public FMU1, public Slave {
+	class FMU1Slave final : public FMU1, public Slave {
 
 	public:
 		FMU1Slave(const std::string &guid,
@@ -110,27 +152,9 @@ namespace fmikit {
 		void terminateSlave();
 		void freeSlaveInstance();
 
-		/***************************************************
-		Functions for FMI 1.0 for Co-Simulation
-		****************************************************/
-		fmi1InstantiateSlaveTYPE		 *fmi1InstantiateSlave;
-		fmi1InitializeSlaveTYPE			 *fmi1InitializeSlave;
-		fmi1TerminateSlaveTYPE			 *fmi1TerminateSlave;
-		fmi1ResetSlaveTYPE				 *fmi1ResetSlave;
-		fmi1FreeSlaveInstanceTYPE		 *fmi1FreeSlaveInstance;
-		fmi1GetRealOutputDerivativesTYPE *fmi1GetRealOutputDerivatives;
-		fmi1SetRealInputDerivativesTYPE  *fmi1SetRealInputDerivatives;
-		fmi1DoStepTYPE					 *fmi1DoStep;
-		fmi1CancelStepTYPE				 *fmi1CancelStep;
-		fmi1GetStatusTYPE				 *fmi1GetStatus;
-		fmi1GetRealStatusTYPE			 *fmi1GetRealStatus;
-		fmi1GetIntegerStatusTYPE		 *fmi1GetIntegerStatus;
-		fmi1GetBooleanStatusTYPE		 *fmi1GetBooleanStatus;
-		fmi1GetStringStatusTYPE			 *fmi1GetStringStatus;
-
 	};
 
-	class FMU1Model : public FMU1, public Model {
+	class FMU1Model final : public FMU1, public Model {
 
 	public:
 		explicit FMU1Model(	const std::string &guid,
@@ -169,22 +193,6 @@ namespace fmikit {
 		void terminate();
 		void freeModelInstance();
 
-		/* Functions for FMI 1.0 for Model Exchange */
-		fmi1GetModelTypesPlatformTYPE	   *fmi1GetModelTypesPlatform;
-		fmi1InstantiateModelTYPE		   *fmi1InstantiateModel;
-		fmi1FreeModelInstanceTYPE		   *fmi1FreeModelInstance;
-		fmi1SetTimeTYPE					   *fmi1SetTime;
-		fmi1SetContinuousStatesTYPE		   *fmi1SetContinuousStates;
-		fmi1CompletedIntegratorStepTYPE    *fmi1CompletedIntegratorStep;
-		fmi1InitializeTYPE				   *fmi1Initialize;
-		fmi1GetDerivativesTYPE			   *fmi1GetDerivatives;
-		fmi1GetEventIndicatorsTYPE		   *fmi1GetEventIndicators;
-		fmi1EventUpdateTYPE				   *fmi1EventUpdate;
-		fmi1GetContinuousStatesTYPE		   *fmi1GetContinuousStates;
-		fmi1GetNominalContinuousStatesTYPE *fmi1GetNominalContinuousStates;
-		fmi1GetStateValueReferencesTYPE    *fmi1GetStateValueReferences;
-		fmi1TerminateTYPE				   *fmi1Terminate;
-
 	};
 
 }
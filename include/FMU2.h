@@ -6,8 +6,11 @@
  *  root for license information.                                *
  *****************************************************************/
  
+#include <vector>
+
 #include "fmi2Functions.h"
 #include "FMU.h"
+#include "SharedLibrary.h"
 
 
 namespace fmikit {
@@ -56,6 +59,74 @@ namespace fmikit {
 
 	const int fmi2GetBIRSStatusMask = StepCompleteState | StepInProgressState | StepFailedState | TerminatedState;
 
+	/* The FMI 2.0 functions of a shared library (nullptr if not exported), resolved once
+	   and shared by all instances of the binary (see SharedLibrary::functions()) */
+	struct FMU2Functions {
+
+		FMU2Functions(const SharedLibrary &library, const std::string &prefix);
+
+		/***************************************************
+		Common Functions for FMI 2.0
+		****************************************************/
+
+		/* required functions */
+		fmi2GetTypesPlatformTYPE         *fmi2GetTypesPlatform;
+		fmi2GetVersionTYPE               *fmi2GetVersion;
+		fmi2SetDebugLoggingTYPE          *fmi2SetDebugLogging;
+		fmi2InstantiateTYPE              *fmi2Instantiate;
+		fmi2FreeInstanceTYPE             *fmi2FreeInstance;
+		fmi2SetupExperimentTYPE          *fmi2SetupExperiment;
+		fmi2EnterInitializationModeTYPE  *fmi2EnterInitializationMode;
+		fmi2ExitInitializationModeTYPE   *fmi2ExitInitializationMode;
+		fmi2TerminateTYPE                *fmi2Terminate;
+		fmi2ResetTYPE                    *fmi2Reset;
+		fmi2GetRealTYPE                  *fmi2GetReal;
+		fmi2GetIntegerTYPE               *fmi2GetInteger;
+		fmi2GetBooleanTYPE               *fmi2GetBoolean;
+		fmi2GetStringTYPE                *fmi2GetString;
+		fmi2SetRealTYPE                  *fmi2SetReal;
+		fmi2SetIntegerTYPE               *fmi2SetInteger;
+		fmi2SetBooleanTYPE               *fmi2SetBoolean;
+		fmi2SetStringTYPE                *fmi2SetString;
+
+		/* optional functions */
+		fmi2GetFMUstateTYPE              *fmi2GetFMUstate;
+		fmi2SetFMUstateTYPE              *fmi2SetFMUstate;
+		fmi2FreeFMUstateTYPE             *fmi2FreeFMUstate;
+		fmi2SerializedFMUstateSizeTYPE   *fmi2SerializedFMUstateSize;
+		fmi2SerializeFMUstateTYPE        *fmi2SerializeFMUstate;
+		fmi2DeSerializeFMUstateTYPE      *fmi2DeSerializeFMUstate;
+		fmi2GetDirectionalDerivativeTYPE *fmi2GetDirectionalDerivative;
+
+		/***************************************************
+		Functions for FMI 2.0 for Co-Simulation
+		****************************************************/
+		fmi2SetRealInputDerivativesTYPE  *fmi2SetRealInputDerivatives;
+		fmi2GetRealOutputDerivativesTYPE *fmi2GetRealOutputDerivatives;
+		fmi2DoStepTYPE                   *fmi2DoStep;
+		fmi2CancelStepTYPE               *fmi2CancelStep;
+		fmi2GetStatusTYPE                *fmi2GetStatus;
+		fmi2GetRealStatusTYPE            *fmi2GetRealStatus;
+		fmi2GetIntegerStatusTYPE         *fmi2GetIntegerStatus;
+		fmi2GetBooleanStatusTYPE         *fmi2GetBooleanStatus;
+		fmi2GetStringStatusTYPE			 *fmi2GetStringStatus;
+
+		/***************************************************
+		Functions for FMI 2.0 for Model Exchange
+		****************************************************/
+		fmi2EnterEventModeTYPE                *fmi2EnterEventMode;
+		fmi2NewDiscreteStatesTYPE             *fmi2NewDiscreteStates;
+		fmi2EnterContinuousTimeModeTYPE       *fmi2EnterContinuousTimeMode;
+		fmi2CompletedIntegratorStepTYPE       *fmi2CompletedIntegratorStep;
+		fmi2SetTimeTYPE                       *fmi2SetTime;
+		fmi2SetContinuousStatesTYPE           *fmi2SetContinuousStates;
+		fmi2GetDerivativesTYPE                *fmi2GetDerivatives;
+		fmi2GetEventIndicatorsTYPE            *fmi2GetEventIndicators;
+		fmi2GetContinuousStatesTYPE           *fmi2GetContinuousStates;
+		fmi2GetNominalsOfContinuousStatesTYPE *fmi2GetNominalsOfContinuousStates;
+
+	};
+
 	class FMU2 : public FMU {
 
 	public:
@@ -77,6 +148,49 @@ namespace fmikit {
 		void setBoolean(ValueReference vr, bool value) override;
 		void setString(ValueReference vr, std::string value) override;
 
+		void getReal(const ValueReference vr[], size_t nvr, double value[]) override;
+		void getInteger(const ValueReference vr[], size_t nvr, int value[]) override;
+		void getBoolean(const ValueReference vr[], size_t nvr, bool value[]) override;
+
+		void setReal(const ValueReference vr[], size_t nvr, const double value[]) override;
+		void setInteger(const ValueReference vr[], size_t nvr, const int value[]) override;
+		void setBoolean(const ValueReference vr[], size_t nvr, const bool value[]) override;
+
+		// true if the FMU exports fmi2GetDirectionalDerivative
+		bool providesDirectionalDerivative() const { return m_functions->fmi2GetDirectionalDerivative != nullptr; }
+
+		// partial derivatives of the unknowns w.r.t. the knowns multiplied by the seed dvKnown
+		void getDirectionalDerivative(const ValueReference vUnknown[], size_t nUnknown, const ValueReference vKnown[], size_t nKnown, const double dvKnown[], double dvUnknown[]);
+
+		// true if the FMU exports fmi2GetFMUstate, fmi2SetFMUstate and fmi2FreeFMUstate
+		bool canGetAndSetFMUstate() const { return m_functions->fmi2GetFMUstate && m_functions->fmi2SetFMUstate && m_functions->fmi2FreeFMUstate; }
+
+		/* The FMU states are kept in a pool of slots. A released slot keeps its fmi2FMUstate which is
+		   overwritten by fmi2GetFMUstate when the slot is reused so repeated checkpointing does not
+		   allocate. The states are freed by the destructor. */
+
+		// saves the current state of the FMU in a free slot and returns the slot
+		size_t saveState();
+
+		// overwrites the state in slot with the current state of the FMU
+		void saveState(size_t slot);
+
+		// restores the state saved in slot (the slot remains valid), the mode of the FMU does not change
+		void restoreState(size_t slot);
+
+		// returns the slot to the pool
+		void releaseState(size_t slot);
+
+		// true if the FMU can get and set its state and also exports fmi2SerializedFMUstateSize,
+		// fmi2SerializeFMUstate and fmi2DeSerializeFMUstate
+		bool canSerializeFMUstate() const { return canGetAndSetFMUstate() && m_functions->fmi2SerializedFMUstateSize && m_functions->fmi2SerializeFMUstate && m_functions->fmi2DeSerializeFMUstate; }
+
+		// serializes the state saved in slot (including the time) into data
+		void serializeState(size_t slot, std::vector<char> &data);
+
+		// deserializes data written by serializeState() into a free slot and returns the slot
+		size_t deserializeState(const char data[], size_t size);
+
 		State getState() const { return m_state; }
 
 	protected:
@@ -92,55 +206,27 @@ namespace fmikit {
 
 		void assertNoError(fmi2Status status, const char *message);
 
-		template<typename T> T* getFunc(const char *functionName, bool required = true) {
+		// true if a state slot is in use (the FMU must keep the history to restore it)
+		bool hasSavedStates() const { return m_stateSlots.size() > m_freeStateSlots.size(); }
 
-# ifdef _WIN32
-			auto *fp = GetProcAddress(m_libraryHandle, functionName);
-# else
-			auto *fp = dlsym(m_libraryHandle, functionName);
-# endif
+		const FMU2Functions *m_functions; // shared by all instances of the same binary
 
-			if (required && !fp) {
-				error("Function %s not found in shared library", functionName);
-			}
+	private:
 
-			return reinterpret_cast<T *>(fp);
-		}
+		// conversion buffer for the Boolean array functions
+		std::vector<fmi2Boolean> m_booleanBuffer;
 
-		/***************************************************
-		Common Functions for FMI 2.0
-		****************************************************/
+		struct StateSlot {
+			fmi2FMUstate state = nullptr;
+			double time = 0;
+			bool used = false;
+		};
 
-		/* required functions */
-		fmi2GetTypesPlatformTYPE         *fmi2GetTypesPlatform;
-		fmi2GetVersionTYPE               *fmi2GetVersion;
-		fmi2SetDebugLoggingTYPE          *fmi2SetDebugLogging;
-		fmi2InstantiateTYPE              *fmi2Instantiate;
-		fmi2FreeInstanceTYPE             *fmi2FreeInstance;
-		fmi2SetupExperimentTYPE          *fmi2SetupExperiment;
-		fmi2EnterInitializationModeTYPE  *fmi2EnterInitializationMode;
-		fmi2ExitInitializationModeTYPE   *fmi2ExitInitializationMode;
-		fmi2TerminateTYPE                *fmi2Terminate;
-		fmi2ResetTYPE                    *fmi2Reset;
-		fmi2GetRealTYPE                  *fmi2GetReal;
-		fmi2GetIntegerTYPE               *fmi2GetInteger;
-		fmi2GetBooleanTYPE               *fmi2GetBoolean;
-		fmi2GetStringTYPE                *fmi2GetString;
-		fmi2SetRealTYPE                  *fmi2SetReal;
-		fmi2SetIntegerTYPE               *fmi2SetInteger;
-		fmi2SetBooleanTYPE               *fmi2SetBoolean;
-		fmi2SetStringTYPE                *fmi2SetString;
+		std::vector<StateSlot> m_stateSlots;
+		std::vector<size_t> m_freeStateSlots;
 
-		/* optional functions */
-		fmi2GetFMUstateTYPE              *fmi2GetFMUstate;
-		fmi2SetFMUstateTYPE              *fmi2SetFMUstate;
-		fmi2FreeFMUstateTYPE             *fmi2FreeFMUstate;
-		fmi2SerializedFMUstateSizeTYPE   *fmi2SerializedFMUstateSize;
-		fmi2SerializeFMUstateTYPE        *fmi2SerializeFMUstate;
-		fmi2DeSerializeFMUstateTYPE      *fmi2DeSerializeFMUstate;
-		fmi2GetDirectionalDerivativeTYPE *fmi2GetDirectionalDerivative;
-
-	private:
+		StateSlot &stateSlot(size_t slot);
+		void freeStates();
 
 		/* Wrapper functions for SEH */
 		void instantiate_(fmi2String instanceName, fmi2Type fmuType, fmi2String fmuGUID, fmi2String fmuResourceLocation, const fmi2CallbackFunctions* functions, fmi2Boolean visible, fmi2Boolean loggingOn);
@@ -149,7 +235,7 @@ namespace fmikit {
 	};
 
 
-	class FMU2Slave : public FMU2, public Slave {
+	class FMU2Slave final : public FMU2, public Slave {
 
 	public:
 		explicit FMU2Slave(const std::string &guid, const std::string &modelIdentifier, const std::string &unzipDirectory, const std::string &instanceName, allocateMemoryCallback *allocateMemory = nullptr, freeMemoryCallback *freeMemory = nullptr);
@@ -162,23 +248,10 @@ namespace fmikit {
 
 	private:
 
-		/***************************************************
-		Functions for FMI 2.0 for Co-Simulation
-		****************************************************/
-		fmi2SetRealInputDerivativesTYPE  *fmi2SetRealInputDerivatives;
-		fmi2GetRealOutputDerivativesTYPE *fmi2GetRealOutputDerivatives;
-		fmi2DoStepTYPE                   *fmi2DoStep;
-		fmi2CancelStepTYPE               *fmi2CancelStep;
-		fmi2GetStatusTYPE                *fmi2GetStatus;
-		fmi2GetRealStatusTYPE            *fmi2GetRealStatus;
-		fmi2GetIntegerStatusTYPE         *fmi2GetIntegerStatus;
-		fmi2GetBooleanStatusTYPE         *fmi2GetBooleanStatus;
-		fmi2GetStringStatusTYPE			 *fmi2GetStringStatus;
-
 	};
 
 
-	class FMU2Model : public FMU2, public Model {
+	class FMU2Model final : public FMU2, public Model {
 
 	public:
 		explicit FMU2Model(const std::string &guid, const std::string &modelIdentifier, const std::string &unzipDirectory, const std::string &instanceName, allocateMemoryCallback *allocateMemory = nullptr, freeMemoryCallback *freeMemory = nullptr);
@@ -208,20 +281,6 @@ namespace fmikit {
 	private:
 		fmi2EventInfo m_eventInfo;
 
-		/***************************************************
-		Functions for FMI 2.0 for Model Exchange
-		****************************************************/
-		fmi2EnterEventModeTYPE                *fmi2EnterEventMode;
-		fmi2NewDiscreteStatesTYPE             *fmi2NewDiscreteStates;
-		fmi2EnterContinuousTimeModeTYPE       *fmi2EnterContinuousTimeMode;
-		fmi2CompletedIntegratorStepTYPE       *fmi2CompletedIntegratorStep;
-		fmi2SetTimeTYPE                       *fmi2SetTime;
-		fmi2SetContinuousStatesTYPE           *fmi2SetContinuousStates;
-		fmi2GetDerivativesTYPE                *fmi2GetDerivatives;
-		fmi2GetEventIndicatorsTYPE            *fmi2GetEventIndicators;
-		fmi2GetContinuousStatesTYPE           *fmi2GetContinuousStates;
-		fmi2GetNominalsOfContinuousStatesTYPE *fmi2GetNominalsOfContinuousStates;
-
 	};
 
 }
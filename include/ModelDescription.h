@@ -0,0 +1,161 @@
+#pragma once
+
+/*****************************************************************
+ *  Copyright (c) Dassault Systemes. All rights reserved.        *
+ *  This file is part of FMIKit. See LICENSE.txt in the project  *
+ *  root for license information.                                *
+ *****************************************************************/
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "FMU.h"
+
+
+namespace fmikit {
+
+	enum Causality {
+		CAUSALITY_PARAMETER,
+		CAUSALITY_CALCULATED_PARAMETER,
+		CAUSALITY_INPUT,
+		CAUSALITY_OUTPUT,
+		CAUSALITY_LOCAL,
+		CAUSALITY_INDEPENDENT
+	};
+
+	enum Variability {
+		VARIABILITY_CONSTANT,
+		VARIABILITY_FIXED,
+		VARIABILITY_TUNABLE,
+		VARIABILITY_DISCRETE,
+		VARIABILITY_CONTINUOUS
+	};
+
+	enum DependencyKind {
+		DEPENDENCY_DEPENDENT,
+		DEPENDENCY_CONSTANT,
+		DEPENDENCY_FIXED,
+		DEPENDENCY_TUNABLE,
+		DEPENDENCY_DISCRETE
+	};
+
+	struct ScalarVariable {
+		std::string name;
+		std::string description;
+		ValueReference valueReference = 0;
+		Type type = REAL;                 // enumerations are INTEGER
+		Causality causality = CAUSALITY_LOCAL;
+		Variability variability = VARIABILITY_CONTINUOUS;
+		bool hasStart = false;
+		double start = 0;                 // start value of Real, Integer, Enumeration and Boolean variables
+		std::string stringStart;          // start value of String variables
+		double nominal = 1;
+		size_t derivative = 0;            // one-based index of the state if the variable is a derivative
+	};
+
+	// element of the <ModelStructure> (FMI 2.0) or an output with <DirectDependency> (FMI 1.0)
+	struct Unknown {
+		size_t variable;      // index of the variable
+		bool dependent;       // true if the dependencies are not declared (depends on all knowns)
+		size_t begin;         // range of the dependencies in dependencies() and dependencyKinds()
+		size_t end;
+	};
+
+	struct Implementation {
+		bool defined = false;
+		std::string modelIdentifier;
+		bool providesDirectionalDerivative = false;
+		bool canGetAndSetFMUstate = false;
+		bool canSerializeFMUstate = false;
+		bool canHandleVariableCommunicationStepSize = false;
+	};
+
+	struct DefaultExperiment {
+		bool defined = false;
+		double startTime = 0;
+		double stopTime = 1;
+		double tolerance = 0;             // 0 if not defined
+		double stepSize = 0;              // 0 if not defined
+	};
+
+	/* Variables, default experiment and model structure of an FMI 1.0 or FMI 2.0 modelDescription.xml in
+	   flat arrays. The variables can be looked up by name or by type and value reference (the first variable
+	   with the value reference for aliases). Dependencies are stored in one array (CSR) and refer to the
+	   variables by index. The XML is parsed in place without validation against the schema. */
+	class ModelDescription {
+
+	public:
+		// reads and parses filename (e.g. <unzipdir>/modelDescription.xml), throws runtime_error on failure
+		explicit ModelDescription(const std::string &filename);
+
+		// parses the XML document in buffer (modified during parsing)
+		ModelDescription(char *buffer, size_t size);
+
+		FMIVersion fmiVersion() const { return m_fmiVersion; }
+		const std::string &modelName() const { return m_modelName; }
+		const std::string &guid() const { return m_guid; }
+		const std::string &generationTool() const { return m_generationTool; }
+
+		size_t numberOfContinuousStates() const { return m_numberOfContinuousStates; }
+		size_t numberOfEventIndicators() const { return m_numberOfEventIndicators; }
+
+		const Implementation &modelExchange() const { return m_modelExchange; }
+		const Implementation &coSimulation() const { return m_coSimulation; }
+		const DefaultExperiment &defaultExperiment() const { return m_defaultExperiment; }
+
+		const std::vector<ScalarVariable> &variables() const { return m_variables; }
+
+		// returns the variable with the given name or nullptr if there is no such variable
+		const ScalarVariable *variable(const std::string &name) const;
+
+		// returns the first variable of type with the value reference vr or nullptr if there is no such variable
+		const ScalarVariable *variable(Type type, ValueReference vr) const;
+
+		// index of the variable in variables()
+		size_t index(const ScalarVariable *variable) const { return static_cast<size_t>(variable - m_variables.data()); }
+
+		const std::vector<Unknown> &outputs() const { return m_outputs; }
+		const std::vector<Unknown> &derivatives() const { return m_derivatives; }
+		const std::vector<Unknown> &initialUnknowns() const { return m_initialUnknowns; }
+
+		// variable indices and kinds of the dependencies of all unknowns
+		const std::vector<size_t> &dependencies() const { return m_dependencies; }
+		const std::vector<DependencyKind> &dependencyKinds() const { return m_dependencyKinds; }
+
+		// value references of the continuous states and their derivatives in the order of the <Derivatives> (FMI 2.0),
+		// returns false if the states are not declared
+		bool getStates(std::vector<ValueReference> &states, std::vector<ValueReference> &derivatives) const;
+
+	private:
+		FMIVersion m_fmiVersion = FMI_VERSION_2;
+		std::string m_modelName;
+		std::string m_guid;
+		std::string m_generationTool;
+		size_t m_numberOfContinuousStates = 0;
+		size_t m_numberOfEventIndicators = 0;
+
+		Implementation m_modelExchange;
+		Implementation m_coSimulation;
+		DefaultExperiment m_defaultExperiment;
+
+		std::vector<ScalarVariable> m_variables;
+		std::unordered_map<std::string, size_t> m_variableIndices;
+
+		// value references of each type in ascending order with the index of the variable
+		std::vector<std::pair<ValueReference, size_t>> m_valueReferences[4];
+
+		std::vector<Unknown> m_outputs;
+		std::vector<Unknown> m_derivatives;
+		std::vector<Unknown> m_initialUnknowns;
+		std::vector<size_t> m_dependencies;
+		std::vector<DependencyKind> m_dependencyKinds;
+
+		class Parser;
+
+		void parse(char *buffer, size_t size);
+		void buildIndices();
+
+	};
+
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+/*****************************************************************
+ *  Copyright (c) Dassault Systemes. All rights reserved.        *
+ *  This file is part of FMIKit. See LICENSE.txt in the project  *
+ *  root for license information.                                *
+ *****************************************************************/
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "FMU2.h"
+
+
+namespace fmikit {
+
+	enum SolverType {
+		RK4,            // classical Runge-Kutta with a fixed step size
+		DORMAND_PRINCE, // adaptive Runge-Kutta 5(4) with error control
+		BDF             // implicit variable-step BDF2 with Newton iteration (for stiff models)
+	};
+
+	struct DriverSettings {
+		SolverType solver = DORMAND_PRINCE;
+		double startTime = 0;
+		double stopTime = 1;
+		double outputInterval = 1e-2;
+		double stepSize = 1e-3;          // fixed step (RK4), initial step (DORMAND_PRINCE) or maximum step (BDF)
+		double relativeTolerance = 1e-6;
+		double absoluteTolerance = 1e-8;
+
+		// value references of the continuous states and their derivatives (optional), if both are set
+		// and the FMU provides fmi2GetDirectionalDerivative the Jacobian is calculated by the FMU
+		std::vector<ValueReference> states;
+		std::vector<ValueReference> derivatives;
+	};
+
+	class ODESolver;
+
+	/* Simulates an FMU2Model without Simulink: initializes the instance, integrates the continuous
+	   states with a built-in solver, handles time-, state- and step events and writes the results.
+	   All buffers are allocated by the constructor so the integration does not allocate memory. */
+	class ModelDriver {
+
+	public:
+		// model must be instantiated and its start values set, nx and nz are the number of
+		// continuous states and event indicators
+		ModelDriver(FMU2Model *model, size_t nx, size_t nz, const DriverSettings &settings);
+		~ModelDriver();
+
+		ModelDriver(const ModelDriver&) = delete;
+		ModelDriver& operator=(const ModelDriver&) = delete;
+
+		// Real variables that are written to the result at every output point
+		void setOutputs(const std::vector<std::string> &names, const std::vector<ValueReference> &vr);
+
+		// initializes the model and simulates it until the stop time or until the model terminates,
+		// writes the outputs as CSV to result (may be nullptr)
+		void simulate(FILE *result = nullptr);
+
+		double time() const { return m_time; }
+
+		size_t steps() const { return m_steps; }
+		size_t events() const { return m_events; }
+		size_t rejectedSteps() const;
+
+		// right hand side of the ODE: sets time and states and gets the derivatives
+		void derivatives(double t, const double x[], double dx[]);
+
+		// Jacobian df/dx at (t, x) in column-major order, fx = f(t, x)
+		void jacobian(double t, double x[], const double fx[], double J[]);
+
+	private:
+		FMU2Model *m_model;
+		size_t m_nx;
+		size_t m_nz;
+		DriverSettings m_settings;
+
+		std::unique_ptr<ODESolver> m_solver;
+
+		bool m_directionalDerivatives;
+
+		double m_time = 0;
+		size_t m_steps = 0;
+		size_t m_events = 0;
+
+		// states, derivatives and event indicators at the end and the start of the last step
+		std::vector<double> m_x;
+		std::vector<double> m_dx;
+		std::vector<double> m_z;
+		std::vector<double> m_x0;
+		std::vector<double> m_dx0;
+		std::vector<double> m_z0;
+
+		// work arrays for the Jacobian and the event location
+		std::vector<double> m_seed;
+		std::vector<double> m_column;
+		std::vector<double> m_xt;
+		std::vector<double> m_zt;
+
+		std::vector<std::string> m_outputNames;
+		std::vector<ValueReference> m_outputs;
+		std::vector<double> m_outputValues;
+
+		void eventIteration();
+		void handleEvent(double t);
+		bool locateStateEvent(double t0, double t1, double &tEvent);
+		void interpolate(double t0, double t1, double t, double x[]) const;
+		void writeOutputs(FILE *result, double t);
+
+	};
+
+}
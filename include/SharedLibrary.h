@@ -0,0 +1,66 @@
+#pragma once
+
+/*****************************************************************
+ *  Copyright (c) Dassault Systemes. All rights reserved.        *
+ *  This file is part of FMIKit. See LICENSE.txt in the project  *
+ *  root for license information.                                *
+ *****************************************************************/
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+typedef void *HMODULE;
+#endif
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <typeindex>
+#include <unordered_map>
+
+namespace fmikit {
+
+	/* A shared library that is loaded once per process and shared by all FMU instances
+	   that use the same binary. The library is unloaded when the last instance releases it. */
+	class SharedLibrary {
+
+	public:
+		// returns the loaded library or loads it, returns nullptr and sets errorMessage on failure
+		static std::shared_ptr<SharedLibrary> load(const std::string &libraryPath, std::string &errorMessage);
+
+		~SharedLibrary();
+
+		SharedLibrary(const SharedLibrary&) = delete;
+		SharedLibrary& operator=(const SharedLibrary&) = delete;
+
+		const std::string& path() const { return m_path; }
+
+		// address of an exported function, nullptr if it does not exist
+		void *symbol(const std::string &name) const;
+
+		/* The table of entry points T of this library. It is resolved by T(library, prefix) when it is
+		   requested for the first time (when the first instance is created) and shared by all instances.
+		   The table is immutable, so the instances call the functions without locking or lookups. */
+		template<typename T> const T *functions(const std::string &prefix = "") {
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			auto &table = m_functions[std::type_index(typeid(T))];
+
+			if (!table) table = std::make_shared<const T>(*this, prefix);
+
+			return static_cast<const T *>(table.get());
+		}
+
+	private:
+		SharedLibrary(const std::string &path, HMODULE handle);
+
+		std::string m_path;
+		HMODULE m_handle;
+
+		std::mutex m_mutex;
+		std::unordered_map<std::type_index, std::shared_ptr<const void>> m_functions;
+
+	};
+
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+/*****************************************************************
+ *  Copyright (c) Dassault Systemes. All rights reserved.        *
+ *  This file is part of FMIKit. See LICENSE.txt in the project  *
+ *  root for license information.                                *
+ *****************************************************************/
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "FMU.h"
+#include "TransferPlan.h"
+
+
+namespace fmikit {
+
+	/* Owns a set of independent co-simulation instances (FMU1Slave or FMU2Slave) and
+	   advances them to a common communication point on a work-stealing thread pool */
+	class SlaveGroup {
+
+	public:
+		struct Error {
+			size_t instance;
+			std::string message;
+		};
+
+		struct WorkerStatistics {
+			size_t steps  = 0;  // number of instances stepped
+			size_t stolen = 0;  // number of instances taken from other workers' queues
+			double busy   = 0;  // time spent stepping instances [s]
+			double idle   = 0;  // time spent waiting for work [s]
+		};
+
+		// numWorkers = 0 starts one worker per hardware thread, cpus (optional) pins worker i to CPU cpus[i]
+		explicit SlaveGroup(size_t numWorkers = 0, const std::vector<int> &cpus = std::vector<int>());
+
+		// stops the workers and deletes the instances
+		~SlaveGroup();
+
+		SlaveGroup(const SlaveGroup&) = delete;
+		SlaveGroup& operator=(const SlaveGroup&) = delete;
+
+		// takes ownership of an initialized FMU1Slave or FMU2Slave and returns its index,
+		// the ports of inputs and outputs are transferred from / to the instance's buffers in every step
+		template<typename T> size_t add(T *slave, const TransferPlan &inputs = TransferPlan(), const TransferPlan &outputs = TransferPlan()) {
+			return addInstance(slave, slave, inputs, outputs);
+		}
+
+		size_t size() const { return m_instances.size(); }
+		size_t numWorkers() const { return m_workers.size(); }
+
+		FMU *instance(size_t index) const { return m_instances[index]->fmu.get(); }
+
+		// buffer of a port (double[], int[] or bool[] depending on the type of the port)
+		void *input(size_t index, size_t port);
+		const void *output(size_t index, size_t port) const;
+
+		// sets the inputs, advances all instances by h and gets the outputs,
+		// throws a runtime_error that lists the failed instances if any instance fails
+		void doStep(double h);
+
+		// instances that failed in the last step (failed instances are not stepped again)
+		const std::vector<Error>& errors() const { return m_errors; }
+
+		// the statistics of each worker since the start or the last reset
+		std::vector<WorkerStatistics> statistics() const;
+		void resetStatistics();
+
+	private:
+		struct Instance {
+			std::unique_ptr<FMU> fmu;
+			Slave *slave;
+			TransferPlan inputs;
+			TransferPlan outputs;
+			std::vector<size_t> inputOffsets;
+			std::vector<size_t> outputOffsets;
+			std::vector<double> buffer; // storage for the ports (double for alignment)
+			bool failed = false;
+		};
+
+		struct Worker {
+			std::thread thread;
+			std::mutex mutex; // protects tasks
+			std::deque<size_t> tasks;
+			WorkerStatistics statistics;
+		};
+
+		std::vector<std::unique_ptr<Instance>> m_instances;
+		std::vector<std::unique_ptr<Worker>> m_workers;
+
+		std::mutex m_mutex;
+		std::condition_variable m_start;
+		std::condition_variable m_done;
+		size_t m_generation = 0;
+		bool m_stop = false;
+		double m_h = 0;
+
+		std::atomic<size_t> m_pending;
+
+		std::mutex m_errorMutex;
+		std::vector<Error> m_errors;
+
+		size_t addInstance(FMU *fmu, Slave *slave, const TransferPlan &inputs, const TransferPlan &outputs);
+
+		void run(size_t index, int cpu);
+		bool nextTask(size_t worker, size_t &task, bool &stolen);
+		void step(size_t index, double h);
+
+	};
+
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+/*****************************************************************
+ *  Copyright (c) Dassault Systemes. All rights reserved.        *
+ *  This file is part of FMIKit. See LICENSE.txt in the project  *
+ *  root for license information.                                *
+ *****************************************************************/
+
+#include <vector>
+
+#include "FMU2.h"
+
+
+namespace fmikit {
+
+	/* Sparse Jacobian [A B; C D] of a model exchange FMU w.r.t. its continuous states and Real inputs in
+	   compressed sparse column (CSC) format. The columns are colored so that columns without common rows
+	   are evaluated together with one call to fmi2GetDirectionalDerivative or one finite difference.
+	   All buffers are allocated by the constructor. */
+	class SparseJacobian {
+
+	public:
+		// unknowns are the value references of the rows (nx derivatives followed by the outputs), knowns
+		// are the value references of the columns (nx states followed by the inputs), rows[k] and columns[k]
+		// are the structurally non-zero elements (rows and columns without elements may have any value reference),
+		// directionalDerivatives must only be true if the FMU provides directional derivatives (capability flag)
+		SparseJacobian(size_t nx, const std::vector<ValueReference> &unknowns, const std::vector<ValueReference> &knowns, const std::vector<size_t> &rows, const std::vector<size_t> &columns, bool directionalDerivatives);
+
+		size_t nnz() const { return m_ir.size(); }
+		size_t colors() const { return m_colors.size(); }
+
+		// row indices of the non-zero elements and index of the first element of each column (CSC)
+		const std::vector<size_t> &rowIndices() const { return m_ir; }
+		const std::vector<size_t> &columnStarts() const { return m_jc; }
+
+		// calculates the non-zero elements in CSC order at the current time, states x and inputs of the model
+		// with directional derivatives (if provided by the FMU) or colored forward differences
+		void evaluate(FMU2Model *model, const double x[], double values[]);
+
+	private:
+		size_t m_nx;
+		bool m_directionalDerivatives;
+		std::vector<size_t> m_ir;
+		std::vector<size_t> m_jc;
+		std::vector<std::vector<size_t>> m_colors; // columns of each color
+
+		// compact unknowns and knowns (only the rows and columns with non-zero elements)
+		std::vector<size_t> m_rowIndex;    // row -> unknown index
+		std::vector<size_t> m_columnIndex; // column -> known index
+		std::vector<ValueReference> m_unknownVRs;
+		std::vector<ValueReference> m_knownVRs;
+		std::vector<ValueReference> m_outputVRs;
+		std::vector<ValueReference> m_inputVRs;
+
+		// work arrays
+		std::vector<double> m_seed;
+		std::vector<double> m_dv;
+		std::vector<double> m_f0;
+		std::vector<double> m_f1;
+		std::vector<double> m_xt;
+		std::vector<double> m_u0;
+		std::vector<double> m_ut;
+		std::vector<double> m_h;
+
+		void evaluateDirectionalDerivatives(FMU2Model *model, double values[]);
+		void evaluateFiniteDifferences(FMU2Model *model, const double x[], double values[]);
+		void evaluateUnknowns(FMU2Model *model, double f[]);
+
+	};
+
+}
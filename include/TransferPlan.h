@@ -0,0 +1,80 @@
+#pragma once
+
+/*****************************************************************
+ *  Copyright (c) Dassault Systemes. All rights reserved.        *
+ *  This file is part of FMIKit. See LICENSE.txt in the project  *
+ *  root for license information.                                *
+ *****************************************************************/
+
+#include <memory>
+#include <vector>
+
+#include "FMU.h"
+
+
+namespace fmikit {
+
+	/* Precompiled mapping of value references onto contiguous buffers (e.g. Simulink ports).
+	   Each port is transferred with a single array call to the FMU. */
+	class TransferPlan {
+
+	public:
+		struct Port {
+			Type type;
+			size_t offset; // index of the first value reference
+			size_t size;   // number of value references
+		};
+
+		// adds a port and returns its index
+		size_t addPort(Type type, const ValueReference vr[], size_t nvr);
+
+		size_t size() const { return m_ports.size(); }
+		const Port& port(size_t index) const { return m_ports[index]; }
+		const ValueReference* valueReferences(size_t index) const { return &m_valueReferences[m_ports[index].offset]; }
+
+		// reads the variables of a port into buffer (double[], int[] or bool[] depending on the type)
+		void get(FMU *fmu, size_t index, void *buffer) const;
+
+		// writes the variables of a port from buffer (double[], int[] or bool[] depending on the type)
+		void set(FMU *fmu, size_t index, const void *buffer) const;
+
+	private:
+		std::vector<Port> m_ports;
+		std::vector<ValueReference> m_valueReferences;
+
+	};
+
+	/* Collects the elements of ports that changed since they were last set (compared with a cache
+	   of one double per variable) and sets them with one call per type */
+	class InputChangeSet {
+
+	public:
+		// allocates the buffers for n variables
+		void reserve(size_t n);
+
+		// adds the elements of the port that differ from cache and updates the cache (NaN is always different)
+		void add(const TransferPlan &plan, size_t index, const void *buffer, double cache[]);
+
+		// sets the collected elements and clears the set
+		void set(FMU *fmu);
+
+		// number of values that were set / skipped because they did not change
+		size_t transferred() const { return m_transferred; }
+		size_t skipped() const { return m_skipped; }
+
+	private:
+		std::vector<ValueReference> m_realVRs;
+		std::vector<ValueReference> m_integerVRs;
+		std::vector<ValueReference> m_booleanVRs;
+		std::vector<double> m_reals;
+		std::vector<int> m_integers;
+		std::unique_ptr<bool[]> m_booleans;
+		size_t m_nReals = 0;
+		size_t m_nIntegers = 0;
+		size_t m_nBooleans = 0;
+		size_t m_transferred = 0;
+		size_t m_skipped = 0;
+
+	};
+
+}
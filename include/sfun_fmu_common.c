@@ -12,6 +12,11 @@
 #define ASSERT_OK(F, M)  if (F != fmi2OK) { ssSetErrorStatus(S, M); return; }
 #endif
 
+/* 1 if the FMU declares canGetAndSetFMUstate and canSerializeFMUstate (defined by the generated S-function) */
+#ifndef CAN_SERIALIZE_FMU_STATE
+#define CAN_SERIALIZE_FMU_STATE 0
+#endif
+
 
 typedef enum {
 	REAL, INTEGER, BOOLEAN, STRING
@@ -260,6 +265,82 @@ static void mdlUpdate(SimStruct *S, int_T tid) {
 #endif // MDL_UPDATE
 
 
+#if FMI_VERSION == 2
+#define MDL_SIM_STATE
+#endif
+
+#if defined(MDL_SIM_STATE)
+static const char *simStateFields[] = { "fmuState", "rwork", "x" };
+
+static mxArray *mdlGetSimState(SimStruct *S) {
+
+	fmi2FMUstate state = NULL;
+	size_t size;
+	mxArray *simState, *fmuState, *rwork, *x;
+
+	if (fmi2GetFMUstate(COMPONENT, &state) != fmi2OK) {
+		ssSetErrorStatus(S, "Failed to get FMU state");
+		return NULL;
+	}
+
+	if (fmi2SerializedFMUstateSize(COMPONENT, state, &size) != fmi2OK) {
+		fmi2FreeFMUstate(COMPONENT, &state);
+		ssSetErrorStatus(S, "Failed to get serialized FMU state size");
+		return NULL;
+	}
+
+	fmuState = mxCreateNumericMatrix(size, 1, mxUINT8_CLASS, mxREAL);
+
+	if (fmi2SerializeFMUstate(COMPONENT, state, (fmi2Byte *)mxGetData(fmuState), size) != fmi2OK) {
+		fmi2FreeFMUstate(COMPONENT, &state);
+		mxDestroyArray(fmuState);
+		ssSetErrorStatus(S, "Failed to serialize FMU state");
+		return NULL;
+	}
+
+	fmi2FreeFMUstate(COMPONENT, &state);
+
+	rwork = mxCreateDoubleMatrix(ssGetNumRWork(S), 1, mxREAL);
+	memcpy(mxGetPr(rwork), ssGetRWork(S), ssGetNumRWork(S) * sizeof(real_T));
+
+	x = mxCreateDoubleMatrix(ssGetNumContStates(S), 1, mxREAL);
+	memcpy(mxGetPr(x), ssGetContStates(S), ssGetNumContStates(S) * sizeof(real_T));
+
+	simState = mxCreateStructMatrix(1, 1, 3, simStateFields);
+	mxSetField(simState, 0, "fmuState", fmuState);
+	mxSetField(simState, 0, "rwork", rwork);
+	mxSetField(simState, 0, "x", x);
+
+	return simState;
+}
+
+static void mdlSetSimState(SimStruct *S, const mxArray *simState) {
+
+	fmi2FMUstate state = NULL;
+	fmi2Status status;
+	mxArray *fmuState = mxGetField(simState, 0, "fmuState");
+	mxArray *rwork    = mxGetField(simState, 0, "rwork");
+	mxArray *x        = mxGetField(simState, 0, "x");
+
+	if (!fmuState || !rwork || !x || mxGetNumberOfElements(rwork) != ssGetNumRWork(S) || mxGetNumberOfElements(x) != ssGetNumContStates(S)) {
+		ssSetErrorStatus(S, "The simulation state does not match the block");
+		return;
+	}
+
+	ASSERT_OK(fmi2DeSerializeFMUstate(COMPONENT, (const fmi2Byte *)mxGetData(fmuState), mxGetNumberOfElements(fmuState), &state), "Failed to deserialize FMU state")
+
+	status = fmi2SetFMUstate(COMPONENT, state);
+
+	fmi2FreeFMUstate(COMPONENT, &state);
+
+	ASSERT_OK(status, "Failed to set FMU state")
+
+	memcpy(ssGetRWork(S), mxGetPr(rwork), ssGetNumRWork(S) * sizeof(real_T));
+	memcpy(ssGetContStates(S), mxGetPr(x), ssGetNumContStates(S) * sizeof(real_T));
+}
+#endif /* MDL_SIM_STATE */
+
+
 #define MDL_CHECK_PARAMETERS
 #if defined(MDL_CHECK_PARAMETERS) && defined(MATLAB_MEX_FILE)
 static void mdlCheckParameters(SimStruct *S) {
@@ -413,8 +494,12 @@ static void mdlInitializeSizes(SimStruct *S)
 	ssSetNumPWork(S, 2);  // [COMPONENT, EVENT_INFO]
 #endif
 
-	/* Specify the sim state compliance to be same as a built-in block */
-	//ssSetSimStateCompliance(S, USE_DEFAULT_SIM_STATE);
+	/* the sim state of FMI 2.0 FMUs is saved with fmi2SerializeFMUstate (if the FMU declares canGetAndSetFMUstate and canSerializeFMUstate) */
+#if FMI_VERSION == 2 && CAN_SERIALIZE_FMU_STATE
+	ssSetSimStateCompliance(S, USE_CUSTOM_SIM_STATE);
+#else
+	ssSetSimStateCompliance(S, DISALLOW_SIM_STATE);
+#endif
 
 	ssSetOptions(S, 0);
 }
@@ -15,23 +15,38 @@
 
 #include <stdio.h>
 #include <stdarg.h>
+#include <math.h>
+#include <algorithm>
+#include <limits>
+#include <memory>
 #include <string>
+#include <vector>
 
 extern "C" {
 #include "simstruc.h"
 
 #ifdef GRTFMI
-extern const char *FMU_RESOURCES_DIR;
+// resources directory of the FMU instance that is executing the model on this thread (see grtfmi/fmi2Functions.c)
+extern thread_local const char *FMU_RESOURCES_DIR;
 #endif
 }
 
 #include "FMU1.h"
 #include "FMU2.h"
+#include "TransferPlan.h"
+#include "SparseJacobian.h"
+#include "AsyncLogWriter.h"
+#include "CallTrace.h"
+#include "CallStatistics.h"
+#include "CallTimeline.h"
 
 using namespace std;
 using namespace fmikit;
 
 #define MAX_MESSAGE_SIZE 4096
+#define LOG_BUFFER_SIZE (4 * 1024 * 1024) // memory budget for buffered messages to the log file
+#define TRACE_FILE_EXTENSION ".fmitrace"   // log files with this extension receive a binary call trace
+#define TIMELINE_FILE_EXTENSION ".json"    // log files with this extension receive a timeline in the trace event format
 
 enum Parameter {
 
@@ -61,6 +76,14 @@ enum Parameter {
 	outputPortWidthsParam,
 	outputPortTypesParam,
 	outputPortVariableVRsParam,
+	locateStateEventsParam,
+	outputPortMajorStepOnlyParam,
+	stateVRsParam,
+	derivativeVRsParam,
+	jacobianPatternParam,
+	directionalDerivativesParam,
+	profileFMICallsParam,
+	canSerializeFMUstateParam,
 	numParams
 
 };
@@ -128,6 +151,27 @@ static string logFile(SimStruct *S) {
     return getStringParam(S, logFileParam);
 }
 
+static bool hasExtension(const string &filename, const char *extension) {
+	const size_t n = strlen(extension);
+	return filename.size() > n && filename.compare(filename.size() - n, n, extension) == 0;
+}
+
+static bool locateStateEvents(SimStruct *S) {
+    return mxGetScalar(ssGetSFcnParam(S, locateStateEventsParam)) != 0;
+}
+
+static bool directionalDerivatives(SimStruct *S) {
+    return mxGetScalar(ssGetSFcnParam(S, directionalDerivativesParam)) != 0;
+}
+
+static bool profileFMICalls(SimStruct *S) {
+    return mxGetScalar(ssGetSFcnParam(S, profileFMICallsParam)) != 0;
+}
+
+static bool canSerializeFMUstate(SimStruct *S) {
+    return mxGetScalar(ssGetSFcnParam(S, canSerializeFMUstateParam)) != 0;
+}
+
 static double relativeTolerance(SimStruct *S) {
     return mxGetScalar(ssGetSFcnParam(S, relativeToleranceParam));
 }
@@ -163,12 +207,30 @@ static bool inputPortDirectFeedThrough(SimStruct *S, int index) {
 	return static_cast<real_T *>(mxGetData(ssGetSFcnParam(S, inputPortDirectFeedThroughParam)))[index] != 0;
 }
 
+// true if the output port is only updated in major time steps
+static bool outputPortMajorStepOnly(SimStruct *S, int index) {
+	return static_cast<real_T *>(mxGetData(ssGetSFcnParam(S, outputPortMajorStepOnlyParam)))[index] != 0;
+}
+
 // number of input ports
 inline size_t nu(SimStruct *S) { return mxGetNumberOfElements(ssGetSFcnParam(S, inputPortWidthsParam)); }
 
 // number of input variables
 inline size_t nuv(SimStruct *S) { return mxGetNumberOfElements(ssGetSFcnParam(S, inputPortVariableVRsParam)); }
 
+// number of structurally non-zero elements of the block Jacobian
+inline size_t jacobianNnz(SimStruct *S) { return mxGetNumberOfElements(ssGetSFcnParam(S, jacobianPatternParam)) / 2; }
+
+// true if the block provides its Jacobian (FMI 2.0 model exchange with a sparsity pattern)
+inline bool blockJacobian(SimStruct *S) {
+	return fmiVersion(S) == "2.0" && runAsKind(S) == MODEL_EXCHANGE && nx(S) > 0 && jacobianNnz(S) > 0
+		&& mxGetNumberOfElements(ssGetSFcnParam(S, stateVRsParam)) == nx(S)
+		&& mxGetNumberOfElements(ssGetSFcnParam(S, derivativeVRsParam)) == nx(S);
+}
+
+// true if state events are located inside the major steps
+inline bool eventLocation(SimStruct *S) { return runAsKind(S) == MODEL_EXCHANGE && locateStateEvents(S) && nx(S) > 0 && nz(S) > 0; }
+
 inline ValueReference valueReference(SimStruct *S, Parameter parameter, int index) {
 	auto param = ssGetSFcnParam(S, parameter);
 	auto realValue = static_cast<real_T *>(mxGetData(param))[index];
@@ -209,11 +271,71 @@ static int outputPortWidth(SimStruct *S, int index) {
 
 inline size_t ny(SimStruct *S) { return mxGetNumberOfElements(ssGetSFcnParam(S, outputPortWidthsParam)); }
 
-template<typename T> T *component(SimStruct *S) {
-	auto fmu = static_cast<FMU *>(ssGetPWork(S)[0]);
-	return dynamic_cast<T *>(fmu);
+// concrete type of the FMU instance
+enum ComponentType {
+	FMU1_CO_SIMULATION,
+	FMU1_MODEL_EXCHANGE,
+	FMU2_CO_SIMULATION,
+	FMU2_MODEL_EXCHANGE
+};
+
+// parameters decoded once in mdlStart for the callbacks in the simulation loop
+struct BlockDescriptor {
+	ComponentType type;
+	FMU *fmu;         // the instance (same as PWork[0])
+	int nx;           // number of continuous states
+	int nz;           // number of event indicators
+	bool logFMICalls;
+	bool locateStateEvents;
+	int eventLocationWork; // RWork index of [pret, prex, predx] (if state events are located)
+	vector<real_T> xt;     // work arrays for the event location
+	vector<real_T> dx1;
+	vector<real_T> dx2;
+	vector<real_T> zt;
+	vector<char> inputPortDirectFeedThrough;
+	vector<char> outputPortRead;          // false if the output port is not connected
+	vector<char> outputPortMajorStepOnly; // true if the output port is only read in major time steps
+	TransferPlan inputs;
+	TransferPlan outputs;
+	InputChangeSet inputChanges; // changed input values (compared with preu) that are set in one call per type
+	int initialState;            // FMU state slot after the initialization (FMI 2.0, -1 if not supported)
+	vector<char> serializedState;
+	unique_ptr<SparseJacobian> jacobian; // block Jacobian (if provided)
+	vector<double> absTol;       // absolute tolerances of the solver for the states (empty for fixed step solvers)
+	vector<double> nominals;     // nominal values of the continuous states
+	unique_ptr<AsyncLogWriter> logWriter; // writes to the log file (if any)
+	unique_ptr<CallTrace> callTrace;      // binary trace of the FMI calls (if the log file is a trace file)
+	unique_ptr<CallStatistics> callStatistics; // latencies of the FMI calls (if profiling is enabled)
+	unique_ptr<CallTimeline> callTimeline;     // timeline of the FMI calls and callbacks (if the log file is a timeline)
+};
+
+inline BlockDescriptor *descriptor(SimStruct *S) {
+	void **p = ssGetPWork(S);
+	return p ? static_cast<BlockDescriptor *>(p[2]) : nullptr;
 }
 
+// records the time spent in an S-function callback on the timeline of the block (if any)
+class TimelineScope {
+
+public:
+	TimelineScope(SimStruct *S, const char *name) : m_S(S), m_name(name) {
+		auto d = descriptor(S);
+		m_timeline = d ? d->callTimeline.get() : nullptr;
+		m_start = m_timeline ? CallStatistics::now() : 0;
+	}
+
+	~TimelineScope() {
+		if (m_timeline) m_timeline->complete(m_name, m_start, CallStatistics::now(), ssGetT(m_S));
+	}
+
+private:
+	SimStruct *m_S;
+	const char *m_name;
+	CallTimeline *m_timeline;
+	uint64_t m_start;
+
+};
+
 static void logCall(SimStruct *S, const char* message) {
 
     FILE *logfile = nullptr;
@@ -224,7 +346,15 @@ static void logCall(SimStruct *S, const char* message) {
         logfile = static_cast<FILE *>(p[1]);
     }
 
-    if (logfile) {
+	auto d = descriptor(S);
+
+	if (d && d->callTrace) {
+		d->callTrace->message(ssGetT(S), message);
+	} else if (d && d->callTimeline) {
+		d->callTimeline->instant(message, ssGetT(S));
+	} else if (d && d->logWriter) {
+		d->logWriter->write(message);
+	} else if (logfile) {
         fputs(message, logfile);
         fputs("\n", logfile);
         fflush(logfile);
@@ -253,7 +383,9 @@ static void logFMICall(FMU *instance, const char* message) {
 /* log mdl*() and fmi*() calls */
 static void logDebug(SimStruct *S, const char* message, ...) {
 
-    if (logFMICalls(S)) {
+	auto d = descriptor(S);
+
+    if (d ? d->logFMICalls : logFMICalls(S)) {
         va_list args;
         va_start(args, message);
         char buf[MAX_MESSAGE_SIZE];
@@ -264,80 +396,144 @@ static void logDebug(SimStruct *S, const char* message, ...) {
     }
 }
 
-static void setInput(SimStruct *S, bool direct) {
+// fill the plan so that each port is transferred with one FMI call
+static void createTransferPlan(SimStruct *S, TransferPlan &plan, size_t nPorts, int (*portWidth)(SimStruct *, int), Parameter typesParam, Parameter vrsParam) {
 
-	auto fmu = component<FMU>(S);
+	vector<ValueReference> vrs;
 
-	int iu = 0;
+	int iv = 0;
 
-	for (int i = 0; i < nu(S); i++) {
+	for (int i = 0; i < nPorts; i++) {
 
-		const auto w = inputPortWidth(S, i);
+		const auto w = portWidth(S, i);
 
-		if (direct && !inputPortDirectFeedThrough(S, i)) {
-			iu += w;
-			continue;
+		vrs.resize(w);
+
+		for (int j = 0; j < w; j++) {
+			vrs[j] = valueReference(S, vrsParam, iv++);
 		}
 
-		auto type = variableType(S, inputPortTypesParam, i);
+		plan.addPort(variableType(S, typesParam, i), vrs.data(), w);
+	}
+}
 
-		const void *y = ssGetInputPortSignal(S, i);
+// the rows of the Jacobian are the derivatives and the output variables,
+// the columns are the states and the input variables
+static void createJacobian(SimStruct *S, BlockDescriptor *d) {
 
-		for (int j = 0; j < w; j++) {
+	const auto n = nx(S);
+	const auto nyv = mxGetNumberOfElements(ssGetSFcnParam(S, outputPortVariableVRsParam));
 
-			const auto vr = valueReference(S, inputPortVariableVRsParam, iu);
-
-			// set the input
-			switch (type) {
-			case Type::REAL:
-				fmu->setReal(vr, static_cast<const real_T*>(y)[j]);
-				break;
-			case Type::INTEGER:
-				fmu->setInteger(vr, static_cast<const int32_T*>(y)[j]);
-				break;
-			case Type::BOOLEAN:
-				fmu->setBoolean(vr, static_cast<const boolean_T*>(y)[j]);
-				break;
-			default:
-				break;
-			}
+	vector<ValueReference> unknowns, knowns;
 
-			iu++;
-		}
+	for (int i = 0; i < n; i++) unknowns.push_back(valueReference(S, derivativeVRsParam, i));
+	for (size_t i = 0; i < nyv; i++) unknowns.push_back(valueReference(S, outputPortVariableVRsParam, i));
+
+	for (int i = 0; i < n; i++) knowns.push_back(valueReference(S, stateVRsParam, i));
+	for (size_t i = 0; i < nuv(S); i++) knowns.push_back(valueReference(S, inputPortVariableVRsParam, i));
+
+	// [rows; columns]
+	auto pattern = static_cast<real_T *>(mxGetData(ssGetSFcnParam(S, jacobianPatternParam)));
+
+	vector<size_t> rows, columns;
+
+	for (size_t k = 0; k < jacobianNnz(S); k++) {
+		rows.push_back(static_cast<size_t>(pattern[2 * k]));
+		columns.push_back(static_cast<size_t>(pattern[2 * k + 1]));
 	}
 
+	d->jacobian.reset(new SparseJacobian(n, unknowns, knowns, rows, columns, directionalDerivatives(S)));
 }
 
-static void setOutput(SimStruct *S, FMU *fmu) {
+static BlockDescriptor *createBlockDescriptor(SimStruct *S) {
+
+	auto d = new BlockDescriptor();
 
-	int iy = 0;
+	if (fmiVersion(S) == "1.0") {
+		d->type = runAsKind(S) == CO_SIMULATION ? FMU1_CO_SIMULATION : FMU1_MODEL_EXCHANGE;
+	} else {
+		d->type = runAsKind(S) == CO_SIMULATION ? FMU2_CO_SIMULATION : FMU2_MODEL_EXCHANGE;
+	}
+
+	d->fmu = nullptr;
+	d->initialState = -1;
+	d->nx = nx(S);
+	d->nz = nz(S);
+	d->logFMICalls = logFMICalls(S);
+	d->locateStateEvents = eventLocation(S);
+	d->eventLocationWork = 2 * d->nz + nuv(S);
+
+	if (d->locateStateEvents) {
+		d->xt.resize(d->nx);
+		d->dx1.resize(d->nx);
+		d->dx2.resize(d->nx);
+		d->zt.resize(d->nz);
+	}
+
+	d->inputPortDirectFeedThrough.resize(nu(S));
+
+	for (int i = 0; i < nu(S); i++) {
+		d->inputPortDirectFeedThrough[i] = inputPortDirectFeedThrough(S, i);
+	}
+
+	d->outputPortRead.resize(ny(S));
+	d->outputPortMajorStepOnly.resize(ny(S));
 
 	for (int i = 0; i < ny(S); i++) {
+		d->outputPortRead[i] = ssGetOutputPortConnected(S, i);
+		d->outputPortMajorStepOnly[i] = outputPortMajorStepOnly(S, i);
+	}
 
-		auto type = variableType(S, outputPortTypesParam, i);
+	createTransferPlan(S, d->inputs, nu(S), inputPortWidth, inputPortTypesParam, inputPortVariableVRsParam);
+	createTransferPlan(S, d->outputs, ny(S), outputPortWidth, outputPortTypesParam, outputPortVariableVRsParam);
 
-		void *y = ssGetOutputPortSignal(S, i);
+	d->inputChanges.reserve(nuv(S));
 
-		for (int j = 0; j < outputPortWidth(S, i); j++) {
+	if (blockJacobian(S)) {
+		createJacobian(S, d);
+	}
 
-			auto vr = valueReference(S, outputPortVariableVRsParam, iy);
+	if (profileFMICalls(S)) {
+		d->callStatistics.reset(new CallStatistics());
+	}
 
-			switch (type) {
-			case Type::REAL:
-				static_cast<real_T *>(y)[j] = fmu->getReal(vr);
-				break;
-			case Type::INTEGER:
-				static_cast<int32_T *>(y)[j] = fmu->getInteger(vr);
-				break;
-			case Type::BOOLEAN:
-				static_cast<boolean_T *>(y)[j] = fmu->getBoolean(vr);
-				break;
-			default:
-				break;
-			}
+	return d;
+}
 
-			iy++;
-		}
+// the FMU holds the start values so all inputs are set in the next call
+static void invalidateInputs(SimStruct *S) {
+	fill_n(ssGetRWork(S) + 2 * nz(S), nuv(S), numeric_limits<real_T>::quiet_NaN());
+}
+
+static void setInput(SimStruct *S, bool direct) {
+
+	auto d = descriptor(S);
+
+	// values that were set last (in the order of the input variables)
+	auto preu = ssGetRWork(S) + 2 * d->nz;
+
+	for (int i = 0; i < d->inputs.size(); i++) {
+
+		if (direct && !d->inputPortDirectFeedThrough[i]) continue;
+
+		d->inputChanges.add(d->inputs, i, ssGetInputPortSignal(S, i), preu + d->inputs.port(i).offset);
+	}
+
+	d->inputChanges.set(d->fmu);
+
+}
+
+static void setOutput(SimStruct *S, FMU *fmu) {
+
+	auto d = descriptor(S);
+
+	const bool majorTimeStep = ssIsMajorTimeStep(S);
+
+	for (int i = 0; i < d->outputs.size(); i++) {
+
+		if (!d->outputPortRead[i] || (d->outputPortMajorStepOnly[i] && !majorTimeStep)) continue;
+
+		d->outputs.get(fmu, i, ssGetOutputPortSignal(S, i));
 	}
 
 }
@@ -416,102 +612,357 @@ static void setStartValues(SimStruct *S, FMU *fmu) {
 	free(value);
 }
 
-static void update(SimStruct *S) {
+static bool timeEventDefined(FMU1Model *model) {
+	return model->upcomingTimeEvent();
+}
 
-	auto fmu = component<FMU>(S);
-	auto model = component<Model>(S);
+static bool timeEventDefined(FMU2Model *model) {
+	return model->nextEventTimeDefined();
+}
 
-	if (model) {
+// event iteration, returns true if the nominals of the continuous states changed in any iteration
+static bool newDiscreteStates(FMU2Model *model) {
 
-		double time = fmu->getTime();
-		bool upcomingTimeEvent;
-		double nextEventTime;
+	bool nominalsChanged = false;
 
-		auto model1 = component<FMU1Model>(S);
-		auto model2 = component<FMU2Model>(S);
+	do {
+		model->newDiscreteStates();
+		nominalsChanged |= model->nominalsOfContinuousStatesChanged();
+	} while (model->newDiscreteStatesNeeded() && !model->terminateSimulation());
 
-		if (model1) {
-			upcomingTimeEvent = model1->upcomingTimeEvent();
-		} else {
-			upcomingTimeEvent = model2->nextEventTimeDefined();
-		}
+	return nominalsChanged;
+}
+
+// handles an event, returns true if the nominals of the continuous states may have changed
+static bool handleEvent(FMU1Model *model) {
+	model->eventUpdate();
+	return model->stateValueReferencesChanged();
+}
+
+static bool handleEvent(FMU2Model *model) {
+
+	model->enterEventMode();
+
+	const bool nominalsChanged = newDiscreteStates(model);
+
+	model->enterContinuousTimeMode();
+
+	return nominalsChanged;
+}
+
+// scales the absolute tolerances of the solver with the nominal values of the continuous states
+template<typename M> static void setStateAbsTol(SimStruct *S, BlockDescriptor *d, M *model) {
+
+#if defined(MATLAB_MEX_FILE)
+	if (d->absTol.empty()) return;
+
+	model->getNominalContinuousStates(d->nominals.data(), d->nx);
 
-		nextEventTime = model->nextEventTime();
+	for (int i = 0; i < d->nx; i++) {
 
-		// Work around for the event handling in Dymola FMUs:
-		bool timeEvent = time >= nextEventTime;
+		auto nominal = fabs(d->nominals[i]);
 
-		if (timeEvent/* && logLevel(S) <= DEBUG*/) {
-			logDebug(S, "Time event at t=%.16g", time);
-			//ssPrintf("Time event at t=%.16g\n", time);
+		// ignore invalid nominal values
+		if (!(nominal > 0) || nominal == numeric_limits<double>::infinity()) nominal = 1;
+
+		ssSetStateAbsTol(S, i, d->absTol[i] * nominal);
+	}
+#endif
+}
+
+// true if any event indicator changed its sign from za to zb
+static bool stateEventOccurred(const real_T za[], const real_T zb[], int nz) {
+
+	for (int i = 0; i < nz; i++) {
+
+		bool rising  = (za[i] < 0 && zb[i] >= 0) || (za[i] == 0 && zb[i] > 0);
+		bool falling = (za[i] > 0 && zb[i] <= 0) || (za[i] == 0 && zb[i] < 0);
+
+		if (rising || falling) return true;
+	}
+
+	return false;
+}
+
+// cubic Hermite interpolation of the states in the last major step
+static void interpolateStates(double t0, double t1, double t, const real_T x0[], const real_T dx0[], const real_T x1[], const real_T dx1[], real_T x[], int nx) {
+
+	const double h = t1 - t0;
+	const double s = (t - t0) / h;
+
+	const double h00 = (1 + 2 * s) * (1 - s) * (1 - s);
+	const double h10 = s * (1 - s) * (1 - s);
+	const double h01 = s * s * (3 - 2 * s);
+	const double h11 = s * s * (s - 1);
+
+	for (int i = 0; i < nx; i++) {
+		x[i] = h00 * x0[i] + h10 * h * dx0[i] + h01 * x1[i] + h11 * h * dx1[i];
+	}
+}
+
+// remembers time, states and derivatives at the end of a major step for the event location
+template<typename M> static void rememberMajorStep(SimStruct *S, BlockDescriptor *d, M *model) {
+
+	auto w = ssGetRWork(S) + d->eventLocationWork;
+	auto x = ssGetContStates(S);
+
+	w[0] = ssGetT(S);
+
+	for (int i = 0; i < d->nx; i++) w[1 + i] = x[i];
+
+	model->getDerivatives(w + 1 + d->nx, d->nx);
+}
+
+/* Advances the states x of the model from t to t1 with Heun's method and an error estimate from the
+   embedded Euler step (relative tolerance of the block, absolute tolerances of the solver). A zero
+   crossing inside a substep is handled at the end of the substep without locating it. */
+template<typename M> static void advanceStates(SimStruct *S, BlockDescriptor *d, M *model, double t, double t1, real_T x[]) {
+
+	const int nx = d->nx;
+	const int nz = d->nz;
+
+	auto k1 = d->dx1.data();
+	auto k2 = d->dx2.data();
+	auto xn = d->xt.data();
+
+	real_T *za = ssGetRWork(S); // event indicators at t (the previous event indicators when done)
+	real_T *zb = d->zt.data();
+
+	const double rtol = relativeTolerance(S) > 0 ? relativeTolerance(S) : 1e-3;
+	const double hmin = 1e-12 * max(1.0, fabs(t1));
+
+	double h = t1 - t;
+
+	model->getEventIndicators(za, nz);
+
+	for (int iteration = 0; t1 - t > hmin; iteration++) {
+
+		// accept the remaining interval if the step size control does not converge
+		const bool force = iteration >= 100;
+
+		if (force || t + h > t1) h = t1 - t;
+
+		model->getDerivatives(k1, nx);
+
+		for (int i = 0; i < nx; i++) xn[i] = x[i] + h * k1[i];
+
+		model->setTime(t + h);
+		model->setContinuousStates(xn, nx);
+		model->getDerivatives(k2, nx);
+
+		double error = 0;
+
+		for (int i = 0; i < nx; i++) {
+			xn[i] = x[i] + h / 2 * (k1[i] + k2[i]);
+			const double atol = d->absTol.empty() ? rtol : d->absTol[i];
+			error = max(error, fabs(h / 2 * (k2[i] - k1[i])) / (atol + rtol * fabs(xn[i])));
 		}
 
-		bool stepEvent = model->completedIntegratorStep();
+		if (error > 1 && !force && h > hmin) {
+			// reject the step
+			h *= max(0.2, 0.9 / sqrt(error));
+			model->setTime(t);
+			model->setContinuousStates(x, nx);
+			continue;
+		}
+
+		t += h;
+		copy(xn, xn + nx, x);
+		model->setContinuousStates(x, nx);
+		model->getEventIndicators(zb, nz);
+
+		if (stateEventOccurred(za, zb, nz)) {
+
+			logDebug(S, "State event at t=%.16g (after the located event)", t);
+
+			if (handleEvent(model)) {
+				setStateAbsTol(S, d, model);
+			}
 
-		if (stepEvent/* && logLevel(S) <= DEBUG*/) {
-			logDebug(S, "Step event at t=%.16g\n", time);
-			//ssPrintf("Step event at t=%.16g\n", time);
+			model->getContinuousStates(x, nx);
+			model->getEventIndicators(zb, nz);
 		}
 
-		bool stateEvent = false;
+		copy(zb, zb + nz, za);
+
+		h *= min(5.0, 0.9 / sqrt(max(error, 1e-10)));
+	}
+}
+
+/* Locates the first zero crossing of the event indicators in the last major step with the Illinois
+   variant of regula falsi on the interpolated states and handles the event at the crossing. If the
+   event changed the states they are advanced to the current time with advanceStates() and the solver
+   is reset, otherwise the states of the solver are kept. The model is at (t1, x1) when called. */
+template<typename M> static void locateStateEvent(SimStruct *S, BlockDescriptor *d, M *model) {
+
+	const int nx = d->nx;
+	const int nz = d->nz;
 
-		if (nz(S) > 0) {
-			real_T *prez = ssGetRWork(S);
-			real_T *z = prez + nz(S);
+	auto w   = ssGetRWork(S) + d->eventLocationWork;
+	auto x0  = w + 1;
+	auto dx0 = x0 + nx;
+	auto x1  = ssGetContStates(S);
+	auto dx1 = d->dx1.data();
+	auto xt  = d->xt.data();
 
-			model->getEventIndicators(z, nz(S));
+	const double t0 = w[0];
+	const double t1 = ssGetT(S);
 
-			// check for state events
-			for (int i = 0; i < nz(S); i++) {
+	model->getDerivatives(dx1, nx);
 
-				bool rising  = (prez[i] < 0 && z[i] >= 0) || (prez[i] == 0 && z[i] > 0);
-				bool falling = (prez[i] > 0 && z[i] <= 0) || (prez[i] == 0 && z[i] < 0);
+	real_T *za = ssGetRWork(S);
+	real_T *zb = za + nz;
+	real_T *zc = d->zt.data();
 
-				if (rising || falling) {
-					logDebug(S, "State event %s z[%d] at t=%.16g\n", rising ? "-\\+" : "+/-", i, fmu->getTime());
-					stateEvent = true;
-					// TODO: break?
-				}
+	double ta = t0, tb = t1;
+	double wa = 1, wb = 1; // Illinois weights of the retained end points
+	int retained = 0;      // -1: a, 1: b
+
+	const double tolerance = 1e-12 * max(1.0, fabs(t1));
+
+	for (int iteration = 0; iteration < 100 && tb - ta > tolerance; iteration++) {
+
+		// earliest estimated crossing of the indicators that changed their sign
+		double tc = tb;
+
+		for (int i = 0; i < nz; i++) {
+			if (stateEventOccurred(&za[i], &zb[i], 1)) {
+				const double fa = wa * za[i], fb = wb * zb[i];
+				if (fb != fa) tc = min(tc, tb - fb * (tb - ta) / (fb - fa));
 			}
+		}
+
+		if (!(tc > ta && tc < tb)) tc = (ta + tb) / 2;
+
+		interpolateStates(t0, t1, tc, x0, dx0, x1, dx1, xt, nx);
+		model->setTime(tc);
+		model->setContinuousStates(xt, nx);
+		model->getEventIndicators(zc, nz);
 
-			// remember the current event indicators
-			for (int i = 0; i < nz(S); i++) prez[i] = z[i];
+		if (stateEventOccurred(za, zc, nz)) {
+			tb = tc;
+			swap(zb, zc);
+			wb = 1;
+			if (retained == -1) wa /= 2;
+			retained = -1;
+		} else {
+			ta = tc;
+			swap(za, zc);
+			wa = 1;
+			if (retained == 1) wb /= 2;
+			retained = 1;
 		}
+	}
+
+	logDebug(S, "State event located at t=%.16g", tb);
 
-		if (timeEvent || stepEvent || stateEvent) {
+	// handle the event at the crossing
+	interpolateStates(t0, t1, tb, x0, dx0, x1, dx1, xt, nx);
+	model->setTime(tb);
+	model->setContinuousStates(xt, nx);
 
-			if (model1) {
-				model1->eventUpdate();
-			} else {
-				model2->enterEventMode();
+	if (handleEvent(model)) {
+		setStateAbsTol(S, d, model);
+	}
 
-				do {
-					model2->newDiscreteStates();
-				} while (model2->newDiscreteStatesNeeded() && !model2->terminateSimulation());
+	auto xe = d->dx2.data();
 
-				model2->enterContinuousTimeMode();
-			}
+	model->getContinuousStates(xe, nx);
 
-			if (nx(S) > 0) {
-				auto x = ssGetContStates(S);
-				model->getContinuousStates(x, nx(S));
-			}
+	if (equal(xt, xt + nx, xe)) {
+		// the event did not change the states so the trajectory of the solver is kept
+		model->setTime(t1);
+		model->setContinuousStates(x1, nx);
+		model->getEventIndicators(ssGetRWork(S), nz);
+		return;
+	}
+
+	copy(xe, xe + nx, x1);
+
+	advanceStates(S, d, model, tb, t1, x1);
+
+	ssSetSolverNeedsReset(S);
+}
+
+template<typename M> static void update(SimStruct *S, BlockDescriptor *d, M *model) {
+
+	double time = model->getTime();
+	double nextEventTime = model->nextEventTime();
+
+	// Work around for the event handling in Dymola FMUs (with event location only announced time events are handled):
+	bool timeEvent = time >= nextEventTime && (!d->locateStateEvents || timeEventDefined(model));
+
+	if (timeEvent/* && logLevel(S) <= DEBUG*/) {
+		logDebug(S, "Time event at t=%.16g", time);
+		//ssPrintf("Time event at t=%.16g\n", time);
+	}
+
+	bool stepEvent = model->completedIntegratorStep();
 
-			if (nz(S) > 0) {
-				auto prez = ssGetRWork(S);
-				model->getEventIndicators(prez, nz(S));
+	if (stepEvent/* && logLevel(S) <= DEBUG*/) {
+		logDebug(S, "Step event at t=%.16g\n", time);
+		//ssPrintf("Step event at t=%.16g\n", time);
+	}
+
+	bool stateEvent = false;
+
+	if (d->nz > 0) {
+		real_T *prez = ssGetRWork(S);
+		real_T *z = prez + d->nz;
+
+		model->getEventIndicators(z, d->nz);
+
+		// check for state events
+		for (int i = 0; i < d->nz; i++) {
+
+			bool rising  = (prez[i] < 0 && z[i] >= 0) || (prez[i] == 0 && z[i] > 0);
+			bool falling = (prez[i] > 0 && z[i] <= 0) || (prez[i] == 0 && z[i] < 0);
+
+			if (rising || falling) {
+				logDebug(S, "State event %s z[%d] at t=%.16g\n", rising ? "-\\+" : "+/-", i, model->getTime());
+				stateEvent = true;
+				// TODO: break?
 			}
+		}
+
+		if (stateEvent && d->locateStateEvents && !timeEvent && !stepEvent) {
+			locateStateEvent(S, d, model);
+			rememberMajorStep(S, d, model);
+			return;
+		}
+
+		// remember the current event indicators
+		for (int i = 0; i < d->nz; i++) prez[i] = z[i];
+	}
+
+	if (timeEvent || stepEvent || stateEvent) {
+
+		if (handleEvent(model)) {
+			setStateAbsTol(S, d, model);
+		}
+
+		if (d->nx > 0) {
+			auto x = ssGetContStates(S);
+			model->getContinuousStates(x, d->nx);
+		}
 
-			ssSetSolverNeedsReset(S);
+		if (d->nz > 0) {
+			auto prez = ssGetRWork(S);
+			model->getEventIndicators(prez, d->nz);
 		}
+
+		ssSetSolverNeedsReset(S);
 	}
 
+	if (d->locateStateEvents) {
+		rememberMajorStep(S, d, model);
+	}
 }
 
 static void setErrorStatus(SimStruct *S, const char *message, ...) {
 	va_list args;
 	va_start(args, message);
-	static char msg[1024];
+	static thread_local char msg[1024]; // the message must outlive the call
 	vsnprintf(msg, 1024, message, args);
 	ssSetErrorStatus(S, msg);
 	va_end(args);
@@ -748,6 +1199,54 @@ static void mdlCheckParameters(SimStruct *S) {
 
 	// TODO: check VRS values!
 
+	if (!mxIsNumeric(ssGetSFcnParam(S, locateStateEventsParam)) || mxGetNumberOfElements(ssGetSFcnParam(S, locateStateEventsParam)) != 1) {
+		setErrorStatus(S, "Parameter %d (locate state events) must be a scalar", locateStateEventsParam + 1);
+		return;
+	}
+
+	if (!mxIsDouble(ssGetSFcnParam(S, outputPortMajorStepOnlyParam)) || mxGetNumberOfElements(ssGetSFcnParam(S, outputPortMajorStepOnlyParam)) != mxGetNumberOfElements(ssGetSFcnParam(S, outputPortWidthsParam))) {
+		setErrorStatus(S, "Parameter %d (output ports major step only) must be a double array with the same number of elements as parameter %d (output port widths)", outputPortMajorStepOnlyParam + 1, outputPortWidthsParam + 1);
+		return;
+	}
+
+	if (!mxIsDouble(ssGetSFcnParam(S, stateVRsParam)) || !mxIsDouble(ssGetSFcnParam(S, derivativeVRsParam))
+		|| mxGetNumberOfElements(ssGetSFcnParam(S, stateVRsParam)) != mxGetNumberOfElements(ssGetSFcnParam(S, derivativeVRsParam))) {
+		setErrorStatus(S, "Parameters %d (state value references) and %d (derivative value references) must be double arrays with the same number of elements", stateVRsParam + 1, derivativeVRsParam + 1);
+		return;
+	}
+
+	if (!mxIsDouble(ssGetSFcnParam(S, jacobianPatternParam)) || (mxGetNumberOfElements(ssGetSFcnParam(S, jacobianPatternParam)) > 0 && mxGetM(ssGetSFcnParam(S, jacobianPatternParam)) != 2)) {
+		setErrorStatus(S, "Parameter %d (Jacobian pattern) must be a double array with two rows (row and column indices)", jacobianPatternParam + 1);
+		return;
+	}
+
+	if (!mxIsNumeric(ssGetSFcnParam(S, directionalDerivativesParam)) || mxGetNumberOfElements(ssGetSFcnParam(S, directionalDerivativesParam)) != 1) {
+		setErrorStatus(S, "Parameter %d (directional derivatives) must be a scalar", directionalDerivativesParam + 1);
+		return;
+	}
+
+	if (!mxIsNumeric(ssGetSFcnParam(S, profileFMICallsParam)) || mxGetNumberOfElements(ssGetSFcnParam(S, profileFMICallsParam)) != 1) {
+		setErrorStatus(S, "Parameter %d (profile FMI calls) must be a scalar", profileFMICallsParam + 1);
+		return;
+	}
+
+	if (!mxIsNumeric(ssGetSFcnParam(S, canSerializeFMUstateParam)) || mxGetNumberOfElements(ssGetSFcnParam(S, canSerializeFMUstateParam)) != 1) {
+		setErrorStatus(S, "Parameter %d (can serialize FMU state) must be a scalar", canSerializeFMUstateParam + 1);
+		return;
+	}
+
+	if (jacobianNnz(S) > 0) {
+
+		auto pattern = static_cast<real_T *>(mxGetData(ssGetSFcnParam(S, jacobianPatternParam)));
+
+		for (size_t k = 0; k < jacobianNnz(S); k++) {
+			if (pattern[2 * k] < 0 || pattern[2 * k] >= nx(S) + ny || pattern[2 * k + 1] < 0 || pattern[2 * k + 1] >= nx(S) + nuv(S)) {
+				setErrorStatus(S, "The elements of parameter %d (Jacobian pattern) must be valid row and column indices of the block Jacobian", jacobianPatternParam + 1);
+				return;
+			}
+		}
+	}
+
 }
 #endif /* MDL_CHECK_PARAMETERS */
 
@@ -792,14 +1291,20 @@ static void mdlInitializeSizes(SimStruct *S) {
 	}
 
 	ssSetNumSampleTimes(S, 1);
-	ssSetNumRWork(S, 2 * nz(S) + nuv(S)); // prez & z, preu
+	ssSetNumRWork(S, 2 * nz(S) + nuv(S) + (eventLocation(S) ? 1 + 2 * nx(S) : 0)); // prez & z, preu, [pret, prex, predx]
 	ssSetNumIWork(S, 0);
-	ssSetNumPWork(S, 2); // [FMU, logfile]
+	ssSetNumPWork(S, 3); // [FMU, logfile, descriptor]
 	ssSetNumModes(S, 3); // [stateEvent, timeEvent, stepEvent]
 	ssSetNumNonsampledZCs(S, (runAsKind(S) == MODEL_EXCHANGE) ? nz(S) + 1 : 0);
 
-	// specify the sim state compliance to be same as a built-in block
-	//ssSetSimStateCompliance(S, USE_DEFAULT_SIM_STATE);
+#if defined(MATLAB_MEX_FILE)
+	if (blockJacobian(S)) {
+		ssSetJacobianNzMax(S, static_cast<int_T>(jacobianNnz(S)));
+	}
+#endif
+
+	// the sim state of FMI 2.0 FMUs is saved with fmi2SerializeFMUstate (if the FMU declares canGetAndSetFMUstate and canSerializeFMUstate)
+	ssSetSimStateCompliance(S, fmiVersion(S) == "2.0" && canSerializeFMUstate(S) ? USE_CUSTOM_SIM_STATE : DISALLOW_SIM_STATE);
 
 	ssSetOptions(S, 0);
 }
@@ -826,6 +1331,10 @@ static void mdlStart(SimStruct *S) {
 
     void **p = ssGetPWork(S);
 
+	// drains the buffered messages
+	delete static_cast<BlockDescriptor *>(p[2]);
+	p[2] = nullptr;
+
     if (p[1]) {
         fclose(static_cast<FILE *>(p[1]));
         p[1] = nullptr;
@@ -833,12 +1342,50 @@ static void mdlStart(SimStruct *S) {
 
     auto logfile = logFile(S);
 
-    if (!logfile.empty()) {
-        p[1] = fopen(logfile.c_str(), "w");
+	const bool traceFile = hasExtension(logfile, TRACE_FILE_EXTENSION);
+	const bool timelineFile = hasExtension(logfile, TIMELINE_FILE_EXTENSION);
+
+	// timeline files are opened by CallTimeline and shared by all blocks that write to them
+	if (!logfile.empty() && !timelineFile) {
+        p[1] = fopen(logfile.c_str(), traceFile ? "wb" : "w");
     }
 
+	auto d = createBlockDescriptor(S);
+
+	if (p[1]) {
+		d->logWriter.reset(new AsyncLogWriter(static_cast<FILE *>(p[1]), LOG_BUFFER_SIZE));
+		if (traceFile) d->callTrace.reset(new CallTrace(d->logWriter.get()));
+	}
+
+	p[2] = d;
+
+	if (timelineFile) {
+		try {
+			d->callTimeline.reset(new CallTimeline(logfile, ssGetPath(S)));
+		} catch (const exception &e) {
+			setErrorStatus(S, "%s", e.what());
+			return;
+		}
+	}
+
 	logDebug(S, "mdlStart() called on %s", ssGetPath(S));
 
+#if defined(MATLAB_MEX_FILE)
+	if (d->jacobian) {
+
+		auto ir = ssGetJacobianIr(S);
+		auto jc = ssGetJacobianJc(S);
+
+		const auto &rowIndices = d->jacobian->rowIndices();
+		const auto &columnStarts = d->jacobian->columnStarts();
+
+		for (size_t k = 0; k < rowIndices.size(); k++) ir[k] = static_cast<int_T>(rowIndices[k]);
+		for (size_t j = 0; j < columnStarts.size(); j++) jc[j] = static_cast<int_T>(columnStarts[j]);
+
+		logDebug(S, "Jacobian with %d non-zero elements in %d colors", static_cast<int>(d->jacobian->nnz()), static_cast<int>(d->jacobian->colors()));
+	}
+#endif
+
 	auto instanceName = ssGetPath(S);
 	auto time = ssGetT(S);
 
@@ -849,7 +1396,7 @@ static void mdlStart(SimStruct *S) {
 
 #ifdef _WIN32
 	if (!PathFileExists(libraryFile)) {
-		static char errorMessage[1024];
+		static thread_local char errorMessage[1024];
 		snprintf(errorMessage, 1024, "Cannot find the FMU's platform binary %s for %s.", libraryFile, instanceName);
 		ssSetErrorStatus(S, errorMessage);
 		return;
@@ -872,22 +1419,30 @@ static void mdlStart(SimStruct *S) {
 			auto slave = new FMU1Slave(guid(S), modelIdentifier(S), unzipDirectory(S), instanceName);
             slave->m_userData = S;
             slave->setLogLevel(logLevel(S));
-            if (logFMICalls(S)) slave->m_fmiCallLogger = logFMICall;
+            if (logFMICalls(S) && !d->callTrace) slave->m_fmiCallLogger = logFMICall;
+			slave->setCallTrace(d->callTrace.get());
+			slave->m_callStatistics = d->callStatistics.get();
+			slave->m_callTimeline = d->callTimeline.get();
             slave->instantiateSlave(unzipDirectory(S), 0, loggingOn);
 			setStartValues(S, slave);
 			slave->initializeSlave(time, true, ssGetTFinal(S));
 			p[0] = slave;
+			descriptor(S)->fmu = slave;
 		} else {
 			auto model = new FMU1Model(guid(S), modelIdentifier(S), unzipDirectory(S), instanceName);
             model->m_userData = S;
             model->setLogLevel(logLevel(S));
-            if (logFMICalls(S)) model->m_fmiCallLogger = logFMICall;
+            if (logFMICalls(S) && !d->callTrace) model->m_fmiCallLogger = logFMICall;
+			model->setCallTrace(d->callTrace.get());
+			model->m_callStatistics = d->callStatistics.get();
+			model->m_callTimeline = d->callTimeline.get();
             model->instantiateModel(loggingOn);
 			setStartValues(S, model);
 			model->setTime(time);
 			model->initialize(toleranceDefined, relativeTolerance(S));
 			if (model->terminateSimulation()) ssSetErrorStatus(S, "Model requested termination at init");
 			p[0] = model;
+			descriptor(S)->fmu = model;
 		}
 
 	} else {
@@ -902,7 +1457,10 @@ static void mdlStart(SimStruct *S) {
 
         fmu->m_userData = S;
         fmu->setLogLevel(logLevel(S));
-		if (logFMICalls(S)) fmu->m_fmiCallLogger = logFMICall;
+		if (logFMICalls(S) && !d->callTrace) fmu->m_fmiCallLogger = logFMICall;
+		fmu->setCallTrace(d->callTrace.get());
+		fmu->m_callStatistics = d->callStatistics.get();
+		fmu->m_callTimeline = d->callTimeline.get();
 
 		fmu->instantiate(loggingOn);
 		setStartValues(S, fmu);
@@ -913,87 +1471,157 @@ static void mdlStart(SimStruct *S) {
 		fmu->enterInitializationMode();
 		fmu->exitInitializationMode();
 
+		// remember the initialized state to restart without initialization (Fast Restart)
+		if (fmu->canGetAndSetFMUstate()) {
+			d->initialState = static_cast<int>(fmu->saveState());
+		}
+
 		p[0] = fmu;
+		descriptor(S)->fmu = fmu;
 	}
 
+	invalidateInputs(S);
+
+#if defined(MATLAB_MEX_FILE)
+	// remember the absolute tolerances of the variable step solver that are scaled with the nominal values
+	if (runAsKind(S) == MODEL_EXCHANGE && d->nx > 0 && ssIsVariableStepSolver(S) && ssGetAbsTol(S)) {
+		d->absTol.assign(ssGetAbsTol(S), ssGetAbsTol(S) + d->nx);
+		d->nominals.resize(d->nx);
+	}
+#endif
 }
 #endif /* MDL_START */
 
 
+template<typename M> static void initializeConditions(SimStruct *S, BlockDescriptor *d, M *model) {
+
+	// initialize the continuous states
+	auto x = ssGetContStates(S);
+
+	model->getContinuousStates(x, d->nx);
+
+	// initialize the event indicators
+	if (d->nz > 0) {
+		auto prez = ssGetRWork(S);
+		auto z = prez + d->nz;
+
+		model->getEventIndicators(prez, d->nz);
+		model->getEventIndicators(z, d->nz);
+	}
+
+	setStateAbsTol(S, d, model);
+
+	if (d->locateStateEvents) {
+		rememberMajorStep(S, d, model);
+	}
+}
+
 #define MDL_INITIALIZE_CONDITIONS
 #if defined(MDL_INITIALIZE_CONDITIONS)
 static void mdlInitializeConditions(SimStruct *S) {
 
 	logDebug(S, "mdlInitializeConditions() called on %s", ssGetPath(S));
 
-	auto model = component<Model>(S);
+	TimelineScope timelineScope(S, "mdlInitializeConditions");
 
-	if (model) {
+	auto d = descriptor(S);
 
-		// initialize the continuous states
-		auto x = ssGetContStates(S);
+	// restore the initialized state if the simulation is restarted (Fast Restart). mdlInitializeConditions()
+	// is also called during the simulation (e.g. when an enabled subsystem that resets its states is
+	// enabled again) where the continuous states and event indicators are only read again.
+	if (ssGetT(S) == ssGetTStart(S) && d->fmu->getTime() != ssGetT(S)) {
 
-		model->getContinuousStates(x, nx(S));
-		model->getContinuousStates(x, nx(S));
+		if (d->initialState < 0) {
+			setErrorStatus(S, "%s cannot be restarted (Fast Restart) because the FMU does not support fmi2GetFMUstate() and fmi2SetFMUstate() (canGetAndSetFMUstate).", ssGetPath(S));
+			return;
+		}
 
-		// initialize the event indicators
-		if (nz(S) > 0) {
-			auto prez = ssGetRWork(S);
-			auto z = prez + nz(S);
+		logDebug(S, "Restoring the initial state of %s", ssGetPath(S));
+		static_cast<FMU2 *>(d->fmu)->restoreState(d->initialState);
+		invalidateInputs(S);
 
-			model->getEventIndicators(prez, nz(S));
-			model->getEventIndicators(z, nz(S));
+		// fmi2SetFMUstate() does not change the mode so the event iteration at the start time
+		// is repeated in event mode (see enterContinuousTimeMode())
+		if (d->type == FMU2_MODEL_EXCHANGE) {
+			auto model = static_cast<FMU2Model *>(d->fmu);
+			if (model->getState() == ContinuousTimeModeState) model->enterEventMode();
 		}
 	}
+
+	switch (d->type) {
+	case FMU1_MODEL_EXCHANGE: initializeConditions(S, d, static_cast<FMU1Model *>(d->fmu)); break;
+	case FMU2_MODEL_EXCHANGE: initializeConditions(S, d, static_cast<FMU2Model *>(d->fmu)); break;
+	default: break;
+	}
 }
 #endif
 
 
-static void mdlOutputs(SimStruct *S, int_T tid) {
+static void enterContinuousTimeMode(SimStruct *, FMU1Model *) {
+	// nothing to do
+}
 
-	logDebug(S, "mdlOutputs() called on %s (t=%.16g, %s)", ssGetPath(S), ssGetT(S), ssIsMajorTimeStep(S) ? "major" : "minor");
+static void enterContinuousTimeMode(SimStruct *S, FMU2Model *model) {
 
-	auto fmu = component<FMU>(S);
+	if (model->getState() == EventModeState) {
 
-	auto model = component<Model>(S);
+		setInput(S, true);
 
-	if (model) {
+		const bool nominalsChanged = newDiscreteStates(model);
 
-		auto x = ssGetContStates(S);
-		auto model2 = component<FMU2Model>(S);
+		model->enterContinuousTimeMode();
 
-		if (model2 && model2->getState() == EventModeState) {
+		if (nominalsChanged) {
+			setStateAbsTol(S, descriptor(S), model);
+		}
+	}
 
-			setInput(S, true);
+	if (model->getState() != ContinuousTimeModeState) model->enterContinuousTimeMode();
+}
 
-			do {
-				model2->newDiscreteStates();
-			} while (model2->newDiscreteStatesNeeded() && !model2->terminateSimulation());
+template<typename M> static void modelOutputs(SimStruct *S, BlockDescriptor *d, M *model) {
 
-			model2->enterContinuousTimeMode();
-		}
+	auto x = ssGetContStates(S);
 
-		if (model2 && model2->getState() != ContinuousTimeModeState) model2->enterContinuousTimeMode();
+	enterContinuousTimeMode(S, model);
 
-		model->setTime(ssGetT(S));
-		model->setContinuousStates(x, nx(S));
+	model->setTime(ssGetT(S));
+	model->setContinuousStates(x, d->nx);
 
-		setInput(S, true);
+	setInput(S, true);
 
-		if (ssIsMajorTimeStep(S)) {
-			update(S);
-		}
+	if (ssIsMajorTimeStep(S)) {
+		update(S, d, model);
+	}
 
-	} else {
-		time_T h = ssGetT(S) - fmu->getTime();
-		auto slave = dynamic_cast<Slave *>(fmu);
+	setOutput(S, model);
+}
 
-		if (h > 0) {
-			slave->doStep(h);
-		}
+template<typename C> static void slaveOutputs(SimStruct *S, BlockDescriptor *d, C *slave) {
+
+	time_T h = ssGetT(S) - slave->getTime();
+
+	if (h > 0) {
+		slave->doStep(h);
 	}
 
-	setOutput(S, fmu);
+	setOutput(S, slave);
+}
+
+static void mdlOutputs(SimStruct *S, int_T tid) {
+
+	logDebug(S, "mdlOutputs() called on %s (t=%.16g, %s)", ssGetPath(S), ssGetT(S), ssIsMajorTimeStep(S) ? "major" : "minor");
+
+	TimelineScope timelineScope(S, "mdlOutputs");
+
+	auto d = descriptor(S);
+
+	switch (d->type) {
+	case FMU1_CO_SIMULATION:  slaveOutputs(S, d, static_cast<FMU1Slave *>(d->fmu)); break;
+	case FMU1_MODEL_EXCHANGE: modelOutputs(S, d, static_cast<FMU1Model *>(d->fmu)); break;
+	case FMU2_CO_SIMULATION:  slaveOutputs(S, d, static_cast<FMU2Slave *>(d->fmu)); break;
+	case FMU2_MODEL_EXCHANGE: modelOutputs(S, d, static_cast<FMU2Model *>(d->fmu)); break;
+	}
 }
 
 #define MDL_UPDATE
@@ -1002,62 +1630,276 @@ static void mdlUpdate(SimStruct *S, int_T tid) {
 
 	logDebug(S, "mdlUpdate() called on %s (t=%.16g, %s)", ssGetPath(S), ssGetT(S), ssIsMajorTimeStep(S) ? "major" : "minor");
 
+	TimelineScope timelineScope(S, "mdlUpdate");
+
 	setInput(S, false);
 }
 #endif // MDL_UPDATE
 
 
+template<typename M> static void zeroCrossings(SimStruct *S, BlockDescriptor *d, M *model) {
+
+	setInput(S, true);
+
+	auto z = ssGetNonsampledZCs(S);
+
+	if (d->nz > 0) {
+		model->getEventIndicators(z, d->nz);
+	}
+
+	z[d->nz] = model->nextEventTime() - ssGetT(S);
+}
+
 #define MDL_ZERO_CROSSINGS
 #if defined(MDL_ZERO_CROSSINGS) && (defined(MATLAB_MEX_FILE) || defined(NRT))
 static void mdlZeroCrossings(SimStruct *S) {
 
 	logDebug(S, "mdlZeroCrossings() called on %s (t=%.16g, %s)", ssGetPath(S), ssGetT(S), ssIsMajorTimeStep(S) ? "major" : "minor");
 
-	auto model = component<Model>(S);
-
-	if (model) {
-
-		setInput(S, true);
+	TimelineScope timelineScope(S, "mdlZeroCrossings");
 
-		auto z = ssGetNonsampledZCs(S);
+	auto d = descriptor(S);
 
-		if (nz(S) > 0) {
-			model->getEventIndicators(z, nz(S));
-		}
-
-		z[nz(S)] = model->nextEventTime() - ssGetT(S);
+	switch (d->type) {
+	case FMU1_MODEL_EXCHANGE: zeroCrossings(S, d, static_cast<FMU1Model *>(d->fmu)); break;
+	case FMU2_MODEL_EXCHANGE: zeroCrossings(S, d, static_cast<FMU2Model *>(d->fmu)); break;
+	default: break;
 	}
 }
 #endif
 
 
+template<typename M> static void derivatives(SimStruct *S, BlockDescriptor *d, M *model) {
+
+	setInput(S, true);
+
+	auto x = ssGetContStates(S);
+	auto dx = ssGetdX(S);
+
+	model->getContinuousStates(x, d->nx);
+	model->getDerivatives(dx, d->nx);
+}
+
 #define MDL_DERIVATIVES
 #if defined(MDL_DERIVATIVES)
 static void mdlDerivatives(SimStruct *S) {
 
 	logDebug(S, "mdlDerivatives() called on %s (t=%.16g, %s)", ssGetPath(S), ssGetT(S), ssIsMajorTimeStep(S) ? "major" : "minor");
 
-	auto model = component<Model>(S);
+	TimelineScope timelineScope(S, "mdlDerivatives");
 
-	if (model) {
+	auto d = descriptor(S);
 
-		setInput(S, true);
+	switch (d->type) {
+	case FMU1_MODEL_EXCHANGE: derivatives(S, d, static_cast<FMU1Model *>(d->fmu)); break;
+	case FMU2_MODEL_EXCHANGE: derivatives(S, d, static_cast<FMU2Model *>(d->fmu)); break;
+	default: break;
+	}
+}
+#endif
+
+
+#if defined(MATLAB_MEX_FILE)
+#define MDL_JACOBIAN
+#endif
+
+#if defined(MDL_JACOBIAN)
+static void mdlJacobian(SimStruct *S) {
+
+	logDebug(S, "mdlJacobian() called on %s (t=%.16g)", ssGetPath(S), ssGetT(S));
+
+	TimelineScope timelineScope(S, "mdlJacobian");
+
+	auto d = descriptor(S);
+
+	if (!d->jacobian) return;
+
+	auto model = static_cast<FMU2Model *>(d->fmu);
+	auto x = ssGetContStates(S);
 
-		auto x = ssGetContStates(S);
-		auto dx = ssGetdX(S);
+	enterContinuousTimeMode(S, model);
 
-		model->getContinuousStates(x, nx(S));
-		model->getDerivatives(dx, nx(S));
+	model->setTime(ssGetT(S));
+	model->setContinuousStates(x, d->nx);
+
+	setInput(S, false);
+
+	d->jacobian->evaluate(model, x, ssGetJacobianPr(S));
+}
+#endif /* MDL_JACOBIAN */
+
+
+#define MDL_SIM_STATE
+#if defined(MDL_SIM_STATE)
+static const char *simStateFields[] = { "fmuState", "rwork", "x" };
+
+// FMI 2.0 only (see mdlInitializeSizes)
+static FMU2 *serializableFMU(SimStruct *S) {
+
+	auto fmu = static_cast<FMU2 *>(descriptor(S)->fmu);
+
+	if (!fmu->canSerializeFMUstate()) {
+		setErrorStatus(S, "The FMU in %s does not support the serialization of its state which is required to save and restore the simulation state.", ssGetPath(S));
+		return nullptr;
 	}
+
+	return fmu;
 }
-#endif
 
+static mxArray *mdlGetSimState(SimStruct *S) {
+
+	logDebug(S, "mdlGetSimState() called on %s (t=%.16g)", ssGetPath(S), ssGetT(S));
+
+	TimelineScope timelineScope(S, "mdlGetSimState");
+
+	auto d = descriptor(S);
+	auto fmu = serializableFMU(S);
+
+	if (!fmu) return nullptr;
+
+	const auto slot = fmu->saveState();
+	fmu->serializeState(slot, d->serializedState);
+	fmu->releaseState(slot);
+
+	auto simState = mxCreateStructMatrix(1, 1, 3, simStateFields);
+
+	auto fmuState = mxCreateNumericMatrix(d->serializedState.size(), 1, mxUINT8_CLASS, mxREAL);
+	memcpy(mxGetData(fmuState), d->serializedState.data(), d->serializedState.size());
+	mxSetField(simState, 0, "fmuState", fmuState);
+
+	auto rwork = mxCreateDoubleMatrix(ssGetNumRWork(S), 1, mxREAL);
+	copy_n(ssGetRWork(S), ssGetNumRWork(S), mxGetPr(rwork));
+	mxSetField(simState, 0, "rwork", rwork);
+
+	auto x = mxCreateDoubleMatrix(d->nx, 1, mxREAL);
+	copy_n(ssGetContStates(S), d->nx, mxGetPr(x));
+	mxSetField(simState, 0, "x", x);
+
+	return simState;
+}
+
+static void mdlSetSimState(SimStruct *S, const mxArray *simState) {
+
+	logDebug(S, "mdlSetSimState() called on %s (t=%.16g)", ssGetPath(S), ssGetT(S));
+
+	TimelineScope timelineScope(S, "mdlSetSimState");
+
+	auto d = descriptor(S);
+	auto fmu = serializableFMU(S);
+
+	if (!fmu) return;
+
+	auto fmuState = mxGetField(simState, 0, "fmuState");
+	auto rwork = mxGetField(simState, 0, "rwork");
+	auto x = mxGetField(simState, 0, "x");
+
+	if (!fmuState || !rwork || !x || mxGetNumberOfElements(rwork) != ssGetNumRWork(S) || mxGetNumberOfElements(x) != d->nx) {
+		setErrorStatus(S, "The simulation state of %s does not match the block.", ssGetPath(S));
+		return;
+	}
+
+	const auto slot = fmu->deserializeState(static_cast<const char *>(mxGetData(fmuState)), mxGetNumberOfElements(fmuState));
+	fmu->restoreState(slot);
+	fmu->releaseState(slot);
+
+	// the inputs cached in RWork (preu) are part of the restored FMU state
+	copy_n(mxGetPr(rwork), ssGetNumRWork(S), ssGetRWork(S));
+	copy_n(mxGetPr(x), d->nx, ssGetContStates(S));
+
+	if (d->type == FMU2_MODEL_EXCHANGE) {
+		setStateAbsTol(S, d, static_cast<FMU2Model *>(d->fmu));
+	}
+}
+#endif /* MDL_SIM_STATE */
+
+
+// write the FMI call statistics to the log and pass them to FMIKit.getCallStatistics()
+static void reportCallStatistics(SimStruct *S, const BlockDescriptor *d) {
+
+	const auto fmiVersion = d->type == FMU1_CO_SIMULATION || d->type == FMU1_MODEL_EXCHANGE ? FMI_VERSION_1 : FMI_VERSION_2;
+	const auto &statistics = *d->callStatistics;
+
+	const string message = string("FMI call statistics of ") + ssGetPath(S) + ":\n" + statistics.format(fmiVersion);
+
+	if (d->callTrace) {
+		d->callTrace->message(ssGetT(S), message.c_str());
+	} else if (d->logWriter) {
+		d->logWriter->write(message.c_str());
+	} else {
+		ssPrintf("%s", message.c_str());
+	}
+
+#if defined(MATLAB_MEX_FILE)
+	vector<TraceFunction> functions;
+
+	for (int i = 0; i < NUM_TRACE_FUNCTIONS; i++) {
+		if (statistics.entry(static_cast<TraceFunction>(i)).count > 0) functions.push_back(static_cast<TraceFunction>(i));
+	}
+
+	const char *fieldNames[] = { "function", "calls", "totalTime", "maxTime", "histogram" };
+
+	auto s = mxCreateStructMatrix(functions.size(), 1, 5, fieldNames);
+
+	for (size_t k = 0; k < functions.size(); k++) {
+
+		const auto &entry = statistics.entry(functions[k]);
+
+		auto histogram = mxCreateDoubleMatrix(1, CallStatistics::NUM_BUCKETS, mxREAL);
+		auto h = mxGetPr(histogram);
+
+		for (int i = 0; i < CallStatistics::NUM_BUCKETS; i++) h[i] = static_cast<double>(entry.histogram[i]);
+
+		mxSetField(s, k, "function",  mxCreateString(traceFunctionName(functions[k], fmiVersion)));
+		mxSetField(s, k, "calls",     mxCreateDoubleScalar(static_cast<double>(entry.count)));
+		mxSetField(s, k, "totalTime", mxCreateDoubleScalar(entry.totalTime * 1e-9));
+		mxSetField(s, k, "maxTime",   mxCreateDoubleScalar(entry.maxTime * 1e-9));
+		mxSetField(s, k, "histogram", histogram);
+	}
+
+	mxArray *args[] = { mxCreateString(ssGetPath(S)), s };
+
+	// ignore errors (e.g. if FMIKit is not on the path)
+	if (auto exception = mexCallMATLABWithTrap(0, nullptr, 2, args, "FMIKit.getCallStatistics")) {
+		mxDestroyArray(exception);
+	}
+
+	mxDestroyArray(args[0]);
+	mxDestroyArray(args[1]);
+#endif
+}
 
 static void mdlTerminate(SimStruct *S) {
 
 	logDebug(S, "mdlTerminate() called on %s", ssGetPath(S));
 
-	delete component<FMU>(S);
+	if (auto d = descriptor(S)) {
+		logDebug(S, "%zu input values were set, %zu were skipped because they did not change", d->inputChanges.transferred(), d->inputChanges.skipped());
+	}
+
+	delete static_cast<FMU *>(ssGetPWork(S)[0]);
+
+	auto d = descriptor(S);
+
+	// after the FMU has been freed to include fmiTerminate() and fmiFreeInstance()
+	if (d && d->callStatistics) {
+		reportCallStatistics(S, d);
+	}
+
+	if (d && d->logWriter) {
+
+		d->logWriter->flush();
+
+		if (d->logWriter->dropped() > 0) {
+			ssPrintf("%s: %u messages were dropped from the log file because the log buffer was full.\n", ssGetPath(S), static_cast<unsigned int>(d->logWriter->dropped()));
+		}
+	}
+
+	if (d && d->callTimeline && d->callTimeline->dropped() > 0) {
+		ssPrintf("%s: %u events were dropped from the timeline because the buffer was full.\n", ssGetPath(S), static_cast<unsigned int>(d->callTimeline->dropped()));
+	}
+
+	delete d;
+	ssGetPWork(S)[2] = nullptr;
 }
 
 /*=============================*
@@ -0,0 +1,139 @@
+/*****************************************************************
+ *  Copyright (c) Dassault Systemes. All rights reserved.        *
+ *  This file is part of FMIKit. See LICENSE.txt in the project  *
+ *  root for license information.                                *
+ *****************************************************************/
+
+#include <string.h>
+#include <chrono>
+
+#include "AsyncLogWriter.h"
+
+using namespace std;
+
+namespace fmikit {
+
+	// maximum time the writer thread sleeps before it checks the buffer
+	static const chrono::milliseconds WRITE_INTERVAL(20);
+
+	AsyncLogWriter::AsyncLogWriter(FILE *file, size_t capacity) :
+		m_file(file),
+		m_buffer(capacity),
+		m_head(0),
+		m_tail(0),
+		m_dropped(0),
+		m_stop(false) {
+
+		m_thread = thread(&AsyncLogWriter::run, this);
+	}
+
+	AsyncLogWriter::~AsyncLogWriter() {
+
+		m_stop.store(true);
+		m_wakeUp.notify_one();
+		m_thread.join();
+
+		// write the remaining messages
+		drain();
+		fflush(m_file);
+	}
+
+	bool AsyncLogWriter::write(const char *message) {
+		return append(message, strlen(message), true);
+	}
+
+	bool AsyncLogWriter::write(const void *data, size_t size) {
+		return append(static_cast<const char *>(data), size, false);
+	}
+
+	bool AsyncLogWriter::append(const char *data, size_t size, bool lineBreak) {
+
+		const size_t length = size + (lineBreak ? 1 : 0);
+		const size_t capacity = m_buffer.size();
+
+		lock_guard<mutex> writeLock(m_writeMutex);
+
+		const size_t head = m_head.load(memory_order_relaxed);
+		const size_t tail = m_tail.load(memory_order_acquire);
+
+		if (capacity - (head - tail) < length) {
+			m_dropped.fetch_add(1, memory_order_relaxed);
+			return false;
+		}
+
+		// copy the data (may wrap around the end of the buffer)
+		const size_t start = head % capacity;
+		const size_t n1 = min(size, capacity - start);
+
+		memcpy(&m_buffer[start], data, n1);
+		memcpy(&m_buffer[0], data + n1, size - n1);
+
+		if (lineBreak) {
+			m_buffer[(head + size) % capacity] = '\n';
+		}
+
+		m_head.store(head + length, memory_order_release);
+
+		// wake up the writer early if the buffer is more than half full
+		if (2 * (head + length - tail) > capacity) {
+			m_wakeUp.notify_one();
+		}
+
+		return true;
+	}
+
+	void AsyncLogWriter::flush() {
+
+		const size_t head = m_head.load(memory_order_acquire);
+
+		{
+			unique_lock<mutex> lock(m_mutex);
+			m_wakeUp.notify_one();
+			m_drained.wait(lock, [this, head] { return m_tail.load(memory_order_acquire) >= head; });
+		}
+
+		fflush(m_file);
+	}
+
+	void AsyncLogWriter::run() {
+
+		while (!m_stop.load()) {
+
+			drain();
+
+			unique_lock<mutex> lock(m_mutex);
+			m_wakeUp.wait_for(lock, WRITE_INTERVAL);
+		}
+	}
+
+	void AsyncLogWriter::drain() {
+
+		const size_t capacity = m_buffer.size();
+
+		const size_t tail = m_tail.load(memory_order_relaxed);
+		const size_t head = m_head.load(memory_order_acquire);
+
+		if (head == tail) return; // nothing to do
+
+		// write the pending bytes in (at most) two blocks
+		const size_t start = tail % capacity;
+		const size_t n = head - tail;
+		const size_t n1 = min(n, capacity - start);
+
+		fwrite(&m_buffer[start], 1, n1, m_file);
+
+		if (n > n1) {
+			fwrite(&m_buffer[0], 1, n - n1, m_file);
+		}
+
+		m_tail.store(head, memory_order_release);
+
+		// the waiting thread checks m_tail under the mutex, so the notification can't get lost
+		{
+			lock_guard<mutex> lock(m_mutex);
+		}
+
+		m_drained.notify_all();
+	}
+
+}
@@ -0,0 +1,71 @@
+/*****************************************************************
+ *  Copyright (c) Dassault Systemes. All rights reserved.        *
+ *  This file is part of FMIKit. See LICENSE.txt in the project  *
+ *  root for license information.                                *
+ *****************************************************************/
+
+#include <stdio.h>
+#include <algorithm> // min
+
+#include "CallStatistics.h"
+
+using namespace std;
+
+namespace fmikit {
+
+	void CallStatistics::reset() {
+		for (auto &entry : m_entries) entry = Entry();
+	}
+
+	uint64_t CallStatistics::percentile(TraceFunction function, double fraction) const {
+
+		const auto &entry = m_entries[function];
+
+		if (entry.count == 0) return 0;
+
+		const double n = fraction * entry.count;
+
+		uint64_t calls = 0;
+
+		for (int i = 0; i < NUM_BUCKETS; i++) {
+			calls += entry.histogram[i];
+			if (calls >= n) {
+				// upper bound of the bucket (but not above the maximum)
+				return min(entry.maxTime, (uint64_t(1) << (i + 1)) - 1);
+			}
+		}
+
+		return entry.maxTime;
+	}
+
+	string CallStatistics::format(FMIVersion fmiVersion) const {
+
+		string text;
+		char line[256];
+
+		snprintf(line, sizeof(line), "%-36s %12s %12s %12s %12s %12s %12s\n", "function", "calls", "total [ms]", "mean [us]", "p50 [us]", "p99 [us]", "max [us]");
+		text += line;
+
+		for (int i = 0; i < NUM_TRACE_FUNCTIONS; i++) {
+
+			const auto function = static_cast<TraceFunction>(i);
+			const auto &entry = m_entries[i];
+
+			if (entry.count == 0) continue;
+
+			snprintf(line, sizeof(line), "%-36s %12llu %12.3f %12.3f %12.3f %12.3f %12.3f\n",
+				traceFunctionName(function, fmiVersion),
+				static_cast<unsigned long long>(entry.count),
+				entry.totalTime * 1e-6,
+				entry.totalTime * 1e-3 / entry.count,
+				percentile(function, 0.5) * 1e-3,
+				percentile(function, 0.99) * 1e-3,
+				entry.maxTime * 1e-3);
+
+			text += line;
+		}
+
+		return text;
+	}
+
+}
@@ -0,0 +1,187 @@
+/*****************************************************************
+ *  Copyright (c) Dassault Systemes. All rights reserved.        *
+ *  This file is part of FMIKit. See LICENSE.txt in the project  *
+ *  root for license information.                                *
+ *****************************************************************/
+
+#include <stdio.h>
+#include <mutex>
+#include <stdexcept> // for runtime_error
+#include <unordered_map>
+
+#include "AsyncLogWriter.h"
+#include "CallStatistics.h"
+#include "CallTimeline.h"
+
+using namespace std;
+
+#define TIMELINE_BUFFER_SIZE (16 * 1024 * 1024) // memory budget for buffered events of one file
+
+namespace fmikit {
+
+	// appends value as a JSON string (with quotes)
+	static void appendJSONString(string &json, const char *value) {
+
+		json += '"';
+
+		for (const char *c = value; *c; c++) {
+			switch (*c) {
+			case '"':  json += "\\\""; break;
+			case '\\': json += "\\\\"; break;
+			case '\n': json += "\\n"; break;
+			case '\r': json += "\\r"; break;
+			case '\t': json += "\\t"; break;
+			default:
+				if (static_cast<unsigned char>(*c) < 0x20) {
+					char buf[8];
+					snprintf(buf, sizeof(buf), "\\u%04x", *c);
+					json += buf;
+				} else {
+					json += *c;
+				}
+			}
+		}
+
+		json += '"';
+	}
+
+	/* A timeline file that is opened once per process and shared by all tracks that write to it.
+	   The events are serialized by a mutex, so the tracks can be written from different threads. */
+	class TimelineFile {
+
+	public:
+		static shared_ptr<TimelineFile> open(const string &filename);
+
+		~TimelineFile() {
+			m_writer->write("\n]\n", 3);
+			m_writer.reset(); // drains the buffer
+			fclose(m_file);
+		}
+
+		int addTrack(const string &name) {
+
+			lock_guard<mutex> lock(m_mutex);
+
+			const int track = ++m_tracks;
+
+			begin();
+			m_event += "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " + to_string(track) + ", \"args\": {\"name\": ";
+			appendJSONString(m_event, name.c_str());
+			m_event += "}}";
+
+			m_writer->write(m_event.data(), m_event.size());
+
+			return track;
+		}
+
+		void complete(int track, const char *name, uint64_t start, uint64_t end, double time) {
+
+			char buf[128];
+
+			lock_guard<mutex> lock(m_mutex);
+
+			begin();
+			m_event += "{\"name\": \"";
+			m_event += name; // function names need no escaping
+			snprintf(buf, sizeof(buf), "\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f, \"args\": {\"t\": %.17g}}",
+				track, timestamp(start), (end - start) * 1e-3, time);
+			m_event += buf;
+
+			m_writer->write(m_event.data(), m_event.size());
+		}
+
+		void instant(int track, const char *message, double time) {
+
+			char buf[128];
+
+			lock_guard<mutex> lock(m_mutex);
+
+			begin();
+			m_event += "{\"name\": ";
+			appendJSONString(m_event, message);
+			snprintf(buf, sizeof(buf), ", \"ph\": \"i\", \"s\": \"t\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"args\": {\"t\": %.17g}}",
+				track, timestamp(CallStatistics::now()), time);
+			m_event += buf;
+
+			m_writer->write(m_event.data(), m_event.size());
+		}
+
+		size_t dropped() const { return m_writer->dropped(); }
+
+	private:
+		FILE *m_file;
+		unique_ptr<AsyncLogWriter> m_writer;
+		uint64_t m_start;
+
+		mutex m_mutex;
+		int m_tracks = 0;
+		bool m_empty = true;
+		string m_event;
+
+		TimelineFile(FILE *file) :
+			m_file(file),
+			m_writer(new AsyncLogWriter(file, TIMELINE_BUFFER_SIZE)),
+			m_start(CallStatistics::now()) {
+			m_writer->write("[", 1);
+		}
+
+		// microseconds since the file was opened
+		double timestamp(uint64_t t) const {
+			return t > m_start ? (t - m_start) * 1e-3 : 0.0;
+		}
+
+		// starts the next element of the array in m_event
+		void begin() {
+			m_event = m_empty ? "\n" : ",\n";
+			m_empty = false;
+		}
+
+	};
+
+	static mutex s_filesMutex;
+	static unordered_map<string, weak_ptr<TimelineFile>> s_files;
+
+	shared_ptr<TimelineFile> TimelineFile::open(const string &filename) {
+
+		lock_guard<mutex> lock(s_filesMutex);
+
+		auto file = s_files[filename].lock();
+
+		if (!file) {
+
+			FILE *f = fopen(filename.c_str(), "w");
+
+			if (!f) {
+				throw runtime_error("Failed to open " + filename);
+			}
+
+			file.reset(new TimelineFile(f));
+			s_files[filename] = file;
+		}
+
+		return file;
+	}
+
+	CallTimeline::CallTimeline(const string &filename, const string &trackName) :
+		m_file(TimelineFile::open(filename)),
+		m_track(m_file->addTrack(trackName)) {
+	}
+
+	CallTimeline::~CallTimeline() {
+		lock_guard<mutex> lock(s_filesMutex); // the last track closes the file
+		m_file.reset();
+	}
+
+	void CallTimeline::complete(const char *name, uint64_t start, uint64_t end, double time) {
+		m_file->complete(m_track, name, start, end, time);
+	}
+
+	void CallTimeline::instant(const char *message, double time) {
+		m_file->instant(m_track, message, time);
+	}
+
+	size_t CallTimeline::dropped() const {
+		return m_file->dropped();
+	}
+
+}
@@ -0,0 +1,317 @@
+/*****************************************************************
+ *  Copyright (c) Dassault Systemes. All rights reserved.        *
+ *  This file is part of FMIKit. See LICENSE.txt in the project  *
+ *  root for license information.                                *
+ *****************************************************************/
+
+#include <string.h>
+#include <stdexcept> // for runtime_error
+
+#include "AsyncLogWriter.h"
+#include "CallTrace.h"
+
+using namespace std;
+
+namespace fmikit {
+
+	static const char TRACE_MAGIC[8] = { 'F', 'M', 'I', 'T', 'R', 'A', 'C', 'E' };
+	static const uint32_t TRACE_VERSION = 1;
+
+	// size of uint16 function, int16 status, uint32 size, uint64 wallTime, float64 time
+	static const size_t RECORD_HEADER_SIZE = 24;
+
+	const char *traceFunctionName(TraceFunction function, FMIVersion fmiVersion) {
+
+		const bool fmi1 = fmiVersion == FMI_VERSION_1;
+
+		switch (function) {
+		case TRACE_MESSAGE:                           return "message";
+		case TRACE_INSTANTIATE:                       return fmi1 ? "fmiInstantiate"        : "fmi2Instantiate";
+		case TRACE_SETUP_EXPERIMENT:                  return "fmi2SetupExperiment";
+		case TRACE_ENTER_INITIALIZATION_MODE:         return "fmi2EnterInitializationMode";
+		case TRACE_EXIT_INITIALIZATION_MODE:          return "fmi2ExitInitializationMode";
+		case TRACE_INITIALIZE:                        return "fmiInitialize";
+		case TRACE_TERMINATE:                         return fmi1 ? "fmiTerminate"          : "fmi2Terminate";
+		case TRACE_FREE_INSTANCE:                     return fmi1 ? "fmiFreeInstance"       : "fmi2FreeInstance";
+		case TRACE_GET_REAL:                          return fmi1 ? "fmiGetReal"            : "fmi2GetReal";
+		case TRACE_GET_INTEGER:                       return fmi1 ? "fmiGetInteger"         : "fmi2GetInteger";
+		case TRACE_GET_BOOLEAN:                       return fmi1 ? "fmiGetBoolean"         : "fmi2GetBoolean";
+		case TRACE_GET_STRING:                        return fmi1 ? "fmiGetString"          : "fmi2GetString";
+		case TRACE_SET_REAL:                          return fmi1 ? "fmiSetReal"            : "fmi2SetReal";
+		case TRACE_SET_INTEGER:                       return fmi1 ? "fmiSetInteger"         : "fmi2SetInteger";
+		case TRACE_SET_BOOLEAN:                       return fmi1 ? "fmiSetBoolean"         : "fmi2SetBoolean";
+		case TRACE_SET_STRING:                        return fmi1 ? "fmiSetString"          : "fmi2SetString";
+		case TRACE_SET_REAL_INPUT_DERIVATIVES:        return fmi1 ? "fmiSetRealInputDerivatives" : "fmi2SetRealInputDerivatives";
+		case TRACE_DO_STEP:                           return fmi1 ? "fmiDoStep"             : "fmi2DoStep";
+		case TRACE_GET_BOOLEAN_STATUS:                return fmi1 ? "fmiGetBooleanStatus"   : "fmi2GetBooleanStatus";
+		case TRACE_SET_TIME:                          return fmi1 ? "fmiSetTime"            : "fmi2SetTime";
+		case TRACE_SET_CONTINUOUS_STATES:             return fmi1 ? "fmiSetContinuousStates" : "fmi2SetContinuousStates";
+		case TRACE_GET_CONTINUOUS_STATES:             return fmi1 ? "fmiGetContinuousStates" : "fmi2GetContinuousStates";
+		case TRACE_GET_NOMINALS_OF_CONTINUOUS_STATES: return fmi1 ? "fmiGetNominalContinuousStates" : "fmi2GetNominalsOfContinuousStates";
+		case TRACE_GET_DERIVATIVES:                   return fmi1 ? "fmiGetDerivatives"     : "fmi2GetDerivatives";
+		case TRACE_GET_EVENT_INDICATORS:              return fmi1 ? "fmiGetEventIndicators" : "fmi2GetEventIndicators";
+		case TRACE_COMPLETED_INTEGRATOR_STEP:         return fmi1 ? "fmiCompletedIntegratorStep" : "fmi2CompletedIntegratorStep";
+		case TRACE_ENTER_EVENT_MODE:                  return "fmi2EnterEventMode";
+		case TRACE_NEW_DISCRETE_STATES:               return "fmi2NewDiscreteStates";
+		case TRACE_ENTER_CONTINUOUS_TIME_MODE:        return "fmi2EnterContinuousTimeMode";
+		case TRACE_EVENT_UPDATE:                      return "fmiEventUpdate";
+		case TRACE_GET_DIRECTIONAL_DERIVATIVE:        return "fmi2GetDirectionalDerivative";
+		case TRACE_GET_FMU_STATE:                     return "fmi2GetFMUstate";
+		case TRACE_SET_FMU_STATE:                     return "fmi2SetFMUstate";
+		default:                                      return "unknown";
+		}
+	}
+
+	CallTrace::CallTrace(AsyncLogWriter *writer) :
+		m_writer(writer),
+		m_start(chrono::steady_clock::now()) {
+	}
+
+	void CallTrace::writeHeader(const FMU *fmu) {
+
+		m_buffer.clear();
+		m_buffer.insert(m_buffer.end(), TRACE_MAGIC, TRACE_MAGIC + sizeof(TRACE_MAGIC));
+
+		append<uint32_t>(TRACE_VERSION);
+		append<uint32_t>(fmu->fmiVersion());
+		append<uint32_t>(fmu->kind());
+
+		appendString(fmu->guid().c_str());
+		appendString(fmu->modelIdentifier().c_str());
+		appendString(fmu->unzipDirectory().c_str());
+		appendString(fmu->instanceName().c_str());
+
+		m_writer->write(m_buffer.data(), m_buffer.size());
+	}
+
+	void CallTrace::appendString(const char *value) {
+		const uint32_t length = static_cast<uint32_t>(strlen(value));
+		append(length);
+		m_buffer.insert(m_buffer.end(), value, value + length);
+	}
+
+	void CallTrace::begin(int status, double time, TraceFunction function, const ValueReference vr[], size_t nvr, Type type, size_t nvalues) {
+
+		const uint64_t wallTime = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - m_start).count();
+
+		m_buffer.clear();
+
+		append<uint16_t>(static_cast<uint16_t>(function));
+		append<int16_t>(static_cast<int16_t>(status));
+		append<uint32_t>(0); // payload size (set in end())
+		append(wallTime);
+		append(time);
+
+		append<uint32_t>(static_cast<uint32_t>(nvr));
+		const char *p = reinterpret_cast<const char *>(vr);
+		m_buffer.insert(m_buffer.end(), p, p + nvr * sizeof(ValueReference));
+
+		append<uint32_t>(type);
+		append<uint32_t>(static_cast<uint32_t>(nvalues));
+	}
+
+	void CallTrace::end() {
+		const uint32_t size = static_cast<uint32_t>(m_buffer.size() - RECORD_HEADER_SIZE);
+		memcpy(&m_buffer[4], &size, sizeof(size));
+		m_writer->write(m_buffer.data(), m_buffer.size());
+	}
+
+	void CallTrace::message(double time, const char *message) {
+		begin(0, time, TRACE_MESSAGE, nullptr, 0, STRING, 1);
+		appendString(message);
+		end();
+	}
+
+	void CallTrace::record(int status, double time, TraceFunction function) {
+		begin(status, time, function, nullptr, 0, REAL, 0);
+		end();
+	}
+
+	void CallTrace::record(int status, double time, TraceFunction function, initializer_list<double> args) {
+		record(status, time, function, nullptr, 0, args);
+	}
+
+	void CallTrace::record(int status, double time, TraceFunction function, const ValueReference vr[], size_t nvr, initializer_list<double> args) {
+		begin(status, time, function, vr, nvr, REAL, args.size());
+		for (double value : args) append(value);
+		end();
+	}
+
+	void CallTrace::record(int status, double time, TraceFunction function, const double values[], size_t nvalues) {
+		begin(status, time, function, nullptr, 0, REAL, nvalues);
+		const char *p = reinterpret_cast<const char *>(values);
+		m_buffer.insert(m_buffer.end(), p, p + nvalues * sizeof(double));
+		end();
+	}
+
+	void CallTrace::record(int status, double time, TraceFunction function, const ValueReference vr[], size_t nvr, const double values[]) {
+		begin(status, time, function, vr, nvr, REAL, nvr);
+		const char *p = reinterpret_cast<const char *>(values);
+		m_buffer.insert(m_buffer.end(), p, p + nvr * sizeof(double));
+		end();
+	}
+
+	void CallTrace::record(int status, double time, TraceFunction function, const ValueReference vr[], size_t nvr, const int values[]) {
+		begin(status, time, function, vr, nvr, INTEGER, nvr);
+		for (size_t i = 0; i < nvr; i++) append<int32_t>(values[i]);
+		end();
+	}
+
+	void CallTrace::record(int status, double time, TraceFunction function, const ValueReference vr[], size_t nvr, const bool values[]) {
+		begin(status, time, function, vr, nvr, BOOLEAN, nvr);
+		for (size_t i = 0; i < nvr; i++) append<uint8_t>(values[i] ? 1 : 0);
+		end();
+	}
+
+	void CallTrace::record(int status, double time, TraceFunction function, const ValueReference vr[], size_t nvr, const char * const values[]) {
+		begin(status, time, function, vr, nvr, STRING, nvr);
+		for (size_t i = 0; i < nvr; i++) appendString(values[i] ? values[i] : "");
+		end();
+	}
+
+	size_t TraceRecord::size() const {
+		switch (type) {
+		case REAL:    return reals.size();
+		case INTEGER: return integers.size();
+		case BOOLEAN: return booleans.size();
+		default:      return strings.size();
+		}
+	}
+
+	double TraceRecord::value(size_t index) const {
+		switch (type) {
+		case REAL:    return reals[index];
+		case INTEGER: return integers[index];
+		case BOOLEAN: return booleans[index] ? 1.0 : 0.0;
+		default:      return 0.0;
+		}
+	}
+
+	CallTraceReader::CallTraceReader(const string &filename) {
+
+		m_file = fopen(filename.c_str(), "rb");
+
+		if (!m_file) {
+			throw runtime_error("Failed to open " + filename);
+		}
+
+		char magic[sizeof(TRACE_MAGIC)];
+		uint32_t header[3];
+
+		if (fread(magic, 1, sizeof(magic), m_file) != sizeof(magic) || memcmp(magic, TRACE_MAGIC, sizeof(magic)) != 0 ||
+			fread(header, sizeof(uint32_t), 3, m_file) != 3) {
+			fclose(m_file);
+			throw runtime_error(filename + " is not an FMI call trace");
+		}
+
+		m_header.version    = header[0];
+		m_header.fmiVersion = static_cast<FMIVersion>(header[1]);
+		m_header.kind       = static_cast<Kind>(header[2]);
+
+		if (m_header.version != TRACE_VERSION ||
+			!readString(m_header.guid) ||
+			!readString(m_header.modelIdentifier) ||
+			!readString(m_header.unzipDirectory) ||
+			!readString(m_header.instanceName)) {
+			fclose(m_file);
+			throw runtime_error("Unsupported trace version or corrupt header in " + filename);
+		}
+	}
+
+	CallTraceReader::~CallTraceReader() {
+		fclose(m_file);
+	}
+
+	bool CallTraceReader::readString(string &value) {
+
+		uint32_t length;
+
+		if (fread(&length, sizeof(length), 1, m_file) != 1) return false;
+
+		value.resize(length);
+
+		return length == 0 || fread(&value[0], 1, length, m_file) == length;
+	}
+
+	// read a value of type T from a record buffer
+	template<typename T> static T readValue(const vector<char> &buffer, size_t &pos) {
+
+		if (pos + sizeof(T) > buffer.size()) throw runtime_error("Corrupt trace record");
+
+		T value;
+		memcpy(&value, &buffer[pos], sizeof(T));
+		pos += sizeof(T);
+		return value;
+	}
+
+	bool CallTraceReader::next(TraceRecord &record) {
+
+		char header[RECORD_HEADER_SIZE];
+
+		if (fread(header, 1, RECORD_HEADER_SIZE, m_file) != RECORD_HEADER_SIZE) return false;
+
+		uint16_t function;
+		int16_t status;
+		uint32_t size;
+
+		memcpy(&function,        &header[0],  sizeof(function));
+		memcpy(&status,          &header[2],  sizeof(status));
+		memcpy(&size,            &header[4],  sizeof(size));
+		memcpy(&record.wallTime, &header[8],  sizeof(record.wallTime));
+		memcpy(&record.time,     &header[16], sizeof(record.time));
+
+		record.function = static_cast<TraceFunction>(function);
+		record.status   = status;
+
+		m_buffer.resize(size);
+
+		if (size > 0 && fread(m_buffer.data(), 1, size, m_file) != size) {
+			throw runtime_error("Unexpected end of trace");
+		}
+
+		size_t pos = 0;
+
+		const auto nvr = readValue<uint32_t>(m_buffer, pos);
+
+		record.vr.resize(nvr);
+
+		for (uint32_t i = 0; i < nvr; i++) {
+			record.vr[i] = readValue<ValueReference>(m_buffer, pos);
+		}
+
+		record.type = static_cast<Type>(readValue<uint32_t>(m_buffer, pos));
+
+		const auto nvalues = readValue<uint32_t>(m_buffer, pos);
+
+		record.reals.clear();
+		record.integers.clear();
+		record.booleans.clear();
+		record.strings.clear();
+
+		for (uint32_t i = 0; i < nvalues; i++) {
+			switch (record.type) {
+			case REAL:
+				record.reals.push_back(readValue<double>(m_buffer, pos));
+				break;
+			case INTEGER:
+				record.integers.push_back(readValue<int32_t>(m_buffer, pos));
+				break;
+			case BOOLEAN:
+				record.booleans.push_back(readValue<uint8_t>(m_buffer, pos) != 0);
+				break;
+			case STRING: {
+				const auto length = readValue<uint32_t>(m_buffer, pos);
+				if (pos + length > m_buffer.size()) throw runtime_error("Corrupt trace record");
+				record.strings.push_back(string(&m_buffer[pos], length));
+				pos += length;
+				break;
+			}
+			default:
+				throw runtime_error("Corrupt trace record");
+			}
+		}
+
+		return true;
+	}
+
+}
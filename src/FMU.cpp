@@ -7,8 +7,7 @@
 #include <iostream>
 #include <stdlib.h>
 #include <stdio.h>
-#include <sstream> // stringstream
-#include <iomanip>
+#include <algorithm> // min
 #include <stdexcept> // for runtime_error
 
 #ifdef _WIN32
@@ -17,10 +16,13 @@
 #pragma comment(lib, "shlwapi.lib")
 #else
 #include <stdarg.h>
-#include <dlfcn.h>
 #endif
 
 #include "FMU.h"
+#include "CallTrace.h"
+#include "CallStatistics.h"
+#include "CallTimeline.h"
+#include "SharedLibrary.h"
 
 using namespace std;
 using namespace fmikit;
@@ -46,38 +48,7 @@ const char* FMU::platform() {
 #endif
 }
 
-static std::string lastSystemErrorMessage() {
-
-#ifdef _WIN32
-	auto error = GetLastError();
-
-	if (error) {
-		LPVOID lpMsgBuf;
-		auto bufLen = FormatMessage(
-			FORMAT_MESSAGE_ALLOCATE_BUFFER |
-			FORMAT_MESSAGE_FROM_SYSTEM |
-			FORMAT_MESSAGE_IGNORE_INSERTS,
-			nullptr,
-			error,
-			MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT),
-			reinterpret_cast<LPTSTR>(&lpMsgBuf),
-			0, nullptr);
-
-		if (bufLen) {
-			auto lpMsgStr = static_cast<LPCSTR>(lpMsgBuf);
-			string result(lpMsgStr, lpMsgStr + bufLen);
-			LocalFree(lpMsgBuf);
-			return result + " (System Error " + to_string(error) + ")";
-		}
-	}
-#endif
-
-	return string();
-}
-
-
 FMU::FMU(const std::string &guid, const std::string &modelIdentifier, const std::string &unzipDirectory, const std::string &instanceName) :
-	m_libraryHandle(nullptr),
 	m_time(0.0),
 	m_stopTimeDefined(false),
 	m_stopTime(0.0),
@@ -110,26 +81,12 @@ FMU::FMU(const std::string &guid, const std::string &modelIdentifier, const std:
 
 	logDebug("Loading shared library: \"%s\"", libraryPath.c_str());
 
-	// load the shared library
+	// load the shared library (or share it with the other instances that use it)
+	string message;
 
-# ifdef _WIN32
-	// DLL directory as wstring
-	const wstring dllDirectory(libraryDir.begin(), libraryDir.end());
+	m_library = SharedLibrary::load(libraryPath, message);
 
-	// add the binaries directory temporarily to the DLL path to allow discovery of dependencies
-	auto dllDirectoryCookie = AddDllDirectory(dllDirectory.c_str());
-
-	m_libraryHandle = LoadLibraryEx(libraryPath.c_str(), NULL, LOAD_LIBRARY_SEARCH_DEFAULT_DIRS);
-
-	// remove the binaries directory from the DLL path
-	RemoveDllDirectory(dllDirectoryCookie);
-# else
-	m_libraryHandle = dlopen(libraryPath.c_str(), RTLD_LAZY);
-# endif
-
-	if (!m_libraryHandle) {
-
-		auto message = lastSystemErrorMessage();
+	if (!m_library) {
 
 		// replace "%1" with the library path (this works for most messages)
 		const string search = "%1";
@@ -145,17 +102,7 @@ FMU::FMU(const std::string &guid, const std::string &modelIdentifier, const std:
 	}
 }
 
-FMU::~FMU() {
-	// unload the shared library
-	if (m_libraryHandle) {
-# ifdef _WIN32
-		FreeLibrary(m_libraryHandle);
-# else
-		dlclose(m_libraryHandle);
-# endif
-		m_libraryHandle = nullptr;
-	}
-}
+FMU::~FMU() {}
 
 void FMU::logDebug(const char *message, ...) {
 	if (m_fmiCallLogger) {
@@ -168,14 +115,27 @@ void FMU::logDebug(const char *message, ...) {
 	}
 }
 
+void FMU::setCallTrace(CallTrace *callTrace) {
+	m_callTrace = callTrace;
+	if (m_callTrace) m_callTrace->writeHeader(this);
+}
+
+void FMU::profileCall(int function, uint64_t start) {
+	const auto end = CallStatistics::now();
+	const auto f = static_cast<TraceFunction>(function);
+	if (m_callStatistics) m_callStatistics->record(f, end - start);
+	if (m_callTimeline) m_callTimeline->complete(traceFunctionName(f, m_fmiVersion), start, end, m_time);
+}
+
 void FMU::error(const char *message, ...) {
 	va_list args;
 	va_start(args, message);
 	char buf[MAX_MESSAGE_SIZE];
 	vsnprintf(buf, MAX_MESSAGE_SIZE, message, args);
-	cout << buf << endl;
-	logFMUMessage(this, LOG_ERROR, nullptr, message, args);
 	va_end(args);
+	cout << buf << endl;
+	// the message logger writes the error to the trace or timeline (if any)
+	if (LOG_ERROR >= logLevel() && m_messageLogger) m_messageLogger(this, LOG_ERROR, nullptr, buf);
 	throw runtime_error(buf);
 }
 
@@ -187,35 +147,88 @@ void FMU::logFMUMessage(FMU *instance, LogLevel level, const char* category, con
 	}
 }
 
-// ValueReferenc array to debug text
-static void appendValueReferences(std::stringstream &ss, const fmikit::ValueReference vr[], size_t nvr) {
+// append formatted text to a message buffer of MAX_MESSAGE_SIZE and return the new length
+static size_t appendf(char *buf, size_t pos, const char *format, ...) {
+
+	if (pos >= MAX_MESSAGE_SIZE - 1) return pos; // buffer is full
+
+	va_list args;
+	va_start(args, format);
+	int n = vsnprintf(buf + pos, MAX_MESSAGE_SIZE - pos, format, args);
+	va_end(args);
+
+	if (n < 0) return pos;
+
+	return min(pos + n, static_cast<size_t>(MAX_MESSAGE_SIZE - 1));
+}
+
+static size_t appendValue(char *buf, size_t pos, double value) { return appendf(buf, pos, "%.16g", value); }
+static size_t appendValue(char *buf, size_t pos, int value)    { return appendf(buf, pos, "%d", value); }
+static size_t appendValue(char *buf, size_t pos, bool value)   { return appendf(buf, pos, "%d", value ? 1 : 0); }
+
+// function call with value references and values to debug text (without std::stringstream)
+template<typename T> static void formatCall(char *buf, const char *functionName, const fmikit::ValueReference vr[], size_t nvr, const T values[], bool get) {
+
+	size_t pos = appendf(buf, 0, "%s(vr=[", functionName);
+
 	for (size_t i = 0; i < nvr; i++) {
-		ss << vr[i];
-		if (i < nvr - 1) ss << ", ";
+		pos = appendf(buf, pos, i < nvr - 1 ? "%u, " : "%u", vr[i]);
 	}
-}
 
-static void appendDoubles(std::stringstream &ss, const double values[], size_t nvalues) {
-	for (size_t i = 0; i < nvalues; i++) {
-		ss << values[i];
-		if (i < nvalues - 1) ss << ", ";
+	pos = appendf(buf, pos, get ? "], nvr=%u): value=[" : "], nvr=%u, value=[", static_cast<unsigned int>(nvr));
+
+	for (size_t i = 0; i < nvr; i++) {
+		pos = appendValue(buf, pos, values[i]);
+		if (i < nvr - 1) pos = appendf(buf, pos, ", ");
 	}
+
+	appendf(buf, pos, get ? "]" : "])");
 }
 
 void FMU::logGetReal(const char *functionName, const ValueReference vr[], size_t nvr, const double value[]) {
-    if (m_fmiCallLogger) {
-        std::stringstream ss;
-        ss << std::setprecision(16);
-        ss << functionName << "(vr=["; appendValueReferences(ss, vr, nvr); ss << "], nvr=" << nvr << "): value=["; appendDoubles(ss, value, nvr); ss << "]";
-        logDebug(ss.str().c_str());
-    }
+	if (m_fmiCallLogger) {
+		char buf[MAX_MESSAGE_SIZE];
+		formatCall(buf, functionName, vr, nvr, value, true);
+		m_fmiCallLogger(this, buf);
+	}
 }
 
 void FMU::logSetReal(const char *functionName, const ValueReference vr[], size_t nvr, const double value[]) {
-    if (m_fmiCallLogger) {
-        std::stringstream ss;
-        ss << std::setprecision(16);
-        ss << functionName << "(vr=["; appendValueReferences(ss, vr, nvr); ss << "], nvr=" << nvr << ", value=["; appendDoubles(ss, value, nvr); ss << "])";
-        logDebug(ss.str().c_str());
-    }
+	if (m_fmiCallLogger) {
+		char buf[MAX_MESSAGE_SIZE];
+		formatCall(buf, functionName, vr, nvr, value, false);
+		m_fmiCallLogger(this, buf);
+	}
+}
+
+void FMU::logGetInteger(const char *functionName, const ValueReference vr[], size_t nvr, const int value[]) {
+	if (m_fmiCallLogger) {
+		char buf[MAX_MESSAGE_SIZE];
+		formatCall(buf, functionName, vr, nvr, value, true);
+		m_fmiCallLogger(this, buf);
+	}
+}
+
+void FMU::logSetInteger(const char *functionName, const ValueReference vr[], size_t nvr, const int value[]) {
+	if (m_fmiCallLogger) {
+		char buf[MAX_MESSAGE_SIZE];
+		formatCall(buf, functionName, vr, nvr, value, false);
+		m_fmiCallLogger(this, buf);
+	}
+}
+
+void FMU::logGetBoolean(const char *functionName, const ValueReference vr[], size_t nvr, const bool value[]) {
+	if (m_fmiCallLogger) {
+		char buf[MAX_MESSAGE_SIZE];
+		formatCall(buf, functionName, vr, nvr, value, true);
+		m_fmiCallLogger(this, buf);
+	}
+}
+
+void FMU::logSetBoolean(const char *functionName, const ValueReference vr[], size_t nvr, const bool value[]) {
+	if (m_fmiCallLogger) {
+		char buf[MAX_MESSAGE_SIZE];
+		formatCall(buf, functionName, vr, nvr, value, false);
+		m_fmiCallLogger(this, buf);
+	}
 }
@@ -7,9 +7,13 @@
 #include <iostream>
 
 #include "FMU1.h"
+#include "CallTrace.h"
+#include "CallStatistics.h"
 
 #include <sstream>
 #include <iomanip>
+#include <mutex>
+#include <atomic>
 #include <stdarg.h>
 
 #ifndef _WIN32
@@ -48,6 +52,10 @@ __inline int c99_snprintf(char *outBuf, size_t size, const char *format, ...) {
 
 using namespace std;
 
+#define RESOLVE_FUNCTION(f) fmi1##f = reinterpret_cast<fmi1##f##TYPE *>(library.symbol(prefix + "fmi" #f));
+
+#define REQUIRE_FUNCTION(f) if (!m_functions->fmi1##f) error("Function %s not found in shared library", "fmi" #f);
+
 // ValueReferenc array to debug text
 static void appendValueReferences(std::stringstream &ss, const fmikit::ValueReference vr[], size_t nvr) {
 	for (size_t i = 0; i < nvr; i++) {
@@ -66,6 +74,49 @@ static void appendDoubles(std::stringstream &ss, const double values[], size_t n
 
 namespace fmikit {
 
+	FMU1Functions::FMU1Functions(const SharedLibrary &library, const string &prefix) {
+
+		RESOLVE_FUNCTION(GetVersion)
+		RESOLVE_FUNCTION(GetReal)
+		RESOLVE_FUNCTION(GetInteger)
+		RESOLVE_FUNCTION(GetBoolean)
+		RESOLVE_FUNCTION(GetString)
+		RESOLVE_FUNCTION(SetDebugLogging)
+		RESOLVE_FUNCTION(SetReal)
+		RESOLVE_FUNCTION(SetInteger)
+		RESOLVE_FUNCTION(SetBoolean)
+		RESOLVE_FUNCTION(SetString)
+		RESOLVE_FUNCTION(GetTypesPlatform)
+		RESOLVE_FUNCTION(InstantiateSlave)
+		RESOLVE_FUNCTION(InitializeSlave)
+		RESOLVE_FUNCTION(TerminateSlave)
+		RESOLVE_FUNCTION(ResetSlave)
+		RESOLVE_FUNCTION(FreeSlaveInstance)
+		RESOLVE_FUNCTION(SetRealInputDerivatives)
+		RESOLVE_FUNCTION(GetRealOutputDerivatives)
+		RESOLVE_FUNCTION(CancelStep)
+		RESOLVE_FUNCTION(DoStep)
+		RESOLVE_FUNCTION(GetStatus)
+		RESOLVE_FUNCTION(GetRealStatus)
+		RESOLVE_FUNCTION(GetIntegerStatus)
+		RESOLVE_FUNCTION(GetBooleanStatus)
+		RESOLVE_FUNCTION(GetStringStatus)
+		RESOLVE_FUNCTION(GetModelTypesPlatform)
+		RESOLVE_FUNCTION(InstantiateModel)
+		RESOLVE_FUNCTION(FreeModelInstance)
+		RESOLVE_FUNCTION(SetTime)
+		RESOLVE_FUNCTION(SetContinuousStates)
+		RESOLVE_FUNCTION(CompletedIntegratorStep)
+		RESOLVE_FUNCTION(Initialize)
+		RESOLVE_FUNCTION(GetDerivatives)
+		RESOLVE_FUNCTION(GetEventIndicators)
+		RESOLVE_FUNCTION(EventUpdate)
+		RESOLVE_FUNCTION(GetContinuousStates)
+		RESOLVE_FUNCTION(GetNominalContinuousStates)
+		RESOLVE_FUNCTION(GetStateValueReferences)
+		RESOLVE_FUNCTION(Terminate)
+	}
+
 	// bool to string
 	static const char *btoa(bool value) {
 		return value ? "true" : "false";
@@ -85,16 +136,79 @@ namespace fmikit {
 		return value ? "true" : "false";
 	}
     
-    FMU1* FMU1::s_currentInstance = nullptr;
+	thread_local FMU1* FMU1::s_currentInstance = nullptr;
+
+	// An entry of the list of instances by component. The list only grows and unregistered entries
+	// are reused, so the logger can walk it without locking while other instances are (un)registered.
+	struct ComponentEntry {
+		atomic<fmi1Component> component { nullptr };
+		atomic<FMU1 *> instance { nullptr };
+		ComponentEntry *next = nullptr;
+	};
+
+	static atomic<ComponentEntry *> s_components { nullptr };
+
+	// serializes registerComponent() and unregisterComponent()
+	static mutex s_componentsMutex;
+
+	void FMU1::registerComponent() {
+
+		lock_guard<mutex> lock(s_componentsMutex);
+
+		auto *head = s_components.load(memory_order_relaxed);
+
+		ComponentEntry *entry = head;
+
+		while (entry && entry->component.load(memory_order_relaxed)) entry = entry->next;
+
+		if (entry) {
+			entry->instance.store(this, memory_order_relaxed);
+			entry->component.store(m_component, memory_order_release);
+		} else {
+			entry = new ComponentEntry();
+			entry->instance.store(this, memory_order_relaxed);
+			entry->component.store(m_component, memory_order_relaxed);
+			entry->next = head;
+			s_components.store(entry, memory_order_release);
+		}
+	}
+
+	void FMU1::unregisterComponent() {
+
+		lock_guard<mutex> lock(s_componentsMutex);
+
+		for (auto *entry = s_components.load(memory_order_relaxed); entry; entry = entry->next) {
+			if (entry->component.load(memory_order_relaxed) == m_component && entry->instance.load(memory_order_relaxed) == this) {
+				entry->component.store(nullptr, memory_order_release);
+			}
+		}
+	}
 
 	void FMU1::logFMU1Message(fmi1Component c, fmi1String instanceName, fmi1Status status, fmi1String category, fmi1String message, ...) {
+
+		// the instance that is calling into the FMU on this thread (also used during instantiation when the component is not yet known)
+		FMU1 *instance = s_currentInstance;
+
+		if (c && (!instance || instance->m_component != c)) {
+
+			// message from another thread of the FMU
+			for (auto *entry = s_components.load(memory_order_acquire); entry; entry = entry->next) {
+				if (entry->component.load(memory_order_acquire) == c) {
+					instance = entry->instance.load(memory_order_relaxed);
+					break;
+				}
+			}
+		}
+
+		if (!instance) return;
+
         va_list args;
         va_start(args, message);
         
         auto level = static_cast<LogLevel>(status);
         
-        if (level >= s_currentInstance->logLevel()) {
-            logFMUMessage(s_currentInstance, level, category, message, args);
+        if (level >= instance->logLevel()) {
+            logFMUMessage(instance, level, category, message, args);
         }
         
         va_end(args);
@@ -113,16 +227,18 @@ namespace fmikit {
 
         m_fmiVersion = FMI_VERSION_1;
 
-		fmi1GetVersion      = getFunc<fmi1GetVersionTYPE>      ("fmiGetVersion");
-		fmi1GetReal         = getFunc<fmi1GetRealTYPE>         ("fmiGetReal");
-		fmi1GetInteger      = getFunc<fmi1GetIntegerTYPE>      ("fmiGetInteger");
-		fmi1GetBoolean      = getFunc<fmi1GetBooleanTYPE>      ("fmiGetBoolean");
-		fmi1GetString       = getFunc<fmi1GetStringTYPE>       ("fmiGetString");
-		fmi1SetDebugLogging = getFunc<fmi1SetDebugLoggingTYPE> ("fmiSetDebugLogging");
-		fmi1SetReal         = getFunc<fmi1SetRealTYPE>         ("fmiSetReal");
-		fmi1SetInteger      = getFunc<fmi1SetIntegerTYPE>      ("fmiSetInteger");
-		fmi1SetBoolean      = getFunc<fmi1SetBooleanTYPE>      ("fmiSetBoolean");
-		fmi1SetString       = getFunc<fmi1SetStringTYPE>       ("fmiSetString");
+		m_functions = m_library->functions<FMU1Functions>(modelIdentifier + "_");
+
+		REQUIRE_FUNCTION(GetVersion)
+		REQUIRE_FUNCTION(GetReal)
+		REQUIRE_FUNCTION(GetInteger)
+		REQUIRE_FUNCTION(GetBoolean)
+		REQUIRE_FUNCTION(GetString)
+		REQUIRE_FUNCTION(SetDebugLogging)
+		REQUIRE_FUNCTION(SetReal)
+		REQUIRE_FUNCTION(SetInteger)
+		REQUIRE_FUNCTION(SetBoolean)
+		REQUIRE_FUNCTION(SetString)
 
 		m_callbackFunctions.logger         = logFMU1Message;
 		m_callbackFunctions.allocateMemory = allocateMemory ? allocateMemory : calloc;
@@ -130,38 +246,51 @@ namespace fmikit {
 		m_callbackFunctions.stepFinished   = nullptr;
 	}
 
-	FMU1::~FMU1() {}
+	FMU1::~FMU1() {
+		if (s_currentInstance == this) s_currentInstance = nullptr;
+	}
 
 	void FMU1::assertNoError(fmi1Status status, const char *message) {
+		m_status = status;
 		if (status >= fmi1Error) return;
 	}
 
 	double FMU1::getReal(const ValueReference vr) {
         s_currentInstance = this;
 		fmi1Real value;
-		ASSERT_NO_ERROR(fmi1GetReal(m_component, &vr, 1, &value), "Failed to get Real")
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi1GetReal(m_component, &vr, 1, &value), "Failed to get Real")
+		PROFILE_END(TRACE_GET_REAL)
 		logDebug("fmi1GetReal(vr=[%d], nvr=1): value=[%.16g]", vr, value);
+		TRACE_CALL(TRACE_GET_REAL, &vr, 1, &value)
 		return value;
 	}
 
 	int FMU1::getInteger(ValueReference vr) {
         s_currentInstance = this;
 		fmi1Integer value;
-		ASSERT_NO_ERROR(fmi1GetInteger(m_component, &vr, 1, &value), "Failed to get Integer")
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi1GetInteger(m_component, &vr, 1, &value), "Failed to get Integer")
+		PROFILE_END(TRACE_GET_INTEGER)
 		logDebug("fmi1GetInteger(vr=[%d], nvr=1): value=[%d]", vr, value);
+		TRACE_CALL(TRACE_GET_INTEGER, &vr, 1, &value)
 		return value;
 	}
 
 	bool FMU1::getBoolean(ValueReference vr) {
         s_currentInstance = this;
 		fmi1Boolean value;
-		ASSERT_NO_ERROR(fmi1GetBoolean(m_component, &vr, 1, &value), "Failed to get Boolean")
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi1GetBoolean(m_component, &vr, 1, &value), "Failed to get Boolean")
+		PROFILE_END(TRACE_GET_BOOLEAN)
 		logDebug("fmi1GetBoolean(vr=[%d], nvr=1): value=[%d]", vr, value);
-		return value != fmi1False;
+		const bool b = value != fmi1False;
+		TRACE_CALL(TRACE_GET_BOOLEAN, &vr, 1, &b)
+		return b;
 	}
 
 	void FMU1::getCString(ValueReference vr, char *value) {
-		ASSERT_NO_ERROR(fmi1GetString(m_component, &vr, 1, const_cast<fmi1String *>(&value)), "Failed to get String")
+		ASSERT_NO_ERROR(m_functions->fmi1GetString(m_component, &vr, 1, const_cast<fmi1String *>(&value)), "Failed to get String")
 	}
 
 	string FMU1::getString(ValueReference vr) {
@@ -175,33 +304,109 @@ namespace fmikit {
 
 	void FMU1::setReal(const ValueReference vr, double value) {
         s_currentInstance = this;
-		ASSERT_NO_ERROR(fmi1SetReal(m_component, &vr, 1, &value), "Failed to set Real");
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi1SetReal(m_component, &vr, 1, &value), "Failed to set Real");
+		PROFILE_END(TRACE_SET_REAL)
 		logDebug("fmi1SetReal(vr=[%d], nvr=1, value=[%.16g])", vr, value);
+		TRACE_CALL(TRACE_SET_REAL, &vr, 1, &value)
 	}
 
 	void FMU1::setInteger(ValueReference vr, int value) {
         s_currentInstance = this;
-		ASSERT_NO_ERROR(fmi1SetInteger(m_component, &vr, 1, &value), "Failed to set Integer value");
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi1SetInteger(m_component, &vr, 1, &value), "Failed to set Integer value");
+		PROFILE_END(TRACE_SET_INTEGER)
 		logDebug("fmi1SetInteger(vr=[%d], nvr=1, value=[%d])", vr, value);
+		TRACE_CALL(TRACE_SET_INTEGER, &vr, 1, &value)
 	}
 
 	void FMU1::setBoolean(ValueReference vr, bool value) {
         s_currentInstance = this;
 		fmi1Boolean v = value ? fmi1True : fmi1False;
-		ASSERT_NO_ERROR(fmi1SetBoolean(m_component, &vr, 1, &v), "Failed to set Boolean value");
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi1SetBoolean(m_component, &vr, 1, &v), "Failed to set Boolean value");
+		PROFILE_END(TRACE_SET_BOOLEAN)
 		logDebug("fmi1SetBoolean(vr=[%d], nvr=1, value=[%d])", vr, v);
+		TRACE_CALL(TRACE_SET_BOOLEAN, &vr, 1, &value)
 	}
 
 
 	void FMU1::setCString(ValueReference vr, const char *value) {
-		ASSERT_NO_ERROR(fmi1SetString(m_component, &vr, 1, &value), "Failed to set String")
+		ASSERT_NO_ERROR(m_functions->fmi1SetString(m_component, &vr, 1, &value), "Failed to set String")
 	}
 
 	void FMU1::setString(ValueReference vr, string value) {
         s_currentInstance = this;
 		fmi1String s = value.c_str();
+		PROFILE_BEGIN
 		setCString(vr, s);
+		PROFILE_END(TRACE_SET_STRING)
 		logDebug("fmi1SetString(vr=[%d], nvr=1, value=[\"%s\"])", vr, s);
+		TRACE_CALL(TRACE_SET_STRING, &vr, 1, &s)
+	}
+
+	void FMU1::getReal(const ValueReference vr[], size_t nvr, double value[]) {
+        s_currentInstance = this;
+		if (nvr < 1) return; // nothing to do
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi1GetReal(m_component, vr, nvr, value), "Failed to get Real")
+		PROFILE_END(TRACE_GET_REAL)
+		logGetReal("fmi1GetReal", vr, nvr, value);
+		TRACE_CALL(TRACE_GET_REAL, vr, nvr, value)
+	}
+
+	void FMU1::getInteger(const ValueReference vr[], size_t nvr, int value[]) {
+        s_currentInstance = this;
+		if (nvr < 1) return; // nothing to do
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi1GetInteger(m_component, vr, nvr, value), "Failed to get Integer")
+		PROFILE_END(TRACE_GET_INTEGER)
+		logGetInteger("fmi1GetInteger", vr, nvr, value);
+		TRACE_CALL(TRACE_GET_INTEGER, vr, nvr, value)
+	}
+
+	void FMU1::getBoolean(const ValueReference vr[], size_t nvr, bool value[]) {
+        s_currentInstance = this;
+		if (nvr < 1) return; // nothing to do
+		if (m_booleanBuffer.size() < nvr) m_booleanBuffer.resize(nvr);
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi1GetBoolean(m_component, vr, nvr, m_booleanBuffer.data()), "Failed to get Boolean")
+		PROFILE_END(TRACE_GET_BOOLEAN)
+		for (size_t i = 0; i < nvr; i++) value[i] = m_booleanBuffer[i] != fmi1False;
+		logGetBoolean("fmi1GetBoolean", vr, nvr, value);
+		TRACE_CALL(TRACE_GET_BOOLEAN, vr, nvr, value)
+	}
+
+	void FMU1::setReal(const ValueReference vr[], size_t nvr, const double value[]) {
+        s_currentInstance = this;
+		if (nvr < 1) return; // nothing to do
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi1SetReal(m_component, vr, nvr, value), "Failed to set Real")
+		PROFILE_END(TRACE_SET_REAL)
+		logSetReal("fmi1SetReal", vr, nvr, value);
+		TRACE_CALL(TRACE_SET_REAL, vr, nvr, value)
+	}
+
+	void FMU1::setInteger(const ValueReference vr[], size_t nvr, const int value[]) {
+        s_currentInstance = this;
+		if (nvr < 1) return; // nothing to do
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi1SetInteger(m_component, vr, nvr, value), "Failed to set Integer value")
+		PROFILE_END(TRACE_SET_INTEGER)
+		logSetInteger("fmi1SetInteger", vr, nvr, value);
+		TRACE_CALL(TRACE_SET_INTEGER, vr, nvr, value)
+	}
+
+	void FMU1::setBoolean(const ValueReference vr[], size_t nvr, const bool value[]) {
+        s_currentInstance = this;
+		if (nvr < 1) return; // nothing to do
+		if (m_booleanBuffer.size() < nvr) m_booleanBuffer.resize(nvr);
+		for (size_t i = 0; i < nvr; i++) m_booleanBuffer[i] = value[i] ? fmi1True : fmi1False;
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi1SetBoolean(m_component, vr, nvr, m_booleanBuffer.data()), "Failed to set Boolean value")
+		PROFILE_END(TRACE_SET_BOOLEAN)
+		logSetBoolean("fmi1SetBoolean", vr, nvr, value);
+		TRACE_CALL(TRACE_SET_BOOLEAN, vr, nvr, value)
 	}
 
 	FMU1Slave::FMU1Slave(const std::string &guid,
@@ -214,21 +419,21 @@ namespace fmikit {
 
 		m_kind = CO_SIMULATION;
 
-		fmi1GetTypesPlatform         = getFunc<fmi1GetTypesPlatformTYPE>         ("fmiGetTypesPlatform");
-		fmi1InstantiateSlave         = getFunc<fmi1InstantiateSlaveTYPE>         ("fmiInstantiateSlave");
-		fmi1InitializeSlave          = getFunc<fmi1InitializeSlaveTYPE>          ("fmiInitializeSlave");
-		fmi1TerminateSlave           = getFunc<fmi1TerminateSlaveTYPE>           ("fmiTerminateSlave");
-		fmi1ResetSlave               = getFunc<fmi1ResetSlaveTYPE>               ("fmiResetSlave");
-		fmi1FreeSlaveInstance        = getFunc<fmi1FreeSlaveInstanceTYPE>        ("fmiFreeSlaveInstance");
-		fmi1SetRealInputDerivatives  = getFunc<fmi1SetRealInputDerivativesTYPE>  ("fmiSetRealInputDerivatives");
-		fmi1GetRealOutputDerivatives = getFunc<fmi1GetRealOutputDerivativesTYPE> ("fmiGetRealOutputDerivatives");
-		fmi1CancelStep               = getFunc<fmi1CancelStepTYPE>               ("fmiCancelStep");
-		fmi1DoStep                   = getFunc<fmi1DoStepTYPE>                   ("fmiDoStep");
-		fmi1GetStatus                = getFunc<fmi1GetStatusTYPE>                ("fmiGetStatus");
-		fmi1GetRealStatus            = getFunc<fmi1GetRealStatusTYPE>            ("fmiGetRealStatus");
-		fmi1GetIntegerStatus         = getFunc<fmi1GetIntegerStatusTYPE>         ("fmiGetIntegerStatus");
-		fmi1GetBooleanStatus         = getFunc<fmi1GetBooleanStatusTYPE>         ("fmiGetBooleanStatus");
-		fmi1GetStringStatus          = getFunc<fmi1GetStringStatusTYPE>          ("fmiGetStringStatus");
+		REQUIRE_FUNCTION(GetTypesPlatform)
+		REQUIRE_FUNCTION(InstantiateSlave)
+		REQUIRE_FUNCTION(InitializeSlave)
+		REQUIRE_FUNCTION(TerminateSlave)
+		REQUIRE_FUNCTION(ResetSlave)
+		REQUIRE_FUNCTION(FreeSlaveInstance)
+		REQUIRE_FUNCTION(SetRealInputDerivatives)
+		REQUIRE_FUNCTION(GetRealOutputDerivatives)
+		REQUIRE_FUNCTION(CancelStep)
+		REQUIRE_FUNCTION(DoStep)
+		REQUIRE_FUNCTION(GetStatus)
+		REQUIRE_FUNCTION(GetRealStatus)
+		REQUIRE_FUNCTION(GetIntegerStatus)
+		REQUIRE_FUNCTION(GetBooleanStatus)
+		REQUIRE_FUNCTION(GetStringStatus)
 	}
 
     void FMU1Slave::instantiateSlave(const std::string &fmuLocation, double timeout, bool loggingOn) {
@@ -236,22 +441,35 @@ namespace fmikit {
     }
 
 	void FMU1Slave::instantiateSlave_(fmi1String  instanceName, fmi1String  fmuGUID, fmi1String  fmuLocation, fmi1String  mimeType, fmi1Real timeout, fmi1Boolean visible, fmi1Boolean interactive, fmi1CallbackFunctions functions, fmi1Boolean loggingOn) {
-		HANDLE_EXCEPTION(m_component = fmi1InstantiateSlave(instanceName, fmuGUID, fmuLocation, mimeType, timeout, visible, interactive, m_callbackFunctions, loggingOn), "Failed to instantiate slave")
+        s_currentInstance = this;
+		PROFILE_BEGIN
+		HANDLE_EXCEPTION(m_component = m_functions->fmi1InstantiateSlave(instanceName, fmuGUID, fmuLocation, mimeType, timeout, visible, interactive, m_callbackFunctions, loggingOn), "Failed to instantiate slave")
+		PROFILE_END(TRACE_INSTANTIATE)
 		logDebug("fmi1InstantiateSlave(instanceName=\"%s\", fmuGUID=\"%s\", fmuLocation=\"%s\", mimeType=\"%s\", timeout=%.16g, visible=visible, interactive=interactive, functions=0x%p, loggingOn=%d)",
 		instanceName, fmuGUID, fmuLocation, mimeType, timeout, visible, interactive, functions, loggingOn);
+        m_status = m_component ? fmi1OK : fmi1Error;
+		TRACE_CALL(TRACE_INSTANTIATE, { timeout, static_cast<double>(loggingOn) })
         if (!m_component) error("Failed to instantiate slave");
+		registerComponent();
 	}
 
 	void FMU1Slave::terminateSlave() {
         s_currentInstance = this;
-		ASSERT_NO_ERROR(fmi1TerminateSlave(m_component), "Failed to terminate slave")
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi1TerminateSlave(m_component), "Failed to terminate slave")
+		PROFILE_END(TRACE_TERMINATE)
 		logDebug("fmi1TerminateSlave()");
+		TRACE_CALL(TRACE_TERMINATE)
 	}
 
 	void FMU1Slave::freeSlaveInstance() {
         s_currentInstance = this;
-		HANDLE_EXCEPTION(fmi1FreeSlaveInstance(m_component), "Failed to terminate slave")
+		PROFILE_BEGIN
+		HANDLE_EXCEPTION(m_functions->fmi1FreeSlaveInstance(m_component), "Failed to terminate slave")
+		PROFILE_END(TRACE_FREE_INSTANCE)
+		unregisterComponent();
 		logDebug("fmi1FreeSlaveInstance()");
+		TRACE_CALL(TRACE_FREE_INSTANCE)
 	}
 
 	FMU1Slave::~FMU1Slave() {
@@ -265,8 +483,11 @@ namespace fmikit {
 		m_time = startTime;
 		this->m_stopTimeDefined = stopTimeDefined;
 		this->m_stopTime = stopTime;
-		ASSERT_NO_ERROR(fmi1InitializeSlave(m_component, m_time, stopTimeDefined, stopTime), "Failed to initialize slave")
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi1InitializeSlave(m_component, m_time, stopTimeDefined, stopTime), "Failed to initialize slave")
+		PROFILE_END(TRACE_INITIALIZE)
 		logDebug("fmi1InitializeSlave(startTime=%.16g, stopTimeDefined=%s, stopTime=%.16g)", startTime, btoa(stopTimeDefined), stopTime);
+		TRACE_CALL(TRACE_INITIALIZE, { startTime, static_cast<double>(stopTimeDefined), stopTime })
 	}
 
 	void FMU1Slave::doStep(double h) {
@@ -274,15 +495,21 @@ namespace fmikit {
 		if (m_stopTimeDefined && m_time + h > m_stopTime - h / 1000) {
 			h = m_stopTime - m_time;
 		}
-		ASSERT_NO_ERROR(fmi1DoStep(m_component, m_time, h, fmi1True), "Failed to do step")
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi1DoStep(m_component, m_time, h, fmi1True), "Failed to do step")
+		PROFILE_END(TRACE_DO_STEP)
 		logDebug("fmi1DoStep(currentCommunicationPoint=%.16g, communicationStepSize=%.16g, newStep=fmi1True)", m_time, h);
+		TRACE_CALL(TRACE_DO_STEP, { m_time, h })
 		m_time += h;
 	}
 
 	void FMU1Slave::setRealInputDerivative(ValueReference vr, int order, double value) {
         s_currentInstance = this;
-		ASSERT_NO_ERROR(fmi1SetRealInputDerivatives(m_component, &vr, 1, &order, &value), "Failed to set real input derivatives")
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi1SetRealInputDerivatives(m_component, &vr, 1, &order, &value), "Failed to set real input derivatives")
+		PROFILE_END(TRACE_SET_REAL_INPUT_DERIVATIVES)
 		logDebug("fmi1SetRealInputDerivatives(component, vr=[%d], nvr=1, order=[%d], value=[%.16g])", vr, order, value);
+		TRACE_CALL(TRACE_SET_REAL_INPUT_DERIVATIVES, &vr, 1, { static_cast<double>(order), value })
 	}
 
 	FMU1Model::FMU1Model(const std::string &guid,
@@ -302,20 +529,20 @@ namespace fmikit {
 		m_eventInfo.upcomingTimeEvent           = fmi1False;
 		m_eventInfo.nextEventTime               = 0.0;
 
-		fmi1GetModelTypesPlatform       = getFunc<fmi1GetModelTypesPlatformTYPE>      ("fmiGetModelTypesPlatform");
-		fmi1InstantiateModel            = getFunc<fmi1InstantiateModelTYPE>           ("fmiInstantiateModel");
-		fmi1FreeModelInstance           = getFunc<fmi1FreeModelInstanceTYPE>          ("fmiFreeModelInstance");
-		fmi1SetTime                     = getFunc<fmi1SetTimeTYPE>                    ("fmiSetTime");
-		fmi1SetContinuousStates         = getFunc<fmi1SetContinuousStatesTYPE>        ("fmiSetContinuousStates");
-		fmi1CompletedIntegratorStep     = getFunc<fmi1CompletedIntegratorStepTYPE>    ("fmiCompletedIntegratorStep");
-		fmi1Initialize                  = getFunc<fmi1InitializeTYPE>                 ("fmiInitialize");
-		fmi1GetDerivatives              = getFunc<fmi1GetDerivativesTYPE>             ("fmiGetDerivatives");
-		fmi1GetEventIndicators          = getFunc<fmi1GetEventIndicatorsTYPE>         ("fmiGetEventIndicators");
-		fmi1EventUpdate                 = getFunc<fmi1EventUpdateTYPE>                ("fmiEventUpdate");
-		fmi1GetContinuousStates         = getFunc<fmi1GetContinuousStatesTYPE>        ("fmiGetContinuousStates");
-		fmi1GetNominalContinuousStates  = getFunc<fmi1GetNominalContinuousStatesTYPE> ("fmiGetNominalContinuousStates");
-		fmi1GetStateValueReferences     = getFunc<fmi1GetStateValueReferencesTYPE>    ("fmiGetStateValueReferences");
-		fmi1Terminate                   = getFunc<fmi1TerminateTYPE>                  ("fmiTerminate");
+		REQUIRE_FUNCTION(GetModelTypesPlatform)
+		REQUIRE_FUNCTION(InstantiateModel)
+		REQUIRE_FUNCTION(FreeModelInstance)
+		REQUIRE_FUNCTION(SetTime)
+		REQUIRE_FUNCTION(SetContinuousStates)
+		REQUIRE_FUNCTION(CompletedIntegratorStep)
+		REQUIRE_FUNCTION(Initialize)
+		REQUIRE_FUNCTION(GetDerivatives)
+		REQUIRE_FUNCTION(GetEventIndicators)
+		REQUIRE_FUNCTION(EventUpdate)
+		REQUIRE_FUNCTION(GetContinuousStates)
+		REQUIRE_FUNCTION(GetNominalContinuousStates)
+		REQUIRE_FUNCTION(GetStateValueReferences)
+		REQUIRE_FUNCTION(Terminate)
 	}
     
     void FMU1Model::instantiateModel(bool loggingOn) {
@@ -323,21 +550,34 @@ namespace fmikit {
     }
 
 	void FMU1Model::instantiateModel_(fmi1String instanceName, fmi1String GUID, fmi1CallbackFunctions functions, fmi1Boolean loggingOn) {
-		HANDLE_EXCEPTION(m_component = fmi1InstantiateModel(instanceName, GUID, m_callbackFunctions, loggingOn), "Failed to instantiate model")
+        s_currentInstance = this;
+		PROFILE_BEGIN
+		HANDLE_EXCEPTION(m_component = m_functions->fmi1InstantiateModel(instanceName, GUID, m_callbackFunctions, loggingOn), "Failed to instantiate model")
+		PROFILE_END(TRACE_INSTANTIATE)
 		logDebug("fmi1InstantiateModel(instanceName=\"%s\", GUID=\"%s\", loggingOn=%d): component=0x%p", instanceName, GUID, loggingOn, m_component);
+        m_status = m_component ? fmi1OK : fmi1Error;
+		TRACE_CALL(TRACE_INSTANTIATE, { static_cast<double>(loggingOn) })
         if (!m_component) error("Failed to instantiate model");
+		registerComponent();
 	}
 
 	void FMU1Model::terminate() {
         s_currentInstance = this;
-		ASSERT_NO_ERROR(fmi1Terminate(m_component), "Failed to terminate");
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi1Terminate(m_component), "Failed to terminate");
+		PROFILE_END(TRACE_TERMINATE)
 		logDebug("fmi1Terminate()");
+		TRACE_CALL(TRACE_TERMINATE)
 	}
 
 	void FMU1Model::freeModelInstance() {
         s_currentInstance = this;
-		HANDLE_EXCEPTION(fmi1FreeModelInstance(m_component), "Failed to free model instance")
+		PROFILE_BEGIN
+		HANDLE_EXCEPTION(m_functions->fmi1FreeModelInstance(m_component), "Failed to free model instance")
+		PROFILE_END(TRACE_FREE_INSTANCE)
+		unregisterComponent();
 		logDebug("fmi1FreeModelInstance()");
+		TRACE_CALL(TRACE_FREE_INSTANCE)
 	}
 
 	FMU1Model::~FMU1Model() {
@@ -349,54 +589,77 @@ namespace fmikit {
 	void FMU1Model::initialize(bool toleranceControlled, double relativeTolerance) {
         s_currentInstance = this;
 		logDebug("fmi1Initialize(toleranceControlled=%s, relativeTolerance=%.16g)", btoa(toleranceControlled), relativeTolerance);
-		fmi1Initialize(m_component, toleranceControlled, relativeTolerance, &m_eventInfo);
+		PROFILE_BEGIN
+		m_status = m_functions->fmi1Initialize(m_component, toleranceControlled, relativeTolerance, &m_eventInfo);
+		PROFILE_END(TRACE_INITIALIZE)
+		TRACE_CALL(TRACE_INITIALIZE, { static_cast<double>(toleranceControlled), relativeTolerance })
 	}
 
 	void FMU1Model::setTime(double time) {
         s_currentInstance = this;
 		logDebug("fmi1SetTime(time=%.16g)", time);
-		ASSERT_NO_ERROR(fmi1SetTime(m_component, time), "Failed to set time")
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi1SetTime(m_component, time), "Failed to set time")
+		PROFILE_END(TRACE_SET_TIME)
 		this->m_time = time;
+		TRACE_CALL(TRACE_SET_TIME, { time })
 	}
 
 	void FMU1Model::setContinuousStates(const double states[], size_t size) {
         s_currentInstance = this;
 		if (size < 1) return; // nothing to do
 		logDebug("fmi1SetContinuousStates(states=[...], size=%d)", size);
-		ASSERT_NO_ERROR(fmi1SetContinuousStates(m_component, states, size), "Failed to set continuous states")
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi1SetContinuousStates(m_component, states, size), "Failed to set continuous states")
+		PROFILE_END(TRACE_SET_CONTINUOUS_STATES)
+		TRACE_CALL(TRACE_SET_CONTINUOUS_STATES, states, size)
 	}
 
 	void FMU1Model::getContinuousStates(double states[], size_t size) {
         s_currentInstance = this;
 		if (size < 1) return; // nothing to do
-		ASSERT_NO_ERROR(fmi1GetContinuousStates(m_component, states, size), "Failed to get continuous states")
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi1GetContinuousStates(m_component, states, size), "Failed to get continuous states")
+		PROFILE_END(TRACE_GET_CONTINUOUS_STATES)
 		logDebug("fmi1GetContinuousStates(size=%d): states=[...]", size);
+		TRACE_CALL(TRACE_GET_CONTINUOUS_STATES, states, size)
 	}
 
 	void FMU1Model::getNominalContinuousStates(double states[], size_t size) {
         s_currentInstance = this;
 		if (size < 1) return; // nothing to do
-		ASSERT_NO_ERROR(fmi1GetNominalContinuousStates(m_component, states, size), "Failed to get nominal continuous states")
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi1GetNominalContinuousStates(m_component, states, size), "Failed to get nominal continuous states")
+		PROFILE_END(TRACE_GET_NOMINALS_OF_CONTINUOUS_STATES)
 			logDebug("fmi1GetNominalContinuousStates(size=%d): states=[...]", size);
+		TRACE_CALL(TRACE_GET_NOMINALS_OF_CONTINUOUS_STATES, states, size)
 	}
 
 	void FMU1Model::getDerivatives(double derivatives[], size_t size) {
         s_currentInstance = this;
-		ASSERT_NO_ERROR(fmi1GetDerivatives(m_component, derivatives, size), "Failed to get derivatives")
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi1GetDerivatives(m_component, derivatives, size), "Failed to get derivatives")
+		PROFILE_END(TRACE_GET_DERIVATIVES)
 		logDebug("fmi1GetDerivatives(size=%d): derivatives=[...]", size);
+		TRACE_CALL(TRACE_GET_DERIVATIVES, derivatives, size)
 	}
 
 	bool FMU1Model::completedIntegratorStep() {
         s_currentInstance = this;
 		fmi1Boolean stepEvent;
-		ASSERT_NO_ERROR(fmi1CompletedIntegratorStep(m_component, &stepEvent), "Failed to complete integrator step")
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi1CompletedIntegratorStep(m_component, &stepEvent), "Failed to complete integrator step")
+		PROFILE_END(TRACE_COMPLETED_INTEGRATOR_STEP)
 		logDebug("fmi1CompletedIntegratorStep(): stepEvent=%s", fmi1BooleanToString(stepEvent));
+		TRACE_CALL(TRACE_COMPLETED_INTEGRATOR_STEP, { static_cast<double>(stepEvent), 0.0 })
 		return stepEvent != fmi1False;
 	}
 
 	void FMU1Model::eventUpdate() {
         s_currentInstance = this;
-		ASSERT_NO_ERROR(fmi1EventUpdate(m_component, fmi1False, &m_eventInfo), "Event update failed")
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi1EventUpdate(m_component, fmi1False, &m_eventInfo), "Event update failed")
+		PROFILE_END(TRACE_EVENT_UPDATE)
 		logDebug("fmi1EventUpdate(intermediateResults=false): "
 				"eventInfo.iterationConverged=%s, "
 				"eventInfo.stateValueReferencesChanged=%s, "
@@ -410,12 +673,23 @@ namespace fmikit {
 				fmi1BooleanToString(m_eventInfo.terminateSimulation),
 				fmi1BooleanToString(m_eventInfo.upcomingTimeEvent),
 				m_eventInfo.nextEventTime);
+		TRACE_CALL(TRACE_EVENT_UPDATE, {
+			static_cast<double>(m_eventInfo.iterationConverged),
+			static_cast<double>(m_eventInfo.stateValueReferencesChanged),
+			static_cast<double>(m_eventInfo.stateValuesChanged),
+			static_cast<double>(m_eventInfo.terminateSimulation),
+			static_cast<double>(m_eventInfo.upcomingTimeEvent),
+			m_eventInfo.nextEventTime
+		})
 	}
 
 	void FMU1Model::getEventIndicators(double eventIndicators[], size_t size) {
         s_currentInstance = this;
-		ASSERT_NO_ERROR(fmi1GetEventIndicators(m_component, eventIndicators, size), "Failed to get event indicators")
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi1GetEventIndicators(m_component, eventIndicators, size), "Failed to get event indicators")
+		PROFILE_END(TRACE_GET_EVENT_INDICATORS)
 		logDebug("fmi1GetEventIndicators(size=%d): eventIndicators=[...]", size);
+		TRACE_CALL(TRACE_GET_EVENT_INDICATORS, eventIndicators, size)
     }
 
 }
@@ -4,6 +4,7 @@
  *  root for license information.                                *
  *****************************************************************/
 
+#include <cstring>
 #include <iostream>
 
 #ifndef _WIN32
@@ -12,11 +13,65 @@
 #endif
 
 #include "FMU2.h"
+#include "CallTrace.h"
+#include "CallStatistics.h"
 
 using namespace std;
 
+#define RESOLVE_FUNCTION(f) f = reinterpret_cast<f##TYPE *>(library.symbol(prefix + #f));
+
+#define REQUIRE_FUNCTION(f) if (!m_functions->f) error("Function %s not found in shared library", #f);
+
 namespace fmikit {
 
+	FMU2Functions::FMU2Functions(const SharedLibrary &library, const string &prefix) {
+
+		RESOLVE_FUNCTION(fmi2GetTypesPlatform)
+		RESOLVE_FUNCTION(fmi2GetVersion)
+		RESOLVE_FUNCTION(fmi2SetDebugLogging)
+		RESOLVE_FUNCTION(fmi2Instantiate)
+		RESOLVE_FUNCTION(fmi2FreeInstance)
+		RESOLVE_FUNCTION(fmi2SetupExperiment)
+		RESOLVE_FUNCTION(fmi2EnterInitializationMode)
+		RESOLVE_FUNCTION(fmi2ExitInitializationMode)
+		RESOLVE_FUNCTION(fmi2Terminate)
+		RESOLVE_FUNCTION(fmi2Reset)
+		RESOLVE_FUNCTION(fmi2GetReal)
+		RESOLVE_FUNCTION(fmi2GetInteger)
+		RESOLVE_FUNCTION(fmi2GetBoolean)
+		RESOLVE_FUNCTION(fmi2GetString)
+		RESOLVE_FUNCTION(fmi2SetReal)
+		RESOLVE_FUNCTION(fmi2SetInteger)
+		RESOLVE_FUNCTION(fmi2SetBoolean)
+		RESOLVE_FUNCTION(fmi2SetString)
+		RESOLVE_FUNCTION(fmi2GetFMUstate)
+		RESOLVE_FUNCTION(fmi2SetFMUstate)
+		RESOLVE_FUNCTION(fmi2FreeFMUstate)
+		RESOLVE_FUNCTION(fmi2SerializedFMUstateSize)
+		RESOLVE_FUNCTION(fmi2SerializeFMUstate)
+		RESOLVE_FUNCTION(fmi2DeSerializeFMUstate)
+		RESOLVE_FUNCTION(fmi2GetDirectionalDerivative)
+		RESOLVE_FUNCTION(fmi2SetRealInputDerivatives)
+		RESOLVE_FUNCTION(fmi2GetRealOutputDerivatives)
+		RESOLVE_FUNCTION(fmi2DoStep)
+		RESOLVE_FUNCTION(fmi2CancelStep)
+		RESOLVE_FUNCTION(fmi2GetStatus)
+		RESOLVE_FUNCTION(fmi2GetRealStatus)
+		RESOLVE_FUNCTION(fmi2GetIntegerStatus)
+		RESOLVE_FUNCTION(fmi2GetBooleanStatus)
+		RESOLVE_FUNCTION(fmi2GetStringStatus)
+		RESOLVE_FUNCTION(fmi2EnterEventMode)
+		RESOLVE_FUNCTION(fmi2NewDiscreteStates)
+		RESOLVE_FUNCTION(fmi2EnterContinuousTimeMode)
+		RESOLVE_FUNCTION(fmi2CompletedIntegratorStep)
+		RESOLVE_FUNCTION(fmi2SetTime)
+		RESOLVE_FUNCTION(fmi2SetContinuousStates)
+		RESOLVE_FUNCTION(fmi2GetDerivatives)
+		RESOLVE_FUNCTION(fmi2GetEventIndicators)
+		RESOLVE_FUNCTION(fmi2GetContinuousStates)
+		RESOLVE_FUNCTION(fmi2GetNominalsOfContinuousStates)
+	}
+
 	// bool to fmi2Boolean (== int)
 	static fmi2Boolean btoi(bool value) {
 		return value ? fmi2True : fmi2False;
@@ -29,33 +84,26 @@ namespace fmikit {
 
 		m_fmiVersion = FMI_VERSION_2;
 
-		fmi2GetTypesPlatform			= getFunc<fmi2GetTypesPlatformTYPE>         ("fmi2GetTypesPlatform");
-		fmi2GetVersion					= getFunc<fmi2GetVersionTYPE>               ("fmi2GetVersion");
-		fmi2SetDebugLogging				= getFunc<fmi2SetDebugLoggingTYPE>          ("fmi2SetDebugLogging");
-		fmi2Instantiate					= getFunc<fmi2InstantiateTYPE>              ("fmi2Instantiate");
-		fmi2FreeInstance				= getFunc<fmi2FreeInstanceTYPE>             ("fmi2FreeInstance");
-		fmi2SetupExperiment				= getFunc<fmi2SetupExperimentTYPE>          ("fmi2SetupExperiment");
-		fmi2EnterInitializationMode		= getFunc<fmi2EnterInitializationModeTYPE>  ("fmi2EnterInitializationMode");
-		fmi2ExitInitializationMode		= getFunc<fmi2ExitInitializationModeTYPE>   ("fmi2ExitInitializationMode");
-		fmi2Terminate					= getFunc<fmi2TerminateTYPE>                ("fmi2Terminate");
-		fmi2Reset						= getFunc<fmi2ResetTYPE>                    ("fmi2Reset");
-		fmi2GetReal						= getFunc<fmi2GetRealTYPE>                  ("fmi2GetReal");
-		fmi2GetInteger					= getFunc<fmi2GetIntegerTYPE>               ("fmi2GetInteger");
-		fmi2GetBoolean					= getFunc<fmi2GetBooleanTYPE>               ("fmi2GetBoolean");
-		fmi2GetString					= getFunc<fmi2GetStringTYPE>                ("fmi2GetString");
-		fmi2SetReal						= getFunc<fmi2SetRealTYPE>                  ("fmi2SetReal");
-		fmi2SetInteger					= getFunc<fmi2SetIntegerTYPE>               ("fmi2SetInteger");
-		fmi2SetBoolean					= getFunc<fmi2SetBooleanTYPE>               ("fmi2SetBoolean");
-		fmi2SetString					= getFunc<fmi2SetStringTYPE>                ("fmi2SetString");
-
-		/* FMU state functions (optional) */
-		fmi2GetFMUstate					= getFunc<fmi2GetFMUstateTYPE>				("fmi2GetFMUstate",              false);
-		fmi2SetFMUstate					= getFunc<fmi2SetFMUstateTYPE>				("fmi2SetFMUstate",              false);
-		fmi2FreeFMUstate				= getFunc<fmi2FreeFMUstateTYPE>				("fmi2FreeFMUstate",             false);
-		fmi2SerializedFMUstateSize		= getFunc<fmi2SerializedFMUstateSizeTYPE>	("fmi2SerializedFMUstateSize",   false);
-		fmi2SerializeFMUstate			= getFunc<fmi2SerializeFMUstateTYPE>	    ("fmi2SerializeFMUstate",        false);
-		fmi2DeSerializeFMUstate			= getFunc<fmi2DeSerializeFMUstateTYPE>		("fmi2DeSerializeFMUstate",      false);
-		fmi2GetDirectionalDerivative	= getFunc<fmi2GetDirectionalDerivativeTYPE>	("fmi2GetDirectionalDerivative", false);
+		m_functions = m_library->functions<FMU2Functions>();
+
+		REQUIRE_FUNCTION(fmi2GetTypesPlatform)
+		REQUIRE_FUNCTION(fmi2GetVersion)
+		REQUIRE_FUNCTION(fmi2SetDebugLogging)
+		REQUIRE_FUNCTION(fmi2Instantiate)
+		REQUIRE_FUNCTION(fmi2FreeInstance)
+		REQUIRE_FUNCTION(fmi2SetupExperiment)
+		REQUIRE_FUNCTION(fmi2EnterInitializationMode)
+		REQUIRE_FUNCTION(fmi2ExitInitializationMode)
+		REQUIRE_FUNCTION(fmi2Terminate)
+		REQUIRE_FUNCTION(fmi2Reset)
+		REQUIRE_FUNCTION(fmi2GetReal)
+		REQUIRE_FUNCTION(fmi2GetInteger)
+		REQUIRE_FUNCTION(fmi2GetBoolean)
+		REQUIRE_FUNCTION(fmi2GetString)
+		REQUIRE_FUNCTION(fmi2SetReal)
+		REQUIRE_FUNCTION(fmi2SetInteger)
+		REQUIRE_FUNCTION(fmi2SetBoolean)
+		REQUIRE_FUNCTION(fmi2SetString)
 
 		m_callbackFunctions.logger               = logFMU2Message;
 		m_callbackFunctions.allocateMemory       = allocateMemory ? allocateMemory : calloc;
@@ -65,22 +113,29 @@ namespace fmikit {
 	}
 
 	FMU2::~FMU2() {
+		freeStates();
 		terminate();
 		freeInstance();
 	}
 
 	void FMU2::terminate() {
 		assertState(EventModeState | ContinuousTimeModeState | StepCompleteState | StepFailedState);
-		ASSERT_NO_ERROR(fmi2Terminate(m_component), "Failed to terminate")
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi2Terminate(m_component), "Failed to terminate")
+		PROFILE_END(TRACE_TERMINATE)
 		logDebug("fmi2Terminate()");
+		TRACE_CALL(TRACE_TERMINATE)
 		m_state = TerminatedState;
 	}
 
 	void FMU2::freeInstance() {
 		assertState(InstantiatedState | InitializationModeState | EventModeState | ContinuousTimeModeState
 			| StepCompleteState | StepFailedState | StepCanceledState | TerminatedState | ErrorState);
-		HANDLE_EXCEPTION(fmi2FreeInstance(m_component), "Failed to free instance")
+		PROFILE_BEGIN
+		HANDLE_EXCEPTION(m_functions->fmi2FreeInstance(m_component), "Failed to free instance")
+		PROFILE_END(TRACE_FREE_INSTANCE)
 		logDebug("fmi2FreeInstance()");
+		TRACE_CALL(TRACE_FREE_INSTANCE)
 	}
 
     void FMU2::instantiate(bool loggingOn) {
@@ -92,9 +147,13 @@ namespace fmikit {
 
 	void FMU2::instantiate_(fmi2String instanceName, fmi2Type fmuType, fmi2String fmuGUID, fmi2String fmuResourceLocation, const fmi2CallbackFunctions* functions, fmi2Boolean visible, fmi2Boolean loggingOn) {
 		assertState(StartAndEndState);
-		HANDLE_EXCEPTION(m_component = fmi2Instantiate(instanceName, fmuType, fmuGUID, fmuResourceLocation, functions, visible, loggingOn), "Failed to instantiate FMU")
+		PROFILE_BEGIN
+		HANDLE_EXCEPTION(m_component = m_functions->fmi2Instantiate(instanceName, fmuType, fmuGUID, fmuResourceLocation, functions, visible, loggingOn), "Failed to instantiate FMU")
+		PROFILE_END(TRACE_INSTANTIATE)
 		logDebug("fmi2Instantiate(instanceName=\"%s\", fmuType=%d, fmuGUID=\"%s\", fmuResourceLocation=\"%s\", visible=%d, loggingOn=%d)",
 		instanceName, fmuType, fmuGUID, fmuResourceLocation, visible, loggingOn);
+		m_status = m_component ? fmi2OK : fmi2Error;
+		TRACE_CALL(TRACE_INSTANTIATE, { static_cast<double>(loggingOn) })
 		if (!m_component) error("Failed to instantiate FMU");
 		m_state = InstantiatedState;
 	}
@@ -106,22 +165,31 @@ namespace fmikit {
 		this->m_stopTime = stopTime;
 
 		m_time = startTime;
-		ASSERT_NO_ERROR(fmi2SetupExperiment(m_component, toleranceDefined, tolerance, startTime, stopTimeDefined, stopTime), "Failed to set up experiment")
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi2SetupExperiment(m_component, toleranceDefined, tolerance, startTime, stopTimeDefined, stopTime), "Failed to set up experiment")
+		PROFILE_END(TRACE_SETUP_EXPERIMENT)
 		logDebug("fmi2SetupExperiment(toleranceDefined=%d, tolerance=%f, startTime=%f, stopTimeDefined=%d, stopTime=%f)",
 			toleranceDefined, tolerance, startTime, stopTimeDefined, stopTime);
+		TRACE_CALL(TRACE_SETUP_EXPERIMENT, { static_cast<double>(toleranceDefined), tolerance, startTime, static_cast<double>(stopTimeDefined), stopTime })
 	}
 
 	void FMU2::enterInitializationMode() {
 		assertState(InstantiatedState);
 		logDebug("fmi2EnterInitializationMode()");
-		ASSERT_NO_ERROR(fmi2EnterInitializationMode(m_component), "Failed to enter initialization mode")
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi2EnterInitializationMode(m_component), "Failed to enter initialization mode")
+		PROFILE_END(TRACE_ENTER_INITIALIZATION_MODE)
+		TRACE_CALL(TRACE_ENTER_INITIALIZATION_MODE)
 		m_state = InitializationModeState;
 	}
 
 	void FMU2::exitInitializationMode() {
 		assertState(InitializationModeState);
 		logDebug("fmi2ExitInitializationMode()");
-		ASSERT_NO_ERROR(fmi2ExitInitializationMode(m_component), "Failed to exit initialization mode")
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi2ExitInitializationMode(m_component), "Failed to exit initialization mode")
+		PROFILE_END(TRACE_EXIT_INITIALIZATION_MODE)
+		TRACE_CALL(TRACE_EXIT_INITIALIZATION_MODE)
 		m_state = (m_kind == MODEL_EXCHANGE) ? EventModeState : StepCompleteState;
 	}
 
@@ -141,57 +209,287 @@ namespace fmikit {
 	}
 
 	void FMU2::assertNoError(fmi2Status status, const char *message) {
+		m_status = status;
 		if (status >= fmi2Error) error(message);
 	}
 
 	double FMU2::getReal(const ValueReference vr) {
 		fmi2Real value;
-		assertNoError(fmi2GetReal(m_component, &vr, 1, &value), "Failed to get Real");
+		PROFILE_BEGIN
+		assertNoError(m_functions->fmi2GetReal(m_component, &vr, 1, &value), "Failed to get Real");
+		PROFILE_END(TRACE_GET_REAL)
 		logDebug("fmi2GetReal(vr=[%d], nvr=1): value=[%.16g]", vr, value);
+		TRACE_CALL(TRACE_GET_REAL, &vr, 1, &value)
 		return value;
 	}
 
 	int FMU2::getInteger(ValueReference vr) {
 		fmi2Integer value;
-		assertNoError(fmi2GetInteger(m_component, &vr, 1, &value), "Failed to get Integer");
+		PROFILE_BEGIN
+		assertNoError(m_functions->fmi2GetInteger(m_component, &vr, 1, &value), "Failed to get Integer");
+		PROFILE_END(TRACE_GET_INTEGER)
 		logDebug("fmi2GetInteger(vr=[%d], nvr=1): value=[%d]", vr, value);
+		TRACE_CALL(TRACE_GET_INTEGER, &vr, 1, &value)
 		return value;
 	}
 
 	bool FMU2::getBoolean(ValueReference vr) {
 		fmi2Boolean value;
-		assertNoError(fmi2GetBoolean(m_component, &vr, 1, &value), "Failed to get Boolean");
+		PROFILE_BEGIN
+		assertNoError(m_functions->fmi2GetBoolean(m_component, &vr, 1, &value), "Failed to get Boolean");
+		PROFILE_END(TRACE_GET_BOOLEAN)
 		logDebug("fmi2GetBoolean(vr=[%d], nvr=1): value=[%d]", vr, value);
-		return value != fmi2False;
+		const bool b = value != fmi2False;
+		TRACE_CALL(TRACE_GET_BOOLEAN, &vr, 1, &b)
+		return b;
 	}
 
 	string FMU2::getString(ValueReference vr) {
 		fmi2String value;
-		assertNoError(fmi2GetString(m_component, &vr, 1, &value), "Failed to get String");
+		PROFILE_BEGIN
+		assertNoError(m_functions->fmi2GetString(m_component, &vr, 1, &value), "Failed to get String");
+		PROFILE_END(TRACE_GET_STRING)
 		logDebug("fmi2GetString(vr=[%d], nvr=1): value=[\"%s\"]", vr, value);
+		TRACE_CALL(TRACE_GET_STRING, &vr, 1, &value)
 		return value;
 	}
 
 	void FMU2::setReal(const ValueReference vr, double value) {
-		assertNoError(fmi2SetReal(m_component, &vr, 1, &value), "Failed to set Real");
+		PROFILE_BEGIN
+		assertNoError(m_functions->fmi2SetReal(m_component, &vr, 1, &value), "Failed to set Real");
+		PROFILE_END(TRACE_SET_REAL)
 		logDebug("fmi2SetReal(vr=[%d], nvr=1, value=[%.16g])", vr, value);
+		TRACE_CALL(TRACE_SET_REAL, &vr, 1, &value)
 	}
 
 	void FMU2::setInteger(ValueReference vr, int value) {
-		assertNoError(fmi2SetInteger(m_component, &vr, 1, &value), "Failed to set Integer value");
+		PROFILE_BEGIN
+		assertNoError(m_functions->fmi2SetInteger(m_component, &vr, 1, &value), "Failed to set Integer value");
+		PROFILE_END(TRACE_SET_INTEGER)
 		logDebug("fmi2SetInteger(vr=[%d], nvr=1, value=[%d])", vr, value);
+		TRACE_CALL(TRACE_SET_INTEGER, &vr, 1, &value)
 	}
 
 	void FMU2::setBoolean(ValueReference vr, bool value) {
 		fmi2Boolean v = value ? fmi2True : fmi2False;
-		assertNoError(fmi2SetBoolean(m_component, &vr, 1, &v), "Failed to set Boolean value");
+		PROFILE_BEGIN
+		assertNoError(m_functions->fmi2SetBoolean(m_component, &vr, 1, &v), "Failed to set Boolean value");
+		PROFILE_END(TRACE_SET_BOOLEAN)
 		logDebug("fmi2SetBoolean(vr=[%d], nvr=1, value=[%d])", vr, v);
+		TRACE_CALL(TRACE_SET_BOOLEAN, &vr, 1, &value)
 	}
 
 	void FMU2::setString(ValueReference vr, string value) {
 		fmi2String s = value.c_str();
-		assertNoError(fmi2SetString(m_component, &vr, 1, &s), "Failed to set String");
+		PROFILE_BEGIN
+		assertNoError(m_functions->fmi2SetString(m_component, &vr, 1, &s), "Failed to set String");
+		PROFILE_END(TRACE_SET_STRING)
 		logDebug("fmi2SetString(vr=[%d], nvr=1, value=[\"%s\"])", vr, s);
+		TRACE_CALL(TRACE_SET_STRING, &vr, 1, &s)
+	}
+
+	void FMU2::getReal(const ValueReference vr[], size_t nvr, double value[]) {
+		if (nvr < 1) return; // nothing to do
+		PROFILE_BEGIN
+		assertNoError(m_functions->fmi2GetReal(m_component, vr, nvr, value), "Failed to get Real");
+		PROFILE_END(TRACE_GET_REAL)
+		logGetReal("fmi2GetReal", vr, nvr, value);
+		TRACE_CALL(TRACE_GET_REAL, vr, nvr, value)
+	}
+
+	void FMU2::getDirectionalDerivative(const ValueReference vUnknown[], size_t nUnknown, const ValueReference vKnown[], size_t nKnown, const double dvKnown[], double dvUnknown[]) {
+		if (!m_functions->fmi2GetDirectionalDerivative) error("fmi2GetDirectionalDerivative is not provided by the FMU");
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi2GetDirectionalDerivative(m_component, vUnknown, nUnknown, vKnown, nKnown, dvKnown, dvUnknown), "Failed to get directional derivative")
+		PROFILE_END(TRACE_GET_DIRECTIONAL_DERIVATIVE)
+		logDebug("fmi2GetDirectionalDerivative(vUnknown_ref=[...], nUnknown=%zu, vKnown_ref=[...], nKnown=%zu, dvKnown=[...], dvUnknown=[...])", nUnknown, nKnown);
+		TRACE_CALL(TRACE_GET_DIRECTIONAL_DERIVATIVE, vUnknown, nUnknown, dvUnknown)
+	}
+
+	FMU2::StateSlot &FMU2::stateSlot(size_t slot) {
+		if (slot >= m_stateSlots.size() || !m_stateSlots[slot].used) error("Invalid FMU state slot %d", static_cast<int>(slot));
+		return m_stateSlots[slot];
+	}
+
+	size_t FMU2::saveState() {
+
+		size_t slot;
+
+		if (m_freeStateSlots.empty()) {
+			slot = m_stateSlots.size();
+			m_stateSlots.push_back(StateSlot());
+		} else {
+			slot = m_freeStateSlots.back();
+			m_freeStateSlots.pop_back();
+		}
+
+		m_stateSlots[slot].used = true;
+
+		try {
+			saveState(slot);
+		} catch (...) {
+			releaseState(slot);
+			throw;
+		}
+
+		return slot;
+	}
+
+	void FMU2::saveState(size_t slot) {
+		if (!canGetAndSetFMUstate()) error("fmi2GetFMUstate is not provided by the FMU");
+		assertState(InstantiatedState | fmi2GetXMask);
+		auto &s = stateSlot(slot);
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi2GetFMUstate(m_component, &s.state), "Failed to get FMU state")
+		PROFILE_END(TRACE_GET_FMU_STATE)
+		logDebug("fmi2GetFMUstate(FMUstate=%p)", s.state);
+		TRACE_CALL(TRACE_GET_FMU_STATE, { static_cast<double>(slot) })
+		s.time = m_time;
+	}
+
+	void FMU2::restoreState(size_t slot) {
+		if (!canGetAndSetFMUstate()) error("fmi2SetFMUstate is not provided by the FMU");
+		assertState(InstantiatedState | fmi2GetXMask);
+		auto &s = stateSlot(slot);
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi2SetFMUstate(m_component, s.state), "Failed to set FMU state")
+		PROFILE_END(TRACE_SET_FMU_STATE)
+		logDebug("fmi2SetFMUstate(FMUstate=%p)", s.state);
+		m_time = s.time;
+		TRACE_CALL(TRACE_SET_FMU_STATE, { static_cast<double>(slot) })
+	}
+
+	void FMU2::releaseState(size_t slot) {
+		stateSlot(slot).used = false;
+		m_freeStateSlots.push_back(slot);
+	}
+
+	// header of a serialized state
+	struct SerializedStateHeader {
+		double time;
+	};
+
+	void FMU2::serializeState(size_t slot, vector<char> &data) {
+
+		if (!canSerializeFMUstate()) error("fmi2SerializeFMUstate is not provided by the FMU");
+
+		auto &s = stateSlot(slot);
+
+		size_t size = 0;
+		ASSERT_NO_ERROR(m_functions->fmi2SerializedFMUstateSize(m_component, s.state, &size), "Failed to get serialized FMU state size")
+		logDebug("fmi2SerializedFMUstateSize(FMUstate=%p, size=%d)", s.state, static_cast<int>(size));
+
+		data.resize(sizeof(SerializedStateHeader) + size);
+
+		SerializedStateHeader header;
+		header.time = s.time;
+		memcpy(data.data(), &header, sizeof(header));
+
+		ASSERT_NO_ERROR(m_functions->fmi2SerializeFMUstate(m_component, s.state, data.data() + sizeof(header), size), "Failed to serialize FMU state")
+		logDebug("fmi2SerializeFMUstate(FMUstate=%p, serializedState=[...], size=%d)", s.state, static_cast<int>(size));
+	}
+
+	size_t FMU2::deserializeState(const char data[], size_t size) {
+
+		if (!canSerializeFMUstate()) error("fmi2DeSerializeFMUstate is not provided by the FMU");
+
+		if (size < sizeof(SerializedStateHeader)) error("Serialized FMU state is too short");
+
+		SerializedStateHeader header;
+		memcpy(&header, data, sizeof(header));
+
+		if (m_freeStateSlots.empty()) {
+			m_freeStateSlots.push_back(m_stateSlots.size());
+			m_stateSlots.push_back(StateSlot());
+		}
+
+		// the slot is taken from the pool when the state has been deserialized
+		const auto slot = m_freeStateSlots.back();
+
+		auto &s = m_stateSlots[slot];
+
+		// fmi2DeSerializeFMUstate() creates a new state, so the state of a released slot is freed
+		fmi2FMUstate state = nullptr;
+
+		ASSERT_NO_ERROR(m_functions->fmi2DeSerializeFMUstate(m_component, data + sizeof(header), size - sizeof(header), &state), "Failed to deserialize FMU state")
+
+		if (s.state) {
+			m_functions->fmi2FreeFMUstate(m_component, &s.state);
+			logDebug("fmi2FreeFMUstate()");
+		}
+
+		s.state = state;
+
+		m_freeStateSlots.pop_back();
+
+		s.used = true;
+
+		logDebug("fmi2DeSerializeFMUstate(serializedState=[...], size=%d, FMUstate=%p)", static_cast<int>(size - sizeof(header)), s.state);
+
+		s.time = header.time;
+
+		return slot;
+	}
+
+	void FMU2::freeStates() {
+
+		for (auto &s : m_stateSlots) {
+			if (!s.state) continue;
+			m_functions->fmi2FreeFMUstate(m_component, &s.state);
+			logDebug("fmi2FreeFMUstate()");
+		}
+
+		m_stateSlots.clear();
+		m_freeStateSlots.clear();
+	}
+
+	void FMU2::getInteger(const ValueReference vr[], size_t nvr, int value[]) {
+		if (nvr < 1) return; // nothing to do
+		PROFILE_BEGIN
+		assertNoError(m_functions->fmi2GetInteger(m_component, vr, nvr, value), "Failed to get Integer");
+		PROFILE_END(TRACE_GET_INTEGER)
+		logGetInteger("fmi2GetInteger", vr, nvr, value);
+		TRACE_CALL(TRACE_GET_INTEGER, vr, nvr, value)
+	}
+
+	void FMU2::getBoolean(const ValueReference vr[], size_t nvr, bool value[]) {
+		if (nvr < 1) return; // nothing to do
+		if (m_booleanBuffer.size() < nvr) m_booleanBuffer.resize(nvr);
+		PROFILE_BEGIN
+		assertNoError(m_functions->fmi2GetBoolean(m_component, vr, nvr, m_booleanBuffer.data()), "Failed to get Boolean");
+		PROFILE_END(TRACE_GET_BOOLEAN)
+		for (size_t i = 0; i < nvr; i++) value[i] = m_booleanBuffer[i] != fmi2False;
+		logGetBoolean("fmi2GetBoolean", vr, nvr, value);
+		TRACE_CALL(TRACE_GET_BOOLEAN, vr, nvr, value)
+	}
+
+	void FMU2::setReal(const ValueReference vr[], size_t nvr, const double value[]) {
+		if (nvr < 1) return; // nothing to do
+		PROFILE_BEGIN
+		assertNoError(m_functions->fmi2SetReal(m_component, vr, nvr, value), "Failed to set Real");
+		PROFILE_END(TRACE_SET_REAL)
+		logSetReal("fmi2SetReal", vr, nvr, value);
+		TRACE_CALL(TRACE_SET_REAL, vr, nvr, value)
+	}
+
+	void FMU2::setInteger(const ValueReference vr[], size_t nvr, const int value[]) {
+		if (nvr < 1) return; // nothing to do
+		PROFILE_BEGIN
+		assertNoError(m_functions->fmi2SetInteger(m_component, vr, nvr, value), "Failed to set Integer value");
+		PROFILE_END(TRACE_SET_INTEGER)
+		logSetInteger("fmi2SetInteger", vr, nvr, value);
+		TRACE_CALL(TRACE_SET_INTEGER, vr, nvr, value)
+	}
+
+	void FMU2::setBoolean(const ValueReference vr[], size_t nvr, const bool value[]) {
+		if (nvr < 1) return; // nothing to do
+		if (m_booleanBuffer.size() < nvr) m_booleanBuffer.resize(nvr);
+		for (size_t i = 0; i < nvr; i++) m_booleanBuffer[i] = btoi(value[i]);
+		PROFILE_BEGIN
+		assertNoError(m_functions->fmi2SetBoolean(m_component, vr, nvr, m_booleanBuffer.data()), "Failed to set Boolean value");
+		PROFILE_END(TRACE_SET_BOOLEAN)
+		logSetBoolean("fmi2SetBoolean", vr, nvr, value);
+		TRACE_CALL(TRACE_SET_BOOLEAN, vr, nvr, value)
 	}
 
 	FMU2Slave::FMU2Slave(const std::string &guid, const std::string &modelIdentifier, const std::string &unzipDirectory, const std::string &instanceName, allocateMemoryCallback *allocateMemory, freeMemoryCallback *freeMemory) :
@@ -199,15 +497,15 @@ namespace fmikit {
 
 		m_kind = CO_SIMULATION;
 
-		fmi2SetRealInputDerivatives			= getFunc<fmi2SetRealInputDerivativesTYPE>  ("fmi2SetRealInputDerivatives");
-		fmi2GetRealOutputDerivatives		= getFunc<fmi2GetRealOutputDerivativesTYPE> ("fmi2GetRealOutputDerivatives");
-		fmi2DoStep							= getFunc<fmi2DoStepTYPE>                   ("fmi2DoStep");
-		fmi2CancelStep						= getFunc<fmi2CancelStepTYPE>               ("fmi2CancelStep");
-		fmi2GetStatus						= getFunc<fmi2GetStatusTYPE>                ("fmi2GetStatus");
-		fmi2GetRealStatus					= getFunc<fmi2GetRealStatusTYPE>            ("fmi2GetRealStatus");
-		fmi2GetIntegerStatus				= getFunc<fmi2GetIntegerStatusTYPE>         ("fmi2GetIntegerStatus");
-		fmi2GetBooleanStatus				= getFunc<fmi2GetBooleanStatusTYPE>         ("fmi2GetBooleanStatus");
-		fmi2GetStringStatus					= getFunc<fmi2GetStringStatusTYPE>          ("fmi2GetStringStatus");
+		REQUIRE_FUNCTION(fmi2SetRealInputDerivatives)
+		REQUIRE_FUNCTION(fmi2GetRealOutputDerivatives)
+		REQUIRE_FUNCTION(fmi2DoStep)
+		REQUIRE_FUNCTION(fmi2CancelStep)
+		REQUIRE_FUNCTION(fmi2GetStatus)
+		REQUIRE_FUNCTION(fmi2GetRealStatus)
+		REQUIRE_FUNCTION(fmi2GetIntegerStatus)
+		REQUIRE_FUNCTION(fmi2GetBooleanStatus)
+		REQUIRE_FUNCTION(fmi2GetStringStatus)
 	}
 
 	void FMU2Slave::doStep(double h) {
@@ -217,22 +515,32 @@ namespace fmikit {
 			h = m_stopTime - m_time;
 		}
 
-		fmi2Boolean noSetFMUStatePriorToCurrentPoint = fmi2True;
-		ASSERT_NO_ERROR(fmi2DoStep(m_component, m_time, h, noSetFMUStatePriorToCurrentPoint), "Failed to do step")
+		// saved states can be restored to earlier time points
+		fmi2Boolean noSetFMUStatePriorToCurrentPoint = hasSavedStates() ? fmi2False : fmi2True;
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi2DoStep(m_component, m_time, h, noSetFMUStatePriorToCurrentPoint), "Failed to do step")
+		PROFILE_END(TRACE_DO_STEP)
 		logDebug("fmi2DoStep(currentCommunicationPoint=%f, communicationStepSize=%f, noSetFMUStatePriorToCurrentPoint=%d)", m_time, h, noSetFMUStatePriorToCurrentPoint);
+		TRACE_CALL(TRACE_DO_STEP, { m_time, h })
 
 		m_time += h;
 	}
 
 	void FMU2Slave::setRealInputDerivative(ValueReference vr, int order, double value) {
-		ASSERT_NO_ERROR(fmi2SetRealInputDerivatives(m_component, &vr, 1, &order, &value), "Failed to set real input derivatives")
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi2SetRealInputDerivatives(m_component, &vr, 1, &order, &value), "Failed to set real input derivatives")
+		PROFILE_END(TRACE_SET_REAL_INPUT_DERIVATIVES)
 		logDebug("fmi2SetRealInputDerivatives(component, vr=[%d], nvr=1, order=[%d], value=[%.16g])", vr, order, value);
+		TRACE_CALL(TRACE_SET_REAL_INPUT_DERIVATIVES, &vr, 1, { static_cast<double>(order), value })
 	}
 
 	bool FMU2Slave::terminated() {
 		fmi2Boolean status;
 		// TODO: logDebug(...)
-		ASSERT_NO_ERROR(fmi2GetBooleanStatus(m_component, fmi2Terminated, &status), "Failed to get boolean status")
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi2GetBooleanStatus(m_component, fmi2Terminated, &status), "Failed to get boolean status")
+		PROFILE_END(TRACE_GET_BOOLEAN_STATUS)
+		TRACE_CALL(TRACE_GET_BOOLEAN_STATUS, { static_cast<double>(status) })
 		return status != fmi2False;
 	}
 
@@ -248,16 +556,16 @@ namespace fmikit {
 		m_eventInfo.nextEventTimeDefined              = fmi2False;
 		m_eventInfo.nextEventTime                     = 0.0;
 
-		fmi2EnterEventMode					= getFunc<fmi2EnterEventModeTYPE>                ("fmi2EnterEventMode");
-		fmi2NewDiscreteStates				= getFunc<fmi2NewDiscreteStatesTYPE>             ("fmi2NewDiscreteStates");
-		fmi2EnterContinuousTimeMode			= getFunc<fmi2EnterContinuousTimeModeTYPE>       ("fmi2EnterContinuousTimeMode");
-		fmi2CompletedIntegratorStep			= getFunc<fmi2CompletedIntegratorStepTYPE>       ("fmi2CompletedIntegratorStep");
-		fmi2SetTime							= getFunc<fmi2SetTimeTYPE>                       ("fmi2SetTime");
-		fmi2SetContinuousStates				= getFunc<fmi2SetContinuousStatesTYPE>           ("fmi2SetContinuousStates");
-		fmi2GetDerivatives					= getFunc<fmi2GetDerivativesTYPE>                ("fmi2GetDerivatives");
-		fmi2GetEventIndicators				= getFunc<fmi2GetEventIndicatorsTYPE>            ("fmi2GetEventIndicators");
-		fmi2GetContinuousStates				= getFunc<fmi2GetContinuousStatesTYPE>           ("fmi2GetContinuousStates");
-		fmi2GetNominalsOfContinuousStates	= getFunc<fmi2GetNominalsOfContinuousStatesTYPE> ("fmi2GetNominalsOfContinuousStates");
+		REQUIRE_FUNCTION(fmi2EnterEventMode)
+		REQUIRE_FUNCTION(fmi2NewDiscreteStates)
+		REQUIRE_FUNCTION(fmi2EnterContinuousTimeMode)
+		REQUIRE_FUNCTION(fmi2CompletedIntegratorStep)
+		REQUIRE_FUNCTION(fmi2SetTime)
+		REQUIRE_FUNCTION(fmi2SetContinuousStates)
+		REQUIRE_FUNCTION(fmi2GetDerivatives)
+		REQUIRE_FUNCTION(fmi2GetEventIndicators)
+		REQUIRE_FUNCTION(fmi2GetContinuousStates)
+		REQUIRE_FUNCTION(fmi2GetNominalsOfContinuousStates)
 	}
 
 
@@ -287,64 +595,102 @@ namespace fmikit {
 
 	void FMU2Model::newDiscreteStates() {
 		logDebug("fmi2NewDiscreteStates()");
-		ASSERT_NO_ERROR(fmi2NewDiscreteStates(m_component, &m_eventInfo), "Failed to calculate new discrete states")
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi2NewDiscreteStates(m_component, &m_eventInfo), "Failed to calculate new discrete states")
+		PROFILE_END(TRACE_NEW_DISCRETE_STATES)
+		TRACE_CALL(TRACE_NEW_DISCRETE_STATES, {
+			static_cast<double>(m_eventInfo.newDiscreteStatesNeeded),
+			static_cast<double>(m_eventInfo.terminateSimulation),
+			static_cast<double>(m_eventInfo.nominalsOfContinuousStatesChanged),
+			static_cast<double>(m_eventInfo.valuesOfContinuousStatesChanged),
+			static_cast<double>(m_eventInfo.nextEventTimeDefined),
+			m_eventInfo.nextEventTime
+		})
 	}
 
 	void FMU2Model::enterContinuousTimeMode() {
 		logDebug("fmi2EnterContinuousTimeMode()");
-		ASSERT_NO_ERROR(fmi2EnterContinuousTimeMode(m_component), "Failed to enter continuous time mode")
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi2EnterContinuousTimeMode(m_component), "Failed to enter continuous time mode")
+		PROFILE_END(TRACE_ENTER_CONTINUOUS_TIME_MODE)
+		TRACE_CALL(TRACE_ENTER_CONTINUOUS_TIME_MODE)
 		m_state = ContinuousTimeModeState;
 	}
 
 	void FMU2Model::getContinuousStates(double x[], size_t nx) {
 		if (nx < 1) return; // nothing to do
-		ASSERT_NO_ERROR(fmi2GetContinuousStates(m_component, x, nx), "Failed to get continuous states")
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi2GetContinuousStates(m_component, x, nx), "Failed to get continuous states")
+		PROFILE_END(TRACE_GET_CONTINUOUS_STATES)
 		logDebug("fmi2GetContinuousStates(x=[...], nx=%d)", nx);
+		TRACE_CALL(TRACE_GET_CONTINUOUS_STATES, x, nx)
 	}
 
 	void FMU2Model::getNominalContinuousStates(double x[], size_t nx) {
 		if (nx < 1) return; // nothing to do
-		ASSERT_NO_ERROR(fmi2GetNominalsOfContinuousStates(m_component, x, nx), "Failed to get nominal continuous states")
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi2GetNominalsOfContinuousStates(m_component, x, nx), "Failed to get nominal continuous states")
+		PROFILE_END(TRACE_GET_NOMINALS_OF_CONTINUOUS_STATES)
 			logDebug("fmi2GetNominalsOfContinuousStates(x=[...], nx=%d)", nx);
+		TRACE_CALL(TRACE_GET_NOMINALS_OF_CONTINUOUS_STATES, x, nx)
 	}
 
 	void FMU2Model::getDerivatives(double derivatives[], size_t nx) {
-		ASSERT_NO_ERROR(fmi2GetDerivatives(m_component, derivatives, nx), "Failed to get derivatives")
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi2GetDerivatives(m_component, derivatives, nx), "Failed to get derivatives")
+		PROFILE_END(TRACE_GET_DERIVATIVES)
 		logDebug("fmi2GetDerivatives(derivatives=[...], nx=%d)", nx);
+		TRACE_CALL(TRACE_GET_DERIVATIVES, derivatives, nx)
 	}
 
 	void FMU2Model::getEventIndicators(double indicators[], size_t ni) {
-		ASSERT_NO_ERROR(fmi2GetEventIndicators(m_component, indicators, ni), "Failed to get event indicators")
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi2GetEventIndicators(m_component, indicators, ni), "Failed to get event indicators")
+		PROFILE_END(TRACE_GET_EVENT_INDICATORS)
 		logDebug("fmi2GetEventIndicators(indicators=[...], ni=%d)", ni);
+		TRACE_CALL(TRACE_GET_EVENT_INDICATORS, indicators, ni)
 	}
 
 	void FMU2Model::setTime(double time) {
-		ASSERT_NO_ERROR(fmi2SetTime(m_component, time), "Failed to set time")
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi2SetTime(m_component, time), "Failed to set time")
+		PROFILE_END(TRACE_SET_TIME)
 		logDebug("fmi2SetTime(time=%.16g)", time);
 		this->m_time = time;
+		TRACE_CALL(TRACE_SET_TIME, { time })
 	}
 
 	void FMU2Model::setContinuousStates(const double x[], size_t nx) {
 		if (nx < 1) return; // nothing to do
-		ASSERT_NO_ERROR(fmi2SetContinuousStates(m_component, x, nx), "Failed to set continuous states")
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi2SetContinuousStates(m_component, x, nx), "Failed to set continuous states")
+		PROFILE_END(TRACE_SET_CONTINUOUS_STATES)
 		logDebug("fmi2SetContinuousStates(x=[...], nx=%d)", nx);
+		TRACE_CALL(TRACE_SET_CONTINUOUS_STATES, x, nx)
 	}
 
 	bool FMU2Model::completedIntegratorStep() {
-		fmi2Boolean noSetFMUStatePriorToCurrentPoint = fmi2True;
+		// saved states can be restored to earlier time points
+		fmi2Boolean noSetFMUStatePriorToCurrentPoint = hasSavedStates() ? fmi2False : fmi2True;
 		fmi2Boolean enterEventMode;
 
-		ASSERT_NO_ERROR(fmi2CompletedIntegratorStep(m_component, noSetFMUStatePriorToCurrentPoint, &enterEventMode, &m_eventInfo.terminateSimulation),
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi2CompletedIntegratorStep(m_component, noSetFMUStatePriorToCurrentPoint, &enterEventMode, &m_eventInfo.terminateSimulation),
 			"Failed to complete integrator step")
+		PROFILE_END(TRACE_COMPLETED_INTEGRATOR_STEP)
 
-		logDebug("fmi2CompletedIntegratorStep(noSetFMUStatePriorToCurrentPoint=fmi2True): enterEventMode=%d, terminateSimulation=%d", enterEventMode, m_eventInfo.terminateSimulation);
+		logDebug("fmi2CompletedIntegratorStep(noSetFMUStatePriorToCurrentPoint=%d): enterEventMode=%d, terminateSimulation=%d", noSetFMUStatePriorToCurrentPoint, enterEventMode, m_eventInfo.terminateSimulation);
+		TRACE_CALL(TRACE_COMPLETED_INTEGRATOR_STEP, { static_cast<double>(enterEventMode), static_cast<double>(m_eventInfo.terminateSimulation) })
 
 		return enterEventMode != fmi2False;
 	}
 
 	void FMU2Model::enterEventMode() {
-		ASSERT_NO_ERROR(fmi2EnterEventMode(m_component), "Failed to enter event mode")
+		PROFILE_BEGIN
+		ASSERT_NO_ERROR(m_functions->fmi2EnterEventMode(m_component), "Failed to enter event mode")
+		PROFILE_END(TRACE_ENTER_EVENT_MODE)
 		logDebug("fmi2EnterEventMode()");
+		TRACE_CALL(TRACE_ENTER_EVENT_MODE)
 		m_state = EventModeState;
 	}
 
@@ -0,0 +1,685 @@
+/*****************************************************************
+ *  Copyright (c) Dassault Systemes. All rights reserved.        *
+ *  This file is part of FMIKit. See LICENSE.txt in the project  *
+ *  root for license information.                                *
+ *****************************************************************/
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <stdexcept> // for runtime_error
+
+#include "ModelDescription.h"
+
+using namespace std;
+
+namespace fmikit {
+
+	static const size_t UNRESOLVED = numeric_limits<size_t>::max();
+
+	static bool isSpace(char c) {
+		return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+	}
+
+	// first occurrence of s in [p, end) or nullptr
+	static char *find(char *p, const char *end, const char *s) {
+
+		const auto n = strlen(s);
+
+		while (p + n <= end) {
+			p = static_cast<char *>(memchr(p, s[0], end - p));
+			if (!p || p + n > end) return nullptr;
+			if (memcmp(p, s, n) == 0) return p;
+			p++;
+		}
+
+		return nullptr;
+	}
+
+	static void appendUTF8(char *&out, unsigned long c) {
+		if (c < 0x80) {
+			*out++ = static_cast<char>(c);
+		} else if (c < 0x800) {
+			*out++ = static_cast<char>(0xC0 | (c >> 6));
+			*out++ = static_cast<char>(0x80 | (c & 0x3F));
+		} else if (c < 0x10000) {
+			*out++ = static_cast<char>(0xE0 | (c >> 12));
+			*out++ = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+			*out++ = static_cast<char>(0x80 | (c & 0x3F));
+		} else {
+			*out++ = static_cast<char>(0xF0 | (c >> 18));
+			*out++ = static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+			*out++ = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+			*out++ = static_cast<char>(0x80 | (c & 0x3F));
+		}
+	}
+
+	// replaces the entity and character references in the null-terminated string s (the result is never longer)
+	static void decode(char *s) {
+
+		char *in = strchr(s, '&');
+
+		if (!in) return;
+
+		char *out = in;
+
+		while (*in) {
+
+			if (*in != '&') {
+				*out++ = *in++;
+				continue;
+			}
+
+			if (strncmp(in, "&lt;", 4) == 0) {
+				*out++ = '<'; in += 4;
+			} else if (strncmp(in, "&gt;", 4) == 0) {
+				*out++ = '>'; in += 4;
+			} else if (strncmp(in, "&amp;", 5) == 0) {
+				*out++ = '&'; in += 5;
+			} else if (strncmp(in, "&quot;", 6) == 0) {
+				*out++ = '"'; in += 6;
+			} else if (strncmp(in, "&apos;", 6) == 0) {
+				*out++ = '\''; in += 6;
+			} else if (in[1] == '#') {
+				char *end;
+				const auto c = in[2] == 'x' ? strtoul(in + 3, &end, 16) : strtoul(in + 2, &end, 10);
+				if (*end != ';') throw runtime_error("Invalid character reference in model description");
+				appendUTF8(out, c);
+				in = end + 1;
+			} else {
+				throw runtime_error("Invalid entity reference in model description");
+			}
+		}
+
+		*out = '\0';
+	}
+
+	static double toDouble(const char *value) {
+		return strtod(value, nullptr);
+	}
+
+	static size_t toSize(const char *value) {
+		return static_cast<size_t>(strtoul(value, nullptr, 10));
+	}
+
+	static bool toBool(const char *value) {
+		return strcmp(value, "true") == 0 || strcmp(value, "1") == 0;
+	}
+
+	/* Non-validating in-situ XML parser that fills the model description from the start and end tags
+	   (and the text of <Name> in FMI 1.0). Names and values are null-terminated in the buffer. */
+	class ModelDescription::Parser {
+
+	public:
+		explicit Parser(ModelDescription &md) : m(md) {}
+
+		void parse(char *p, char *end) {
+
+			while (p < end) {
+
+				if (*p != '<') {
+					auto lt = static_cast<char *>(memchr(p, '<', end - p));
+					if (!lt) lt = end;
+					if (m_inName) m_text.append(p, lt);
+					p = lt;
+					continue;
+				}
+
+				if (end - p >= 2 && p[1] == '?') {
+					p = skip(p, end, "?>");
+				} else if (end - p >= 4 && strncmp(p, "<!--", 4) == 0) {
+					p = skip(p, end, "-->");
+				} else if (end - p >= 9 && strncmp(p, "<![CDATA[", 9) == 0) {
+					auto close = find(p + 9, end, "]]>");
+					if (!close) throw runtime_error("Unterminated CDATA section in model description");
+					if (m_inName) m_text.append(p + 9, close);
+					p = close + 3;
+				} else if (end - p >= 2 && p[1] == '!') {
+					p = skip(p, end, ">");
+				} else if (end - p >= 2 && p[1] == '/') {
+					auto gt = static_cast<char *>(memchr(p, '>', end - p));
+					if (!gt) throw runtime_error("Unterminated end tag in model description");
+					char *name = p + 2;
+					char *nameEnd = name;
+					while (nameEnd < gt && !isSpace(*nameEnd)) nameEnd++;
+					*nameEnd = '\0';
+					endElement(name);
+					p = gt + 1;
+				} else {
+					p = startTag(p + 1, end);
+				}
+			}
+
+			if (m_depth != 0) throw runtime_error("Unexpected end of model description");
+		}
+
+	private:
+		struct Attribute {
+			const char *name;
+			char *value;
+		};
+
+		ModelDescription &m;
+
+		vector<Attribute> m_attributes;
+		int m_depth = 0;
+		int m_skipDepth = 0;              // depth of the skipped element (e.g. <TypeDefinitions>) or 0
+		size_t m_variable = UNRESOLVED;   // index of the current <ScalarVariable>
+		vector<Unknown> *m_unknowns = nullptr;
+		bool m_inName = false;
+		string m_text;
+
+		// FMI 1.0 direct dependencies (position in m.m_dependencies and variable name)
+		vector<pair<size_t, string>> m_dependencyNames;
+
+		// decoded and trimmed text of the current element
+		string text() {
+			m_text.push_back('\0');
+			decode(&m_text[0]);
+			const char *begin = m_text.c_str();
+			const char *end = begin + strlen(begin);
+			while (begin < end && isSpace(*begin)) begin++;
+			while (end > begin && isSpace(end[-1])) end--;
+			return string(begin, end);
+		}
+
+		static char *skip(char *p, char *end, const char *terminator) {
+			auto q = find(p, end, terminator);
+			if (!q) throw runtime_error("Unterminated markup in model description");
+			return q + strlen(terminator);
+		}
+
+		// parses a start tag from the name and returns the position after the tag
+		char *startTag(char *p, char *end) {
+
+			char *name = p;
+
+			while (p < end && !isSpace(*p) && *p != '/' && *p != '>') p++;
+
+			if (p == end) throw runtime_error("Unterminated start tag in model description");
+
+			char delimiter = *p;
+			*p++ = '\0';
+
+			m_attributes.clear();
+
+			bool empty = false;
+
+			for (;;) {
+
+				if (delimiter == '>') break;
+
+				if (delimiter == '/') {
+					if (p == end || *p != '>') throw runtime_error("Invalid start tag in model description");
+					p++;
+					empty = true;
+					break;
+				}
+
+				while (p < end && isSpace(*p)) p++;
+
+				if (p == end) throw runtime_error("Unterminated start tag in model description");
+
+				if (*p == '/' || *p == '>') {
+					delimiter = *p++;
+					continue;
+				}
+
+				// attribute
+				char *attributeName = p;
+
+				while (p < end && *p != '=' && !isSpace(*p)) p++;
+
+				char *nameEnd = p;
+
+				while (p < end && isSpace(*p)) p++;
+
+				if (p == end || *p != '=') throw runtime_error("Invalid attribute in model description");
+
+				p++;
+
+				while (p < end && isSpace(*p)) p++;
+
+				if (p == end || (*p != '"' && *p != '\'')) throw runtime_error("Invalid attribute in model description");
+
+				const char quote = *p++;
+
+				auto close = static_cast<char *>(memchr(p, quote, end - p));
+
+				if (!close) throw runtime_error("Unterminated attribute value in model description");
+
+				*nameEnd = '\0';
+				*close = '\0';
+				decode(p);
+
+				m_attributes.push_back({ attributeName, p });
+
+				p = close + 1;
+
+				if (p < end && !isSpace(*p) && *p != '/' && *p != '>') throw runtime_error("Invalid start tag in model description");
+
+				delimiter = ' ';
+			}
+
+			startElement(name);
+
+			if (empty) {
+				endElement(name);
+			}
+
+			return p;
+		}
+
+		const char *attribute(const char *name) const {
+			for (const auto &a : m_attributes) {
+				if (strcmp(a.name, name) == 0) return a.value;
+			}
+			return nullptr;
+		}
+
+		void startElement(const char *name) {
+
+			m_depth++;
+
+			if (m_skipDepth) return;
+
+			const char *value;
+
+			if (strcmp(name, "ScalarVariable") == 0) {
+				startScalarVariable();
+			} else if (m_variable != UNRESOLVED) {
+				startVariableElement(name);
+			} else if (strcmp(name, "Unknown") == 0) {
+				addUnknown();
+			} else if (strcmp(name, "Outputs") == 0) {
+				m_unknowns = &m.m_outputs;
+			} else if (strcmp(name, "Derivatives") == 0) {
+				m_unknowns = &m.m_derivatives;
+			} else if (strcmp(name, "InitialUnknowns") == 0) {
+				m_unknowns = &m.m_initialUnknowns;
+			} else if (strcmp(name, "TypeDefinitions") == 0 || strcmp(name, "UnitDefinitions") == 0 || strcmp(name, "VendorAnnotations") == 0) {
+				m_skipDepth = m_depth;
+			} else if (strcmp(name, "fmiModelDescription") == 0) {
+				startModelDescription();
+			} else if (strcmp(name, "ModelExchange") == 0) {
+				setImplementation(m.m_modelExchange);
+			} else if (strcmp(name, "CoSimulation") == 0) {
+				setImplementation(m.m_coSimulation);
+			} else if (strcmp(name, "Implementation") == 0) {
+				// FMI 1.0 co-simulation
+				m.m_coSimulation.defined = true;
+				m.m_coSimulation.modelIdentifier = m.m_modelExchange.modelIdentifier;
+				m.m_modelExchange = Implementation();
+			} else if (strcmp(name, "Capabilities") == 0) {
+				if ((value = attribute("canHandleVariableCommunicationStepSize"))) m.m_coSimulation.canHandleVariableCommunicationStepSize = toBool(value);
+			} else if (strcmp(name, "DefaultExperiment") == 0) {
+				auto &experiment = m.m_defaultExperiment;
+				experiment.defined = true;
+				if ((value = attribute("startTime"))) experiment.startTime = toDouble(value);
+				if ((value = attribute("stopTime")))  experiment.stopTime  = toDouble(value);
+				if ((value = attribute("tolerance"))) experiment.tolerance = toDouble(value);
+				if ((value = attribute("stepSize")))  experiment.stepSize  = toDouble(value);
+			}
+		}
+
+		void endElement(const char *name) {
+
+			if (m_depth == 0) throw runtime_error("Unexpected end tag in model description");
+
+			if (m_skipDepth == m_depth) {
+				m_skipDepth = 0;
+			} else if (m_skipDepth == 0) {
+				if (strcmp(name, "ScalarVariable") == 0) {
+					endScalarVariable();
+				} else if (strcmp(name, "Name") == 0 && m_inName) {
+					m_dependencyNames.push_back(make_pair(m.m_dependencies.size(), text()));
+					m.m_dependencies.push_back(UNRESOLVED);
+					m.m_dependencyKinds.push_back(DEPENDENCY_DEPENDENT);
+					m.m_outputs.back().end = m.m_dependencies.size();
+					m_inName = false;
+				} else if (strcmp(name, "Outputs") == 0 || strcmp(name, "Derivatives") == 0 || strcmp(name, "InitialUnknowns") == 0) {
+					m_unknowns = nullptr;
+				}
+			}
+
+			m_depth--;
+		}
+
+		void startModelDescription() {
+
+			const char *value;
+
+			if ((value = attribute("fmiVersion"))) {
+				if (strcmp(value, "1.0") == 0) {
+					m.m_fmiVersion = FMI_VERSION_1;
+				} else if (strcmp(value, "2.0") == 0) {
+					m.m_fmiVersion = FMI_VERSION_2;
+				} else {
+					throw runtime_error(string("Unsupported FMI version: ") + value);
+				}
+			}
+
+			if ((value = attribute("modelName")))      m.m_modelName = value;
+			if ((value = attribute("guid")))           m.m_guid = value;
+			if ((value = attribute("generationTool"))) m.m_generationTool = value;
+
+			if ((value = attribute("numberOfEventIndicators")))  m.m_numberOfEventIndicators = toSize(value);
+			if ((value = attribute("numberOfContinuousStates"))) m.m_numberOfContinuousStates = toSize(value);
+
+			// FMI 1.0 is model exchange unless there is an <Implementation>
+			if (m.m_fmiVersion == FMI_VERSION_1 && (value = attribute("modelIdentifier"))) {
+				m.m_modelExchange.defined = true;
+				m.m_modelExchange.modelIdentifier = value;
+			}
+		}
+
+		void setImplementation(Implementation &implementation) {
+
+			const char *value;
+
+			implementation.defined = true;
+
+			if ((value = attribute("modelIdentifier")))                        implementation.modelIdentifier = value;
+			if ((value = attribute("providesDirectionalDerivative")))          implementation.providesDirectionalDerivative = toBool(value);
+			if ((value = attribute("canGetAndSetFMUstate")))                   implementation.canGetAndSetFMUstate = toBool(value);
+			if ((value = attribute("canSerializeFMUstate")))                   implementation.canSerializeFMUstate = toBool(value);
+			if ((value = attribute("canHandleVariableCommunicationStepSize"))) implementation.canHandleVariableCommunicationStepSize = toBool(value);
+		}
+
+		void startScalarVariable() {
+
+			m_variable = m.m_variables.size();
+			m.m_variables.push_back(ScalarVariable());
+
+			auto &variable = m.m_variables.back();
+
+			const char *value;
+
+			if ((value = attribute("name")))           variable.name = value;
+			if ((value = attribute("description")))    variable.description = value;
+			if ((value = attribute("valueReference"))) variable.valueReference = static_cast<ValueReference>(strtoul(value, nullptr, 10));
+
+			const char *causality = attribute("causality");
+			const char *variability = attribute("variability");
+
+			if (!variability) {
+				variable.variability = VARIABILITY_CONTINUOUS;
+			} else if (strcmp(variability, "constant") == 0) {
+				variable.variability = VARIABILITY_CONSTANT;
+			} else if (strcmp(variability, "fixed") == 0 || strcmp(variability, "parameter") == 0) {
+				variable.variability = VARIABILITY_FIXED;
+			} else if (strcmp(variability, "tunable") == 0) {
+				variable.variability = VARIABILITY_TUNABLE;
+			} else if (strcmp(variability, "discrete") == 0) {
+				variable.variability = VARIABILITY_DISCRETE;
+			}
+
+			if (!causality) {
+				variable.causality = CAUSALITY_LOCAL;
+			} else if (strcmp(causality, "parameter") == 0) {
+				variable.causality = CAUSALITY_PARAMETER;
+			} else if (strcmp(causality, "calculatedParameter") == 0) {
+				variable.causality = CAUSALITY_CALCULATED_PARAMETER;
+			} else if (strcmp(causality, "input") == 0) {
+				variable.causality = CAUSALITY_INPUT;
+			} else if (strcmp(causality, "output") == 0) {
+				variable.causality = CAUSALITY_OUTPUT;
+			} else if (strcmp(causality, "independent") == 0) {
+				variable.causality = CAUSALITY_INDEPENDENT;
+			}
+
+			// FMI 1.0 parameters are internal variables with variability "parameter"
+			if (m.m_fmiVersion == FMI_VERSION_1 && variability && strcmp(variability, "parameter") == 0 && variable.causality == CAUSALITY_LOCAL) {
+				variable.causality = CAUSALITY_PARAMETER;
+			}
+
+			// FMI 1.0 outputs depend on all inputs unless they have a <DirectDependency>
+			if (m.m_fmiVersion == FMI_VERSION_1 && variable.causality == CAUSALITY_OUTPUT) {
+				m.m_outputs.push_back({ m_variable, true, m.m_dependencies.size(), m.m_dependencies.size() });
+			}
+		}
+
+		void startVariableElement(const char *name) {
+
+			auto &variable = m.m_variables[m_variable];
+
+			if (strcmp(name, "DirectDependency") == 0) {
+				if (!m.m_outputs.empty() && m.m_outputs.back().variable == m_variable) {
+					m.m_outputs.back().dependent = false;
+				}
+				return;
+			}
+
+			if (strcmp(name, "Name") == 0) {
+				m_inName = !m.m_outputs.empty() && m.m_outputs.back().variable == m_variable;
+				m_text.clear();
+				return;
+			}
+
+			if (strcmp(name, "Real") == 0) {
+				variable.type = REAL;
+			} else if (strcmp(name, "Integer") == 0 || strcmp(name, "Enumeration") == 0) {
+				variable.type = INTEGER;
+			} else if (strcmp(name, "Boolean") == 0) {
+				variable.type = BOOLEAN;
+			} else if (strcmp(name, "String") == 0) {
+				variable.type = STRING;
+			} else {
+				return;
+			}
+
+			const char *value;
+
+			if ((value = attribute("start"))) {
+				variable.hasStart = true;
+				if (variable.type == STRING) {
+					variable.stringStart = value;
+				} else if (variable.type == BOOLEAN) {
+					variable.start = toBool(value) ? 1 : 0;
+				} else {
+					variable.start = toDouble(value);
+				}
+			}
+
+			if ((value = attribute("nominal")))    variable.nominal = toDouble(value);
+			if ((value = attribute("derivative"))) variable.derivative = toSize(value);
+		}
+
+		void endScalarVariable() {
+			m_variable = UNRESOLVED;
+		}
+
+		void addUnknown() {
+
+			if (!m_unknowns) return;
+
+			const char *value = attribute("index");
+
+			if (!value) throw runtime_error("Missing attribute \"index\" of <Unknown> in model description");
+
+			const auto index = toSize(value);
+
+			Unknown unknown = { index - 1, true, m.m_dependencies.size(), m.m_dependencies.size() };
+
+			const char *dependencies = attribute("dependencies");
+			const char *kinds = attribute("dependenciesKind");
+
+			if (dependencies) {
+
+				unknown.dependent = false;
+
+				for (const char *p = dependencies;;) {
+
+					while (isSpace(*p)) p++;
+
+					if (!*p) break;
+
+					char *q;
+					m.m_dependencies.push_back(static_cast<size_t>(strtoul(p, &q, 10)) - 1);
+
+					if (q == p) throw runtime_error("Invalid attribute \"dependencies\" of <Unknown> in model description");
+
+					p = q;
+
+					// if dependenciesKind is missing all dependencies are "dependent"
+					DependencyKind kind = DEPENDENCY_DEPENDENT;
+
+					if (kinds) {
+
+						while (isSpace(*kinds)) kinds++;
+
+						const char *k = kinds;
+						while (*kinds && !isSpace(*kinds)) kinds++;
+
+						const auto n = static_cast<size_t>(kinds - k);
+
+						if (n == 8 && strncmp(k, "constant", n) == 0) {
+							kind = DEPENDENCY_CONSTANT;
+						} else if (n == 5 && strncmp(k, "fixed", n) == 0) {
+							kind = DEPENDENCY_FIXED;
+						} else if (n == 7 && strncmp(k, "tunable", n) == 0) {
+							kind = DEPENDENCY_TUNABLE;
+						} else if (n == 8 && strncmp(k, "discrete", n) == 0) {
+							kind = DEPENDENCY_DISCRETE;
+						}
+					}
+
+					m.m_dependencyKinds.push_back(kind);
+				}
+
+				unknown.end = m.m_dependencies.size();
+			}
+
+			m_unknowns->push_back(unknown);
+		}
+
+	public:
+		// resolves the names of the FMI 1.0 direct dependencies and checks the indices
+		void finish() {
+
+			for (const auto &dependency : m_dependencyNames) {
+
+				auto variable = m.variable(dependency.second);
+
+				if (!variable) throw runtime_error("Unknown direct dependency \"" + dependency.second + "\" in model description");
+
+				m.m_dependencies[dependency.first] = m.index(variable);
+			}
+
+			const auto n = m.m_variables.size();
+
+			for (auto unknowns : { &m.m_outputs, &m.m_derivatives, &m.m_initialUnknowns }) {
+				for (const auto &unknown : *unknowns) {
+					if (unknown.variable >= n) throw runtime_error("Invalid index of <Unknown> in model description");
+				}
+			}
+
+			for (auto index : m.m_dependencies) {
+				if (index >= n) throw runtime_error("Invalid dependency of <Unknown> in model description");
+			}
+		}
+
+	};
+
+	ModelDescription::ModelDescription(const string &filename) {
+
+		auto file = fopen(filename.c_str(), "rb");
+
+		if (!file) throw runtime_error("Failed to open " + filename);
+
+		vector<char> buffer;
+
+		fseek(file, 0, SEEK_END);
+		const auto size = ftell(file);
+		fseek(file, 0, SEEK_SET);
+
+		if (size > 0) {
+			buffer.resize(static_cast<size_t>(size));
+			if (fread(buffer.data(), 1, buffer.size(), file) != buffer.size()) {
+				fclose(file);
+				throw runtime_error("Failed to read " + filename);
+			}
+		}
+
+		fclose(file);
+
+		parse(buffer.data(), buffer.size());
+	}
+
+	ModelDescription::ModelDescription(char *buffer, size_t size) {
+		parse(buffer, size);
+	}
+
+	void ModelDescription::parse(char *buffer, size_t size) {
+
+		Parser parser(*this);
+
+		parser.parse(buffer, buffer + size);
+
+		if (m_guid.empty()) throw runtime_error("The model description has no GUID");
+
+		buildIndices();
+
+		parser.finish();
+
+		if (m_fmiVersion == FMI_VERSION_2) {
+			m_numberOfContinuousStates = m_derivatives.size();
+		}
+	}
+
+	void ModelDescription::buildIndices() {
+
+		m_variableIndices.reserve(m_variables.size());
+
+		for (size_t i = 0; i < m_variables.size(); i++) {
+			const auto &variable = m_variables[i];
+			m_variableIndices.insert(make_pair(variable.name, i)); // keeps the first variable with the name
+			m_valueReferences[variable.type].push_back(make_pair(variable.valueReference, i));
+		}
+
+		for (auto &valueReferences : m_valueReferences) {
+			sort(valueReferences.begin(), valueReferences.end());
+		}
+	}
+
+	const ScalarVariable *ModelDescription::variable(const string &name) const {
+
+		auto it = m_variableIndices.find(name);
+
+		return it != m_variableIndices.end() ? &m_variables[it->second] : nullptr;
+	}
+
+	const ScalarVariable *ModelDescription::variable(Type type, ValueReference vr) const {
+
+		const auto &valueReferences = m_valueReferences[type];
+
+		auto it = lower_bound(valueReferences.begin(), valueReferences.end(), make_pair(vr, size_t(0)));
+
+		return it != valueReferences.end() && it->first == vr ? &m_variables[it->second] : nullptr;
+	}
+
+	bool ModelDescription::getStates(vector<ValueReference> &states, vector<ValueReference> &derivatives) const {
+
+		states.clear();
+		derivatives.clear();
+
+		for (const auto &unknown : m_derivatives) {
+
+			const auto &derivative = m_variables[unknown.variable];
+
+			if (derivative.derivative < 1 || derivative.derivative > m_variables.size()) {
+				states.clear();
+				derivatives.clear();
+				return false;
+			}
+
+			states.push_back(m_variables[derivative.derivative - 1].valueReference);
+			derivatives.push_back(derivative.valueReference);
+		}
+
+		return true;
+	}
+
+}
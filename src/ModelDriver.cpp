@@ -0,0 +1,653 @@
+/*****************************************************************
+ *  Copyright (c) Dassault Systemes. All rights reserved.        *
+ *  This file is part of FMIKit. See LICENSE.txt in the project  *
+ *  root for license information.                                *
+ *****************************************************************/
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <stdexcept> // for runtime_error
+#include <utility>   // for swap
+
+#include "ModelDriver.h"
+
+using namespace std;
+
+namespace fmikit {
+
+	// shortens the step to end exactly at tEnd if it would end at or just before tEnd
+	static double clipStep(double t, double tEnd, double h, bool &clipped) {
+		clipped = t + h * (1 + 1e-3) >= tEnd;
+		return clipped ? tEnd - t : h;
+	}
+
+	// weighted root mean square norm of v w.r.t. the tolerances (x0 and x1 are the reference values)
+	static double wrmsNorm(const double v[], const double x0[], const double x1[], size_t n, double rtol, double atol) {
+
+		if (n == 0) return 0;
+
+		double sum = 0;
+
+		for (size_t i = 0; i < n; i++) {
+			const double w = atol + rtol * max(fabs(x0[i]), fabs(x1[i]));
+			sum += (v[i] / w) * (v[i] / w);
+		}
+
+		return sqrt(sum / n);
+	}
+
+	// LU decomposition with partial pivoting of the n x n matrix A (column-major, in place)
+	static bool luFactor(double A[], size_t n, size_t pivots[]) {
+
+		for (size_t k = 0; k < n; k++) {
+
+			size_t p = k;
+
+			for (size_t i = k + 1; i < n; i++) {
+				if (fabs(A[k * n + i]) > fabs(A[k * n + p])) p = i;
+			}
+
+			pivots[k] = p;
+
+			if (A[k * n + p] == 0) return false; // singular
+
+			if (p != k) {
+				for (size_t j = 0; j < n; j++) swap(A[j * n + k], A[j * n + p]);
+			}
+
+			for (size_t i = k + 1; i < n; i++) {
+				A[k * n + i] /= A[k * n + k];
+			}
+
+			for (size_t j = k + 1; j < n; j++) {
+				for (size_t i = k + 1; i < n; i++) {
+					A[j * n + i] -= A[k * n + i] * A[j * n + k];
+				}
+			}
+		}
+
+		return true;
+	}
+
+	// solves LU x = b with the factors from luFactor (b is overwritten with x)
+	static void luSolve(const double LU[], size_t n, const size_t pivots[], double b[]) {
+
+		for (size_t k = 0; k < n; k++) {
+			swap(b[k], b[pivots[k]]);
+		}
+
+		for (size_t j = 0; j < n; j++) {
+			for (size_t i = j + 1; i < n; i++) {
+				b[i] -= LU[j * n + i] * b[j];
+			}
+		}
+
+		for (size_t j = n; j-- > 0;) {
+			b[j] /= LU[j * n + j];
+			for (size_t i = 0; i < j; i++) {
+				b[i] -= LU[j * n + i] * b[j];
+			}
+		}
+	}
+
+	/* Integrates the states from t towards tEnd. On entry and on exit dx = f(t, x) and the
+	   last evaluation of the model is at the returned time and states. */
+	class ODESolver {
+
+	public:
+		ODESolver(ModelDriver *driver, size_t nx, const DriverSettings &settings) :
+			m_driver(driver),
+			m_nx(nx),
+			m_h(settings.stepSize),
+			m_rtol(settings.relativeTolerance),
+			m_atol(settings.absoluteTolerance) {
+		}
+
+		virtual ~ODESolver() {}
+
+		// advances x and dx and returns the reached time (<= tEnd)
+		virtual double step(double t, double tEnd, double x[], double dx[]) = 0;
+
+		// called after an event has changed the states discontinuously
+		virtual void reset() {}
+
+		size_t rejected() const { return m_rejected; }
+
+	protected:
+		ModelDriver *m_driver;
+		size_t m_nx;
+		double m_h;
+		double m_rtol;
+		double m_atol;
+		size_t m_rejected = 0;
+
+		void checkStepSize(double t, double h) const {
+			if (h < 1e-14 * max(1.0, fabs(t))) {
+				throw runtime_error("The step size became too small at t=" + to_string(t));
+			}
+		}
+
+	};
+
+	class RK4Solver : public ODESolver {
+
+	public:
+		RK4Solver(ModelDriver *driver, size_t nx, const DriverSettings &settings) :
+			ODESolver(driver, nx, settings),
+			m_k2(nx), m_k3(nx), m_k4(nx), m_tmp(nx) {
+		}
+
+		double step(double t, double tEnd, double x[], double dx[]) override {
+
+			bool clipped;
+			const double h = clipStep(t, tEnd, m_h, clipped);
+			const double t1 = clipped ? tEnd : t + h;
+
+			for (size_t i = 0; i < m_nx; i++) m_tmp[i] = x[i] + h / 2 * dx[i];
+			m_driver->derivatives(t + h / 2, m_tmp.data(), m_k2.data());
+
+			for (size_t i = 0; i < m_nx; i++) m_tmp[i] = x[i] + h / 2 * m_k2[i];
+			m_driver->derivatives(t + h / 2, m_tmp.data(), m_k3.data());
+
+			for (size_t i = 0; i < m_nx; i++) m_tmp[i] = x[i] + h * m_k3[i];
+			m_driver->derivatives(t1, m_tmp.data(), m_k4.data());
+
+			for (size_t i = 0; i < m_nx; i++) {
+				x[i] += h / 6 * (dx[i] + 2 * m_k2[i] + 2 * m_k3[i] + m_k4[i]);
+			}
+
+			m_driver->derivatives(t1, x, dx);
+
+			return t1;
+		}
+
+	private:
+		vector<double> m_k2, m_k3, m_k4, m_tmp;
+
+	};
+
+	class DormandPrinceSolver : public ODESolver {
+
+	public:
+		DormandPrinceSolver(ModelDriver *driver, size_t nx, const DriverSettings &settings) :
+			ODESolver(driver, nx, settings),
+			m_k2(nx), m_k3(nx), m_k4(nx), m_k5(nx), m_k6(nx), m_k7(nx), m_y(nx), m_err(nx) {
+		}
+
+		double step(double t, double tEnd, double x[], double dx[]) override {
+
+			const double *k1 = dx;
+
+			for (;;) {
+
+				bool clipped;
+				const double h = clipStep(t, tEnd, m_h, clipped);
+				const double t1 = clipped ? tEnd : t + h;
+
+				for (size_t i = 0; i < m_nx; i++) {
+					m_y[i] = x[i] + h * (1.0 / 5 * k1[i]);
+				}
+				m_driver->derivatives(t + h / 5, m_y.data(), m_k2.data());
+
+				for (size_t i = 0; i < m_nx; i++) {
+					m_y[i] = x[i] + h * (3.0 / 40 * k1[i] + 9.0 / 40 * m_k2[i]);
+				}
+				m_driver->derivatives(t + h * 3 / 10, m_y.data(), m_k3.data());
+
+				for (size_t i = 0; i < m_nx; i++) {
+					m_y[i] = x[i] + h * (44.0 / 45 * k1[i] - 56.0 / 15 * m_k2[i] + 32.0 / 9 * m_k3[i]);
+				}
+				m_driver->derivatives(t + h * 4 / 5, m_y.data(), m_k4.data());
+
+				for (size_t i = 0; i < m_nx; i++) {
+					m_y[i] = x[i] + h * (19372.0 / 6561 * k1[i] - 25360.0 / 2187 * m_k2[i] + 64448.0 / 6561 * m_k3[i] - 212.0 / 729 * m_k4[i]);
+				}
+				m_driver->derivatives(t + h * 8 / 9, m_y.data(), m_k5.data());
+
+				for (size_t i = 0; i < m_nx; i++) {
+					m_y[i] = x[i] + h * (9017.0 / 3168 * k1[i] - 355.0 / 33 * m_k2[i] + 46732.0 / 5247 * m_k3[i] + 49.0 / 176 * m_k4[i] - 5103.0 / 18656 * m_k5[i]);
+				}
+				m_driver->derivatives(t1, m_y.data(), m_k6.data());
+
+				for (size_t i = 0; i < m_nx; i++) {
+					m_y[i] = x[i] + h * (35.0 / 384 * k1[i] + 500.0 / 1113 * m_k3[i] + 125.0 / 192 * m_k4[i] - 2187.0 / 6784 * m_k5[i] + 11.0 / 84 * m_k6[i]);
+				}
+				m_driver->derivatives(t1, m_y.data(), m_k7.data());
+
+				// difference between the 5th and the embedded 4th order solution
+				for (size_t i = 0; i < m_nx; i++) {
+					m_err[i] = h * (71.0 / 57600 * k1[i] - 71.0 / 16695 * m_k3[i] + 71.0 / 1920 * m_k4[i] - 17253.0 / 339200 * m_k5[i] + 22.0 / 525 * m_k6[i] - 1.0 / 40 * m_k7[i]);
+				}
+
+				const double err = wrmsNorm(m_err.data(), x, m_y.data(), m_nx, m_rtol, m_atol);
+				const double factor = err == 0 ? 5 : min(5.0, max(0.2, 0.9 * pow(err, -0.2)));
+
+				if (err <= 1) {
+
+					// the step at the end of an interval does not limit the following steps
+					if (!clipped || factor < 1) m_h = h * factor;
+
+					copy(m_y.begin(), m_y.end(), x);
+					copy(m_k7.begin(), m_k7.end(), dx); // FSAL: k7 = f(t1, x1)
+
+					return t1;
+				}
+
+				m_rejected++;
+				m_h = h * factor;
+				checkStepSize(t, m_h);
+			}
+		}
+
+	private:
+		vector<double> m_k2, m_k3, m_k4, m_k5, m_k6, m_k7, m_y, m_err;
+
+	};
+
+	/* Variable-step BDF2 (BDF1 after a reset) that solves the implicit equations with a simplified
+	   Newton iteration. The Jacobian is kept until the iteration fails to converge. The step size
+	   is bounded by stepSize and reduced when the iteration does not converge. */
+	class BDFSolver : public ODESolver {
+
+	public:
+		BDFSolver(ModelDriver *driver, size_t nx, const DriverSettings &settings) :
+			ODESolver(driver, nx, settings),
+			m_hMax(settings.stepSize),
+			m_xPrev(nx), m_y(nx), m_fy(nx), m_delta(nx), m_J(nx * nx), m_M(nx * nx), m_pivots(nx) {
+		}
+
+		void reset() override {
+			m_startup = true;
+			m_jacobianValid = false;
+		}
+
+		double step(double t, double tEnd, double x[], double dx[]) override {
+
+			for (;;) {
+
+				bool clipped;
+				const double h = clipStep(t, tEnd, m_h, clipped);
+				const double t1 = clipped ? tEnd : t + h;
+
+				// y - a0 * x - a1 * xPrev - h * b * f(t1, y) = 0
+				double a0 = 1, a1 = 0, b = 1;
+
+				if (!m_startup) {
+					const double w = h / m_hPrev;
+					a0 = (1 + w) * (1 + w) / (1 + 2 * w);
+					a1 = -w * w / (1 + 2 * w);
+					b = (1 + w) / (1 + 2 * w);
+				}
+
+				bool freshJacobian = false;
+
+				if (!m_jacobianValid) {
+					m_driver->jacobian(t, x, dx, m_J.data());
+					m_jacobianValid = true;
+					m_hb = 0;
+					freshJacobian = true;
+				}
+
+				bool converged = false;
+
+				if (h * b != m_hb) {
+
+					// M = I - h * b * J
+					for (size_t i = 0; i < m_nx * m_nx; i++) m_M[i] = -h * b * m_J[i];
+					for (size_t i = 0; i < m_nx; i++) m_M[i * m_nx + i] += 1;
+
+					m_hb = luFactor(m_M.data(), m_nx, m_pivots.data()) ? h * b : 0;
+				}
+
+				if (m_hb != 0) {
+
+					// predictor
+					for (size_t i = 0; i < m_nx; i++) m_y[i] = x[i] + h * dx[i];
+
+					for (int iteration = 0; iteration < 4 && !converged; iteration++) {
+
+						m_driver->derivatives(t1, m_y.data(), m_fy.data());
+
+						for (size_t i = 0; i < m_nx; i++) {
+							m_delta[i] = -(m_y[i] - a0 * x[i] - a1 * m_xPrev[i] - h * b * m_fy[i]);
+						}
+
+						luSolve(m_M.data(), m_nx, m_pivots.data(), m_delta.data());
+
+						for (size_t i = 0; i < m_nx; i++) m_y[i] += m_delta[i];
+
+						converged = wrmsNorm(m_delta.data(), x, m_y.data(), m_nx, m_rtol, m_atol) < 1e-2;
+					}
+				}
+
+				if (!converged) {
+
+					m_rejected++;
+
+					// retry with a new Jacobian before the step size is reduced
+					if (!freshJacobian) {
+						m_jacobianValid = false;
+					} else {
+						m_h = h / 4;
+						checkStepSize(t, m_h);
+					}
+
+					continue;
+				}
+
+				copy(x, x + m_nx, m_xPrev.begin());
+				copy(m_y.begin(), m_y.end(), x);
+
+				m_driver->derivatives(t1, x, dx);
+
+				m_hPrev = h;
+				m_startup = false;
+
+				if (!clipped) m_h = min(2 * m_h, m_hMax);
+
+				return t1;
+			}
+		}
+
+	private:
+		double m_hMax;
+		double m_hPrev = 0;
+		double m_hb = 0; // h * b of the factorized iteration matrix
+		bool m_startup = true;
+		bool m_jacobianValid = false;
+
+		vector<double> m_xPrev, m_y, m_fy, m_delta, m_J, m_M;
+		vector<size_t> m_pivots;
+
+	};
+
+	ModelDriver::ModelDriver(FMU2Model *model, size_t nx, size_t nz, const DriverSettings &settings) :
+		m_model(model),
+		m_nx(nx),
+		m_nz(nz),
+		m_settings(settings),
+		m_x(nx), m_dx(nx), m_z(nz),
+		m_x0(nx), m_dx0(nx), m_z0(nz),
+		m_seed(nx), m_column(nx), m_xt(nx), m_zt(nz) {
+
+		if (settings.stopTime < settings.startTime) throw runtime_error("The stop time must not be less than the start time");
+		if (settings.outputInterval <= 0) throw runtime_error("The output interval must be greater than 0");
+		if (settings.stepSize <= 0) throw runtime_error("The step size must be greater than 0");
+
+		switch (settings.solver) {
+		case RK4:            m_solver.reset(new RK4Solver(this, nx, settings)); break;
+		case DORMAND_PRINCE: m_solver.reset(new DormandPrinceSolver(this, nx, settings)); break;
+		case BDF:            m_solver.reset(new BDFSolver(this, nx, settings)); break;
+		default:             throw runtime_error("Unknown solver");
+		}
+
+		m_directionalDerivatives = nx > 0 && model->providesDirectionalDerivative() &&
+			settings.states.size() == nx && settings.derivatives.size() == nx;
+	}
+
+	ModelDriver::~ModelDriver() {}
+
+	size_t ModelDriver::rejectedSteps() const {
+		return m_solver->rejected();
+	}
+
+	void ModelDriver::setOutputs(const vector<string> &names, const vector<ValueReference> &vr) {
+
+		if (names.size() != vr.size()) throw runtime_error("The number of output names and value references must match");
+
+		m_outputNames = names;
+		m_outputs = vr;
+		m_outputValues.resize(vr.size());
+	}
+
+	void ModelDriver::derivatives(double t, const double x[], double dx[]) {
+		m_model->setTime(t);
+		m_model->setContinuousStates(x, m_nx);
+		m_model->getDerivatives(dx, m_nx);
+	}
+
+	void ModelDriver::jacobian(double t, double x[], const double fx[], double J[]) {
+
+		if (m_directionalDerivatives) {
+
+			m_model->setTime(t);
+			m_model->setContinuousStates(x, m_nx);
+
+			for (size_t j = 0; j < m_nx; j++) {
+				m_seed[j] = 1;
+				m_model->getDirectionalDerivative(m_settings.derivatives.data(), m_nx, m_settings.states.data(), m_nx, m_seed.data(), &J[j * m_nx]);
+				m_seed[j] = 0;
+			}
+
+			return;
+		}
+
+		// forward differences
+		for (size_t j = 0; j < m_nx; j++) {
+
+			const double xj = x[j];
+			const double delta = sqrt(DBL_EPSILON) * max(fabs(xj), 1.0);
+
+			x[j] += delta;
+			derivatives(t, x, m_column.data());
+			x[j] = xj;
+
+			for (size_t i = 0; i < m_nx; i++) {
+				J[j * m_nx + i] = (m_column[i] - fx[i]) / delta;
+			}
+		}
+	}
+
+	void ModelDriver::simulate(FILE *result) {
+
+		const auto &s = m_settings;
+
+		m_model->setupExperiment(true, s.relativeTolerance, s.startTime, true, s.stopTime);
+		m_model->enterInitializationMode();
+		m_model->exitInitializationMode();
+
+		m_time = s.startTime;
+
+		eventIteration();
+
+		if (result) {
+			fprintf(result, "time");
+			for (const auto &name : m_outputNames) fprintf(result, ",%s", name.c_str());
+			fprintf(result, "\n");
+		}
+
+		if (m_model->terminateSimulation()) {
+			writeOutputs(result, m_time);
+			return;
+		}
+
+		m_model->enterContinuousTimeMode();
+		m_model->getContinuousStates(m_x.data(), m_nx);
+		derivatives(m_time, m_x.data(), m_dx.data());
+		m_model->getEventIndicators(m_z.data(), m_nz);
+
+		m_solver->reset();
+
+		writeOutputs(result, m_time);
+
+		size_t outputStep = 1;
+		double nextOutput = s.startTime + s.outputInterval;
+
+		while (m_time < s.stopTime) {
+
+			double tEnd = min(nextOutput, s.stopTime);
+
+			const bool timeEventPending = m_model->nextEventTimeDefined() && m_model->nextEventTime() > m_time;
+
+			if (timeEventPending) tEnd = min(tEnd, m_model->nextEventTime());
+
+			copy(m_x.begin(), m_x.end(), m_x0.begin());
+			copy(m_dx.begin(), m_dx.end(), m_dx0.begin());
+			copy(m_z.begin(), m_z.end(), m_z0.begin());
+
+			const double t0 = m_time;
+
+			m_time = m_solver->step(t0, tEnd, m_x.data(), m_dx.data());
+			m_steps++;
+
+			m_model->getEventIndicators(m_z.data(), m_nz);
+
+			double tEvent;
+			const bool stateEvent = locateStateEvent(t0, m_time, tEvent);
+
+			if (stateEvent) {
+				interpolate(t0, m_time, tEvent, m_xt.data());
+				copy(m_xt.begin(), m_xt.end(), m_x.begin());
+				m_time = tEvent;
+				derivatives(m_time, m_x.data(), m_dx.data());
+				m_model->getEventIndicators(m_z.data(), m_nz);
+			}
+
+			const bool stepEvent = m_model->completedIntegratorStep();
+
+			if (m_model->terminateSimulation()) {
+				writeOutputs(result, m_time);
+				break;
+			}
+
+			const bool timeEvent = timeEventPending && m_time >= m_model->nextEventTime();
+			const bool outputPoint = m_time >= nextOutput || m_time >= s.stopTime;
+			const bool event = stateEvent || timeEvent || stepEvent;
+
+			if (outputPoint || event) writeOutputs(result, m_time);
+
+			if (outputPoint) nextOutput = s.startTime + (++outputStep) * s.outputInterval;
+
+			if (event) {
+
+				handleEvent(m_time);
+
+				if (m_model->terminateSimulation()) break;
+
+				writeOutputs(result, m_time);
+			}
+		}
+	}
+
+	void ModelDriver::eventIteration() {
+		do {
+			m_model->newDiscreteStates();
+			if (m_model->terminateSimulation()) return;
+		} while (m_model->newDiscreteStatesNeeded());
+	}
+
+	void ModelDriver::handleEvent(double t) {
+
+		m_events++;
+
+		m_model->enterEventMode();
+
+		eventIteration();
+
+		if (m_model->terminateSimulation()) return;
+
+		m_model->enterContinuousTimeMode();
+
+		// valuesOfContinuousStatesChanged is only valid for the last iteration so the states are always updated
+		m_model->getContinuousStates(m_x.data(), m_nx);
+		derivatives(t, m_x.data(), m_dx.data());
+		m_model->getEventIndicators(m_z.data(), m_nz);
+
+		m_solver->reset();
+	}
+
+	/* Finds the first zero crossing of the event indicators in [t0, t1] with the Illinois variant of
+	   regula falsi on the interpolated states and returns the time right after the crossing. */
+	bool ModelDriver::locateStateEvent(double t0, double t1, double &tEvent) {
+
+		auto crossed = [this](const double za[], const double zb[]) {
+			for (size_t i = 0; i < m_nz; i++) {
+				if ((za[i] > 0) != (zb[i] > 0)) return true;
+			}
+			return false;
+		};
+
+		double *za = m_z0.data();
+		double *zb = m_z.data();
+		double *zc = m_zt.data();
+
+		if (!crossed(za, zb)) return false;
+
+		double ta = t0, tb = t1;
+		double wa = 1, wb = 1; // Illinois weights of the retained end points
+		int retained = 0;      // -1: a, 1: b
+
+		const double tolerance = 1e-12 * max(1.0, fabs(t1));
+
+		for (int iteration = 0; iteration < 100 && tb - ta > tolerance; iteration++) {
+
+			// earliest estimated crossing of the indicators that change their sign
+			double tc = tb;
+
+			for (size_t i = 0; i < m_nz; i++) {
+				if ((za[i] > 0) != (zb[i] > 0)) {
+					const double fa = wa * za[i], fb = wb * zb[i];
+					tc = min(tc, tb - fb * (tb - ta) / (fb - fa));
+				}
+			}
+
+			if (!(tc > ta && tc < tb)) tc = (ta + tb) / 2;
+
+			interpolate(t0, t1, tc, m_xt.data());
+			m_model->setTime(tc);
+			m_model->setContinuousStates(m_xt.data(), m_nx);
+			m_model->getEventIndicators(zc, m_nz);
+
+			if (crossed(za, zc)) {
+				tb = tc;
+				swap(zb, zc);
+				wb = 1;
+				if (retained == -1) wa /= 2;
+				retained = -1;
+			} else {
+				ta = tc;
+				swap(za, zc);
+				wa = 1;
+				if (retained == 1) wb /= 2;
+				retained = 1;
+			}
+		}
+
+		tEvent = tb;
+
+		return true;
+	}
+
+	// cubic Hermite interpolation between the states at the start and the end of the last step
+	void ModelDriver::interpolate(double t0, double t1, double t, double x[]) const {
+
+		const double h = t1 - t0;
+		const double s = (t - t0) / h;
+
+		const double h00 = (1 + 2 * s) * (1 - s) * (1 - s);
+		const double h10 = s * (1 - s) * (1 - s);
+		const double h01 = s * s * (3 - 2 * s);
+		const double h11 = s * s * (s - 1);
+
+		for (size_t i = 0; i < m_nx; i++) {
+			x[i] = h00 * m_x0[i] + h10 * h * m_dx0[i] + h01 * m_x[i] + h11 * h * m_dx[i];
+		}
+	}
+
+	void ModelDriver::writeOutputs(FILE *result, double t) {
+
+		if (!result) return;
+
+		m_model->getReal(m_outputs.data(), m_outputs.size(), m_outputValues.data());
+
+		fprintf(result, "%.16g", t);
+
+		for (size_t i = 0; i < m_outputValues.size(); i++) {
+			fprintf(result, ",%.16g", m_outputValues[i]);
+		}
+
+		fprintf(result, "\n");
+	}
+
+}
@@ -0,0 +1,124 @@
+/*****************************************************************
+ *  Copyright (c) Dassault Systemes. All rights reserved.        *
+ *  This file is part of FMIKit. See LICENSE.txt in the project  *
+ *  root for license information.                                *
+ *****************************************************************/
+
+#include <map>
+
+#ifndef _WIN32
+#include <dlfcn.h>
+#endif
+
+#include "SharedLibrary.h"
+
+using namespace std;
+
+namespace fmikit {
+
+	static string lastSystemErrorMessage() {
+
+#ifdef _WIN32
+		auto error = GetLastError();
+
+		if (error) {
+			LPVOID lpMsgBuf;
+			auto bufLen = FormatMessage(
+				FORMAT_MESSAGE_ALLOCATE_BUFFER |
+				FORMAT_MESSAGE_FROM_SYSTEM |
+				FORMAT_MESSAGE_IGNORE_INSERTS,
+				nullptr,
+				error,
+				MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT),
+				reinterpret_cast<LPTSTR>(&lpMsgBuf),
+				0, nullptr);
+
+			if (bufLen) {
+				auto lpMsgStr = static_cast<LPCSTR>(lpMsgBuf);
+				string result(lpMsgStr, lpMsgStr + bufLen);
+				LocalFree(lpMsgBuf);
+				return result + " (System Error " + to_string(error) + ")";
+			}
+		}
+
+		return string();
+#else
+		auto message = dlerror();
+		return message ? message : string();
+#endif
+	}
+
+	// the libraries that are currently loaded (by path)
+	static mutex &registryMutex() {
+		static mutex m;
+		return m;
+	}
+
+	static map<string, weak_ptr<SharedLibrary>> &registry() {
+		static map<string, weak_ptr<SharedLibrary>> r;
+		return r;
+	}
+
+	shared_ptr<SharedLibrary> SharedLibrary::load(const string &libraryPath, string &errorMessage) {
+
+		lock_guard<mutex> lock(registryMutex());
+
+		auto &libraries = registry();
+
+		auto it = libraries.find(libraryPath);
+
+		if (it != libraries.end()) {
+			if (auto library = it->second.lock()) return library;
+		}
+
+#ifdef _WIN32
+		// DLL directory as wstring
+		const auto libraryDir = libraryPath.substr(0, libraryPath.find_last_of("\\/"));
+		const wstring dllDirectory(libraryDir.begin(), libraryDir.end());
+
+		// add the binaries directory temporarily to the DLL path to allow discovery of dependencies
+		auto dllDirectoryCookie = AddDllDirectory(dllDirectory.c_str());
+
+		auto handle = LoadLibraryEx(libraryPath.c_str(), NULL, LOAD_LIBRARY_SEARCH_DEFAULT_DIRS);
+
+		if (!handle) errorMessage = lastSystemErrorMessage();
+
+		// remove the binaries directory from the DLL path
+		RemoveDllDirectory(dllDirectoryCookie);
+#else
+		auto handle = dlopen(libraryPath.c_str(), RTLD_LAZY);
+
+		if (!handle) errorMessage = lastSystemErrorMessage();
+#endif
+
+		if (!handle) return nullptr;
+
+		shared_ptr<SharedLibrary> library(new SharedLibrary(libraryPath, handle));
+
+		libraries[libraryPath] = library;
+
+		return library;
+	}
+
+	SharedLibrary::SharedLibrary(const string &path, HMODULE handle) :
+		m_path(path),
+		m_handle(handle) {
+	}
+
+	SharedLibrary::~SharedLibrary() {
+#ifdef _WIN32
+		FreeLibrary(m_handle);
+#else
+		dlclose(m_handle);
+#endif
+	}
+
+	void *SharedLibrary::symbol(const string &name) const {
+#ifdef _WIN32
+		return reinterpret_cast<void *>(GetProcAddress(m_handle, name.c_str()));
+#else
+		return dlsym(m_handle, name.c_str());
+#endif
+	}
+
+}
@@ -0,0 +1,294 @@
+/*****************************************************************
+ *  Copyright (c) Dassault Systemes. All rights reserved.        *
+ *  This file is part of FMIKit. See LICENSE.txt in the project  *
+ *  root for license information.                                *
+ *****************************************************************/
+
+#include <chrono>
+#include <stdexcept> // for runtime_error
+
+#ifdef _WIN32
+#include <windows.h>
+#elif !defined(__APPLE__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "SlaveGroup.h"
+
+using namespace std;
+
+namespace fmikit {
+
+	// size of a value in a port buffer
+	static size_t valueSize(Type type) {
+		switch (type) {
+		case REAL:    return sizeof(double);
+		case INTEGER: return sizeof(int);
+		case BOOLEAN: return sizeof(bool);
+		default:      return 0;
+		}
+	}
+
+	// offsets of the ports in a buffer of doubles (each port starts at a double boundary)
+	static size_t layoutPorts(const TransferPlan &plan, vector<size_t> &offsets, size_t offset) {
+		for (size_t i = 0; i < plan.size(); i++) {
+			offsets.push_back(offset);
+			const auto &port = plan.port(i);
+			offset += (port.size * valueSize(port.type) + sizeof(double) - 1) / sizeof(double);
+		}
+		return offset;
+	}
+
+	// pins the calling thread to a CPU
+	static void setAffinity(int cpu) {
+
+		if (cpu < 0) return;
+
+#ifdef _WIN32
+		SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu);
+#elif !defined(__APPLE__)
+		cpu_set_t cpuset;
+		CPU_ZERO(&cpuset);
+		CPU_SET(cpu, &cpuset);
+		pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+#endif
+	}
+
+	SlaveGroup::SlaveGroup(size_t numWorkers, const vector<int> &cpus) : m_pending(0) {
+
+		if (numWorkers == 0) {
+			numWorkers = thread::hardware_concurrency();
+			if (numWorkers == 0) numWorkers = 1;
+		}
+
+		for (size_t i = 0; i < numWorkers; i++) {
+			m_workers.push_back(unique_ptr<Worker>(new Worker()));
+		}
+
+		for (size_t i = 0; i < numWorkers; i++) {
+			m_workers[i]->thread = thread(&SlaveGroup::run, this, i, i < cpus.size() ? cpus[i] : -1);
+		}
+	}
+
+	SlaveGroup::~SlaveGroup() {
+
+		{
+			lock_guard<mutex> lock(m_mutex);
+			m_stop = true;
+		}
+
+		m_start.notify_all();
+
+		for (auto &worker : m_workers) {
+			worker->thread.join();
+		}
+	}
+
+	size_t SlaveGroup::addInstance(FMU *fmu, Slave *slave, const TransferPlan &inputs, const TransferPlan &outputs) {
+
+		unique_ptr<Instance> instance(new Instance());
+
+		instance->fmu.reset(fmu);
+		instance->slave   = slave;
+		instance->inputs  = inputs;
+		instance->outputs = outputs;
+
+		auto size = layoutPorts(inputs, instance->inputOffsets, 0);
+		size = layoutPorts(outputs, instance->outputOffsets, size);
+
+		instance->buffer.resize(size);
+
+		m_instances.push_back(move(instance));
+
+		return m_instances.size() - 1;
+	}
+
+	void *SlaveGroup::input(size_t index, size_t port) {
+		auto &instance = *m_instances[index];
+		return &instance.buffer[instance.inputOffsets[port]];
+	}
+
+	const void *SlaveGroup::output(size_t index, size_t port) const {
+		auto &instance = *m_instances[index];
+		return &instance.buffer[instance.outputOffsets[port]];
+	}
+
+	void SlaveGroup::doStep(double h) {
+
+		m_errors.clear();
+
+		size_t n = 0;
+
+		for (const auto &instance : m_instances) {
+			if (!instance->failed) n++;
+		}
+
+		if (n == 0) return;
+
+		// a worker that is still looking for work from the last step can take
+		// the new tasks as soon as they are queued so the step must be set up first
+		m_pending = n;
+		m_h = h;
+
+		// distribute the instances round-robin over the workers' queues
+		for (size_t i = 0, j = 0; i < m_instances.size(); i++) {
+
+			if (m_instances[i]->failed) continue;
+
+			auto &worker = *m_workers[j++ % m_workers.size()];
+
+			lock_guard<mutex> lock(worker.mutex);
+			worker.tasks.push_back(i);
+		}
+
+		{
+			lock_guard<mutex> lock(m_mutex);
+			m_generation++;
+		}
+
+		m_start.notify_all();
+
+		{
+			unique_lock<mutex> lock(m_mutex);
+			m_done.wait(lock, [this] { return m_pending == 0; });
+		}
+
+		if (m_errors.empty()) return;
+
+		string message = to_string(m_errors.size()) + " of " + to_string(n) + " instances failed:";
+
+		for (const auto &error : m_errors) {
+			message += "\n" + m_instances[error.instance]->fmu->instanceName() + ": " + error.message;
+		}
+
+		throw runtime_error(message);
+	}
+
+	bool SlaveGroup::nextTask(size_t worker, size_t &task, bool &stolen) {
+
+		// take the next instance from the own queue...
+		{
+			auto &w = *m_workers[worker];
+			lock_guard<mutex> lock(w.mutex);
+			if (!w.tasks.empty()) {
+				task = w.tasks.front();
+				w.tasks.pop_front();
+				stolen = false;
+				return true;
+			}
+		}
+
+		// ...or steal from the back of the other workers' queues
+		for (size_t i = 1; i < m_workers.size(); i++) {
+			auto &w = *m_workers[(worker + i) % m_workers.size()];
+			lock_guard<mutex> lock(w.mutex);
+			if (!w.tasks.empty()) {
+				task = w.tasks.back();
+				w.tasks.pop_back();
+				stolen = true;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void SlaveGroup::step(size_t index, double h) {
+
+		auto &instance = *m_instances[index];
+
+		try {
+
+			for (size_t i = 0; i < instance.inputs.size(); i++) {
+				instance.inputs.set(instance.fmu.get(), i, &instance.buffer[instance.inputOffsets[i]]);
+			}
+
+			instance.slave->doStep(h);
+
+			for (size_t i = 0; i < instance.outputs.size(); i++) {
+				instance.outputs.get(instance.fmu.get(), i, &instance.buffer[instance.outputOffsets[i]]);
+			}
+
+		} catch (const exception &e) {
+
+			instance.failed = true;
+
+			lock_guard<mutex> lock(m_errorMutex);
+
+			Error error;
+			error.instance = index;
+			error.message  = e.what();
+			m_errors.push_back(error);
+		}
+	}
+
+	void SlaveGroup::run(size_t index, int cpu) {
+
+		auto &worker = *m_workers[index];
+
+		setAffinity(cpu);
+
+		size_t generation = 0;
+
+		for (;;) {
+
+			const auto waitStart = chrono::steady_clock::now();
+
+			{
+				unique_lock<mutex> lock(m_mutex);
+				m_start.wait(lock, [&] { return m_stop || m_generation != generation; });
+				if (m_stop) return;
+				generation = m_generation;
+			}
+
+			const auto waitEnd = chrono::steady_clock::now();
+
+			size_t task;
+			bool stolen;
+			double busy = 0;
+			size_t steps = 0, steals = 0;
+
+			while (nextTask(index, task, stolen)) {
+
+				const auto stepStart = chrono::steady_clock::now();
+				step(task, m_h); // m_h is written before the task is queued
+				busy += chrono::duration<double>(chrono::steady_clock::now() - stepStart).count();
+
+				steps++;
+				if (stolen) steals++;
+
+				if (--m_pending == 0) {
+					lock_guard<mutex> lock(m_mutex);
+					m_done.notify_all();
+				}
+			}
+
+			lock_guard<mutex> lock(worker.mutex);
+			worker.statistics.steps  += steps;
+			worker.statistics.stolen += steals;
+			worker.statistics.busy   += busy;
+			worker.statistics.idle   += chrono::duration<double>(waitEnd - waitStart).count();
+		}
+	}
+
+	vector<SlaveGroup::WorkerStatistics> SlaveGroup::statistics() const {
+
+		vector<WorkerStatistics> statistics;
+
+		for (const auto &worker : m_workers) {
+			lock_guard<mutex> lock(worker->mutex);
+			statistics.push_back(worker->statistics);
+		}
+
+		return statistics;
+	}
+
+	void SlaveGroup::resetStatistics() {
+		for (auto &worker : m_workers) {
+			lock_guard<mutex> lock(worker->mutex);
+			worker->statistics = WorkerStatistics();
+		}
+	}
+
+}
@@ -0,0 +1,203 @@
+/*****************************************************************
+ *  Copyright (c) Dassault Systemes. All rights reserved.        *
+ *  This file is part of FMIKit. See LICENSE.txt in the project  *
+ *  root for license information.                                *
+ *****************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept> // for runtime_error
+
+#include "SparseJacobian.h"
+
+using namespace std;
+
+namespace fmikit {
+
+	SparseJacobian::SparseJacobian(size_t nx, const vector<ValueReference> &unknowns, const vector<ValueReference> &knowns, const vector<size_t> &rows, const vector<size_t> &columns, bool directionalDerivatives) : m_nx(nx), m_directionalDerivatives(directionalDerivatives) {
+
+		const auto nrows = unknowns.size();
+		const auto ncols = knowns.size();
+
+		if (nrows < nx || ncols < nx || rows.size() != columns.size()) {
+			throw runtime_error("Invalid Jacobian pattern");
+		}
+
+		for (size_t k = 0; k < rows.size(); k++) {
+			if (rows[k] >= nrows || columns[k] >= ncols) throw runtime_error("Invalid Jacobian pattern");
+		}
+
+		// sort the elements by column and row
+		m_jc.assign(ncols + 1, 0);
+
+		for (auto column : columns) m_jc[column + 1]++;
+
+		for (size_t j = 0; j < ncols; j++) m_jc[j + 1] += m_jc[j];
+
+		m_ir.resize(rows.size());
+
+		vector<size_t> next(m_jc.begin(), m_jc.end() - 1);
+
+		for (size_t k = 0; k < rows.size(); k++) {
+			m_ir[next[columns[k]]++] = rows[k];
+		}
+
+		for (size_t j = 0; j < ncols; j++) {
+			sort(m_ir.begin() + m_jc[j], m_ir.begin() + m_jc[j + 1]);
+		}
+
+		// the derivatives and states are always evaluated, the outputs and inputs only if they have elements
+		vector<char> usedRows(nrows, 0);
+
+		for (auto row : m_ir) usedRows[row] = 1;
+
+		m_rowIndex.assign(nrows, 0);
+
+		for (size_t i = 0; i < nrows; i++) {
+			if (i >= nx && !usedRows[i]) continue;
+			m_rowIndex[i] = m_unknownVRs.size();
+			m_unknownVRs.push_back(unknowns[i]);
+			if (i >= nx) m_outputVRs.push_back(unknowns[i]);
+		}
+
+		m_columnIndex.assign(ncols, 0);
+
+		for (size_t j = 0; j < ncols; j++) {
+			if (j >= nx && m_jc[j] == m_jc[j + 1]) continue;
+			m_columnIndex[j] = m_knownVRs.size();
+			m_knownVRs.push_back(knowns[j]);
+			if (j >= nx) m_inputVRs.push_back(knowns[j]);
+		}
+
+		// greedy coloring: a column gets the first color that has none of its rows
+		vector<vector<char>> colorRows;
+
+		for (size_t j = 0; j < ncols; j++) {
+
+			if (m_jc[j] == m_jc[j + 1]) continue;
+
+			size_t color = 0;
+
+			for (; color < m_colors.size(); color++) {
+
+				bool conflict = false;
+
+				for (size_t k = m_jc[j]; k < m_jc[j + 1]; k++) {
+					if (colorRows[color][m_ir[k]]) {
+						conflict = true;
+						break;
+					}
+				}
+
+				if (!conflict) break;
+			}
+
+			if (color == m_colors.size()) {
+				m_colors.push_back(vector<size_t>());
+				colorRows.push_back(vector<char>(nrows, 0));
+			}
+
+			m_colors[color].push_back(j);
+
+			for (size_t k = m_jc[j]; k < m_jc[j + 1]; k++) {
+				colorRows[color][m_ir[k]] = 1;
+			}
+		}
+
+		m_seed.assign(m_knownVRs.size(), 0);
+		m_dv.resize(m_unknownVRs.size());
+		m_f0.resize(m_unknownVRs.size());
+		m_f1.resize(m_unknownVRs.size());
+		m_xt.resize(nx);
+		m_u0.resize(m_inputVRs.size());
+		m_ut.resize(m_inputVRs.size());
+		m_h.resize(ncols);
+	}
+
+	void SparseJacobian::evaluate(FMU2Model *model, const double x[], double values[]) {
+		if (m_directionalDerivatives && model->providesDirectionalDerivative()) {
+			evaluateDirectionalDerivatives(model, values);
+		} else {
+			evaluateFiniteDifferences(model, x, values);
+		}
+	}
+
+	void SparseJacobian::evaluateDirectionalDerivatives(FMU2Model *model, double values[]) {
+
+		for (const auto &color : m_colors) {
+
+			for (auto j : color) m_seed[m_columnIndex[j]] = 1;
+
+			model->getDirectionalDerivative(m_unknownVRs.data(), m_unknownVRs.size(), m_knownVRs.data(), m_knownVRs.size(), m_seed.data(), m_dv.data());
+
+			for (auto j : color) {
+
+				m_seed[m_columnIndex[j]] = 0;
+
+				for (size_t k = m_jc[j]; k < m_jc[j + 1]; k++) {
+					values[k] = m_dv[m_rowIndex[m_ir[k]]];
+				}
+			}
+		}
+	}
+
+	void SparseJacobian::evaluateUnknowns(FMU2Model *model, double f[]) {
+		model->getDerivatives(f, m_nx);
+		model->getReal(m_outputVRs.data(), m_outputVRs.size(), f + m_nx);
+	}
+
+	void SparseJacobian::evaluateFiniteDifferences(FMU2Model *model, const double x[], double values[]) {
+
+		static const double sqrtEps = sqrt(2.220446049250313e-16);
+
+		evaluateUnknowns(model, m_f0.data());
+
+		model->getReal(m_inputVRs.data(), m_inputVRs.size(), m_u0.data());
+
+		copy_n(x, m_nx, m_xt.begin());
+		m_ut = m_u0;
+
+		for (const auto &color : m_colors) {
+
+			bool states = false, inputs = false;
+
+			// perturb all columns of the color
+			for (auto j : color) {
+				if (j < m_nx) {
+					m_h[j] = sqrtEps * max(fabs(x[j]), 1.0);
+					m_xt[j] += m_h[j];
+					states = true;
+				} else {
+					const auto i = m_columnIndex[j] - m_nx;
+					m_h[j] = sqrtEps * max(fabs(m_u0[i]), 1.0);
+					m_ut[i] += m_h[j];
+					inputs = true;
+				}
+			}
+
+			if (states) model->setContinuousStates(m_xt.data(), m_nx);
+			if (inputs) model->setReal(m_inputVRs.data(), m_inputVRs.size(), m_ut.data());
+
+			evaluateUnknowns(model, m_f1.data());
+
+			for (auto j : color) {
+
+				for (size_t k = m_jc[j]; k < m_jc[j + 1]; k++) {
+					const auto r = m_rowIndex[m_ir[k]];
+					values[k] = (m_f1[r] - m_f0[r]) / m_h[j];
+				}
+
+				if (j < m_nx) {
+					m_xt[j] = x[j];
+				} else {
+					const auto i = m_columnIndex[j] - m_nx;
+					m_ut[i] = m_u0[i];
+				}
+			}
+
+			if (states) model->setContinuousStates(x, m_nx);
+			if (inputs) model->setReal(m_inputVRs.data(), m_inputVRs.size(), m_u0.data());
+		}
+	}
+
+}
@@ -0,0 +1,157 @@
+/*****************************************************************
+ *  Copyright (c) Dassault Systemes. All rights reserved.        *
+ *  This file is part of FMIKit. See LICENSE.txt in the project  *
+ *  root for license information.                                *
+ *****************************************************************/
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define USE_SSE2
+#endif
+
+#include "TransferPlan.h"
+
+using namespace std;
+
+namespace fmikit {
+
+	// Boolean ports are passed as bool[] (boolean_T in Simulink)
+	static_assert(sizeof(bool) == 1, "bool must be one byte");
+
+	size_t TransferPlan::addPort(Type type, const ValueReference vr[], size_t nvr) {
+		Port port;
+		port.type   = type;
+		port.offset = m_valueReferences.size();
+		port.size   = nvr;
+		m_valueReferences.insert(m_valueReferences.end(), vr, vr + nvr);
+		m_ports.push_back(port);
+		return m_ports.size() - 1;
+	}
+
+	void TransferPlan::get(FMU *fmu, size_t index, void *buffer) const {
+
+		const auto &p = m_ports[index];
+
+		if (p.size < 1) return; // nothing to do
+
+		const auto vr = &m_valueReferences[p.offset];
+
+		switch (p.type) {
+		case REAL:
+			fmu->getReal(vr, p.size, static_cast<double *>(buffer));
+			break;
+		case INTEGER:
+			fmu->getInteger(vr, p.size, static_cast<int *>(buffer));
+			break;
+		case BOOLEAN:
+			fmu->getBoolean(vr, p.size, static_cast<bool *>(buffer));
+			break;
+		default:
+			break;
+		}
+	}
+
+	void TransferPlan::set(FMU *fmu, size_t index, const void *buffer) const {
+
+		const auto &p = m_ports[index];
+
+		if (p.size < 1) return; // nothing to do
+
+		const auto vr = &m_valueReferences[p.offset];
+
+		switch (p.type) {
+		case REAL:
+			fmu->setReal(vr, p.size, static_cast<const double *>(buffer));
+			break;
+		case INTEGER:
+			fmu->setInteger(vr, p.size, static_cast<const int *>(buffer));
+			break;
+		case BOOLEAN:
+			fmu->setBoolean(vr, p.size, static_cast<const bool *>(buffer));
+			break;
+		default:
+			break;
+		}
+	}
+
+	void InputChangeSet::reserve(size_t n) {
+		m_realVRs.resize(n);
+		m_integerVRs.resize(n);
+		m_booleanVRs.resize(n);
+		m_reals.resize(n);
+		m_integers.resize(n);
+		m_booleans.reset(new bool[n]);
+	}
+
+	void InputChangeSet::add(const TransferPlan &plan, size_t index, const void *buffer, double cache[]) {
+
+		const auto &p = plan.port(index);
+		const auto vr = plan.valueReferences(index);
+		const auto n0 = m_nReals + m_nIntegers + m_nBooleans;
+
+		switch (p.type) {
+		case REAL: {
+			const auto values = static_cast<const double *>(buffer);
+			size_t i = 0;
+#ifdef USE_SSE2
+			// compare two values at a time and only look at the lanes that differ
+			for (; i + 2 <= p.size; i += 2) {
+				const int equal = _mm_movemask_pd(_mm_cmpeq_pd(_mm_loadu_pd(values + i), _mm_loadu_pd(cache + i)));
+				if (equal == 3) continue;
+				for (size_t j = 0; j < 2; j++) {
+					if (equal & (1 << j)) continue;
+					m_realVRs[m_nReals] = vr[i + j];
+					m_reals[m_nReals++] = cache[i + j] = values[i + j];
+				}
+			}
+#endif
+			for (; i < p.size; i++) {
+				if (values[i] == cache[i]) continue;
+				m_realVRs[m_nReals] = vr[i];
+				m_reals[m_nReals++] = cache[i] = values[i];
+			}
+			break;
+		}
+		case INTEGER: {
+			const auto values = static_cast<const int *>(buffer);
+			for (size_t i = 0; i < p.size; i++) {
+				if (values[i] == cache[i]) continue;
+				cache[i] = values[i];
+				m_integerVRs[m_nIntegers] = vr[i];
+				m_integers[m_nIntegers++] = values[i];
+			}
+			break;
+		}
+		case BOOLEAN: {
+			const auto values = static_cast<const bool *>(buffer);
+			for (size_t i = 0; i < p.size; i++) {
+				if ((values[i] ? 1.0 : 0.0) == cache[i]) continue;
+				cache[i] = values[i] ? 1.0 : 0.0;
+				m_booleanVRs[m_nBooleans] = vr[i];
+				m_booleans[m_nBooleans++] = values[i];
+			}
+			break;
+		}
+		default:
+			break;
+		}
+
+		const auto changed = m_nReals + m_nIntegers + m_nBooleans - n0;
+
+		m_transferred += changed;
+		m_skipped += p.size - changed;
+	}
+
+	void InputChangeSet::set(FMU *fmu) {
+
+		// the counts are reset first so a failed call does not leave stale elements
+		const auto nReals = m_nReals, nIntegers = m_nIntegers, nBooleans = m_nBooleans;
+
+		m_nReals = m_nIntegers = m_nBooleans = 0;
+
+		if (nReals > 0)    fmu->setReal(m_realVRs.data(), nReals, m_reals.data());
+		if (nIntegers > 0) fmu->setInteger(m_integerVRs.data(), nIntegers, m_integers.data());
+		if (nBooleans > 0) fmu->setBoolean(m_booleanVRs.data(), nBooleans, m_booleans.get());
+	}
+
+}
@@ -0,0 +1,57 @@
+function test_fast_restart
+% compare the results of a restarted simulation (Fast Restart) with a cold start
+
+tests_dir = fileparts(mfilename('fullpath'));
+
+build_dir = fullfile(tests_dir, 'fast_restart');
+
+if exist(build_dir, 'dir')
+    rmdir(build_dir, 's');
+end
+
+mkdir(build_dir);
+
+cd(build_dir);
+
+% package the BouncingBall example
+fmu = fullfile(build_dir, 'BouncingBall.fmu');
+zip(fullfile(build_dir, 'BouncingBall.zip'), {'modelDescription.xml', 'binaries'}, fullfile(tests_dir, '..', 'examples', 'BouncingBall'));
+movefile(fullfile(build_dir, 'BouncingBall.zip'), fmu);
+
+model = 'fast_restart_BouncingBall';
+
+new_system(model);
+load_system('FMIKit_blocks');
+
+fmu_block = add_block('FMIKit_blocks/FMU', [model '/BouncingBall']);
+add_block('simulink/Sinks/Out1', [model '/Out1']);
+
+set_param(model, 'StopTime', '3', 'Solver', 'ode45', 'RelTol', '1e-6', 'SaveOutput', 'on', 'SaveFormat', 'Array');
+save_system(model, fullfile(build_dir, [model '.slx']));
+
+FMIKit.loadFMU(fmu_block, fmu);
+FMIKit.setInterfaceType(fmu_block, 'ModelExchange');
+
+add_line(model, 'BouncingBall/1', 'Out1/1');
+save_system(model);
+
+% cold start
+simOut = sim(model, 'ReturnWorkspaceOutputs', 'on');
+y_cold = simOut.get('yout');
+
+% Fast Restart (the second simulation restores the initialized state of the FMU)
+set_param(model, 'FastRestart', 'on');
+
+sim(model, 'ReturnWorkspaceOutputs', 'on');
+simOut = sim(model, 'ReturnWorkspaceOutputs', 'on');
+y_restart = simOut.get('yout');
+
+set_param(model, 'FastRestart', 'off');
+close_system(model, 0);
+
+cd(tests_dir);
+
+assert(isequal(size(y_restart), size(y_cold)), 'The restarted simulation has a different number of steps')
+assert(max(abs(y_restart(:) - y_cold(:))) <= 1e-12, 'The restarted simulation differs from the cold start')
+
+end